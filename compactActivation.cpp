@@ -0,0 +1,68 @@
+#include "compactActivation.h"
+
+using namespace std;
+
+// Constructor
+compactActivation::compactActivation()
+    : maxNeuron(0), valid(false), tailStart(0), tailValue(0)
+{
+}
+
+void compactActivation::clear()
+{
+    valid = false;
+    vector<uint16_t>().swap(bases);
+    vector<uint64_t>().swap(steps);
+}
+
+bool compactActivation::build(const int *table, int maxN)
+{
+    clear();
+    maxNeuron = maxN;
+
+    // Upper half, from table(0) on
+    const int *upper = table + 5 * maxN;
+    int size = 5 * maxN;
+
+    for (int x = 0; x < size; x++) {
+        if (upper[x] < 0 || upper[x] > 0xffff)
+            return false;
+        if (x > 0 && upper[x] - upper[x - 1] != 0 &&
+            upper[x] - upper[x - 1] != 1)
+            return false;
+    }
+
+    // Saturated tail
+    tailValue = upper[size - 1];
+    tailStart = size - 1;
+    while (tailStart > 0 && upper[tailStart - 1] == tailValue)
+        tailStart--;
+
+    int numBlocks = (tailStart + 63) / 64;
+    bases.assign(numBlocks, 0);
+    steps.assign(numBlocks, 0);
+
+    for (int x = 0; x < tailStart; x++) {
+        if (x % 64 == 0)
+            bases[x / 64] = upper[x];
+        else if (upper[x] != upper[x - 1])
+            steps[x / 64] |= 1ull << (x % 64);
+    }
+
+    // Check every index activationFunction may look up, index 0 is never
+    // used since in <= -5 * maxNeuron is clamped
+    valid = true;
+    for (int in = -size + 1; in < size; in++) {
+        if (lookup(in) != table[in + size]) {
+            clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+size_t compactActivation::getBytes() const
+{
+    return bases.size() * sizeof(uint16_t) + steps.size() * sizeof(uint64_t);
+}
@@ -0,0 +1,61 @@
+#ifndef CompactActivation
+#define CompactActivation
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+// Exact compact encoding of a sigmoid activation table of 10 * maxNeuron
+// entries, indexed by in + 5 * maxNeuron.
+//
+// Only the upper half of the curve is stored, the lower half follows from
+// sigmoid(-x) = maxNeuron - sigmoid(x), which for the truncated table values
+// reads table(-x) = maxNeuron - 1 - table(x). The upper half increases by 0
+// or 1 between neighbouring entries, so it is kept as one 16-bit base value
+// per 64 entries plus a 64-bit mask of the steps. The saturated tail, where
+// the curve no longer changes, is not stored. At 16 bits this takes 25.6 KB
+// instead of the 1.25 MB of the full int table.
+//
+// build only accepts tables it reproduces bit-exactly, any other table (e.g.
+// a loaded one of another shape) is left to the full table.
+class compactActivation
+{
+  private:
+    int maxNeuron;
+    bool valid;
+
+    // Upper half - Entries past tailStart all equal tailValue
+    int tailStart, tailValue;
+    vector<uint16_t> bases;
+    vector<uint64_t> steps;
+
+    int upperHalf(int x) const
+    {
+        if (x >= tailStart)
+            return tailValue;
+
+        uint64_t mask = steps[x >> 6] & ((2ull << (x & 63)) - 1);
+        return bases[x >> 6] + __builtin_popcountll(mask);
+    }
+
+  public:
+    // Constructor
+    compactActivation();
+
+    // Encodes table, returns false (and stays invalid) if it can not be
+    // reproduced exactly
+    bool build(const int *table, int maxN);
+    void clear();
+
+    bool isValid() const { return valid; }
+    size_t getBytes() const;
+
+    // Table value for in, which must lie in (-5 * maxNeuron, 5 * maxNeuron)
+    int lookup(int in) const
+    {
+        return in >= 0 ? upperHalf(in) : maxNeuron - 1 - upperHalf(-in);
+    }
+};
+
+#endif
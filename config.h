@@ -53,6 +53,38 @@
  */
 #define ENABLE_TIMING 1
 
+/** \brief Time named, nestable regions.
+ *
+ * If this macro is defined to 1, __parsec_region_begin and
+ * __parsec_region_end time the regions between them with the monotonic clock,
+ * the Region-of-Interest being one of them, and a summary of every region is
+ * printed at the end of the program.
+ *
+ * This functionality is enabled by default.
+ */
+#define ENABLE_REGIONS 1
+
+/** \brief Count hardware events in each region.
+ *
+ * If this macro is defined to 1, regions also count CPU cycles, instructions,
+ * cache misses and branch misses of the thread that opened them, with Linux
+ * perf events. Where perf events are unavailable (other systems, missing
+ * permissions or virtualized CPUs), regions are only timed.
+ *
+ * This functionality is enabled by default.
+ */
+#define ENABLE_PERF_COUNTERS 1
+
+/** \brief Report the latency percentiles of inferences.
+ *
+ * If this macro is defined to 1, the percentiles of the latencies recorded
+ * with latencyRecorder (e.g. by models with latency tracking enabled) are
+ * printed at the end of the program.
+ *
+ * This functionality is enabled by default.
+ */
+#define ENABLE_LATENCY_REPORT 1
+
 /** \brief Prefix for all output.
  *
  * This macro defines the prefix to use for all output generated by the hooks
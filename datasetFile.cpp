@@ -0,0 +1,155 @@
+#include <cstring>
+#include <fstream>
+
+#include "datasetFile.h"
+#include "modelFile.h"
+
+using namespace std;
+
+template <typename NeuronT>
+bool writeDatasetFile(string outFile, int sampleSize, int neuronBits,
+                      const vector<NeuronT> &samples,
+                      const vector<int32_t> *labels)
+{
+    datasetFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, datasetFileMagic, sizeof(header.magic));
+    header.version = datasetFileVersion;
+    header.headerSize = sizeof(header);
+    header.numSamples = samples.size() / sampleSize;
+    header.sampleSize = sampleSize;
+    header.neuronBits = neuronBits;
+    header.neuronBytes = sizeof(NeuronT);
+    header.hasLabels = labels != 0;
+
+    if (labels && (int64_t)labels->size() != header.numSamples)
+        return false;
+
+    // Block layout
+    uint64_t samplesBytes = header.numSamples * sampleSize * sizeof(NeuronT);
+    uint64_t labelsBytes = labels ? header.numSamples * sizeof(int32_t) : 0;
+
+    header.samplesOffset = alignModelOffset(sizeof(header));
+    header.labelsOffset = alignModelOffset(header.samplesOffset + samplesBytes);
+    header.fileSize = header.labelsOffset + labelsBytes;
+
+    ofstream output(outFile, ios::out | ios::binary);
+
+    if (output.is_open()) {
+        const char padding[modelFileAlignment] = {0};
+
+        output.write((const char *)&header, sizeof(header));
+        output.write(padding, header.samplesOffset - sizeof(header));
+        output.write((const char *)samples.data(), samplesBytes);
+        output.write(padding,
+                     header.labelsOffset - header.samplesOffset - samplesBytes);
+        if (labels)
+            output.write((const char *)labels->data(), labelsBytes);
+
+        output.close();
+        return !output.fail();
+    } else {
+        return false;
+    }
+}
+
+// Constructor
+template <typename NeuronT>
+datasetReader<NeuronT>::datasetReader() : position(0)
+{
+    memset(&header, 0, sizeof(header));
+}
+
+template <typename NeuronT>
+bool datasetReader<NeuronT>::open(string inFile)
+{
+    shared_ptr<mappedFile> map(new mappedFile());
+    datasetFileHeader h;
+
+    if (!map->open(inFile) || map->size() < sizeof(h))
+        return false;
+
+    memcpy(&h, map->data(), sizeof(h));
+
+    if (memcmp(h.magic, datasetFileMagic, sizeof(h.magic)) != 0 ||
+        h.version != datasetFileVersion || h.headerSize != sizeof(h) ||
+        h.fileSize != map->size() || h.neuronBytes != sizeof(NeuronT) ||
+        h.numSamples < 0 || h.sampleSize <= 0)
+        return false;
+
+    // The Maps need aligned blocks inside the file
+    uint64_t samplesBytes = h.numSamples * h.sampleSize * sizeof(NeuronT);
+    uint64_t labelsBytes = h.hasLabels ? h.numSamples * sizeof(int32_t) : 0;
+
+    if (h.samplesOffset % modelFileAlignment != 0 ||
+        h.labelsOffset % modelFileAlignment != 0 ||
+        h.samplesOffset + samplesBytes > h.fileSize ||
+        h.labelsOffset + labelsBytes > h.fileSize)
+        return false;
+
+    map->adviseSequential();
+
+    file = map;
+    header = h;
+    position = 0;
+
+    return true;
+}
+
+template <typename NeuronT>
+typename datasetReader<NeuronT>::sampleBlock
+datasetReader<NeuronT>::samples(int64_t first, int count) const
+{
+    const NeuronT *data =
+        (const NeuronT *)(file->data() + header.samplesOffset);
+
+    return sampleBlock(data + first * header.sampleSize, header.sampleSize,
+                       count);
+}
+
+template <typename NeuronT>
+typename datasetReader<NeuronT>::labelBlock
+datasetReader<NeuronT>::labels(int64_t first, int count) const
+{
+    const int *data = (const int *)(file->data() + header.labelsOffset);
+
+    return labelBlock(data + first, count);
+}
+
+template <typename NeuronT>
+void datasetReader<NeuronT>::rewind()
+{
+    position = 0;
+}
+
+template <typename NeuronT>
+bool datasetReader<NeuronT>::nextBlock(int blockSize, int64_t &first,
+                                       int &count)
+{
+    if (position >= header.numSamples)
+        return false;
+
+    first = position;
+    count = (int)min((int64_t)blockSize, header.numSamples - position);
+    position += count;
+
+    // Have the kernel read the following block while this one is used
+    if (position < header.numSamples) {
+        int64_t ahead = min((int64_t)blockSize, header.numSamples - position);
+        size_t sampleBytes = header.sampleSize * sizeof(NeuronT);
+
+        file->prefetch(header.samplesOffset + position * sampleBytes,
+                       ahead * sampleBytes);
+    }
+
+    return true;
+}
+
+#define INSTANTIATE_DATASET_FILE(T)                                            \
+    template bool writeDatasetFile<T>(string, int, int, const vector<T> &,     \
+                                      const vector<int32_t> *);                \
+    template class datasetReader<T>;
+
+INSTANTIATE_DATASET_FILE(int8_t)
+INSTANTIATE_DATASET_FILE(int16_t)
+INSTANTIATE_DATASET_FILE(int32_t)
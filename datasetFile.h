@@ -0,0 +1,89 @@
+#ifndef DatasetFile
+#define DatasetFile
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ext/eigen-library/Eigen/Core"
+#include "mappedFile.h"
+
+using namespace std;
+
+// Binary dataset file layout, version 1. The header is followed by the
+// samples, one after the other at the neuron storage type (so the block is a
+// column-major sampleSize x numSamples matrix), then by one int32_t label per
+// sample if the file has labels. Blocks start on 64-byte boundaries.
+const char datasetFileMagic[8] = {'I', 'N', 'T', 'N', 'N', 'D', 'A', 'T'};
+const uint32_t datasetFileVersion = 1;
+
+struct datasetFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+
+    // Samples and their size, not counting the bias neuron
+    int64_t numSamples;
+    int32_t sampleSize;
+
+    // Bit depth the samples were quantized to and their storage type, in bytes
+    int32_t neuronBits;
+    uint8_t neuronBytes;
+    uint8_t hasLabels;
+
+    // Offsets of the blocks from the start of the file
+    uint64_t samplesOffset;
+    uint64_t labelsOffset;
+    uint64_t fileSize;
+};
+
+// Writes numSamples samples of sampleSize values, plus labels if not null
+template <typename NeuronT>
+bool writeDatasetFile(string outFile, int sampleSize, int neuronBits,
+                      const vector<NeuronT> &samples,
+                      const vector<int32_t> *labels);
+
+// Reads a dataset file through a read-only mapping. Blocks of samples are
+// handed out as Eigen Maps on the mapped pages, so nothing is copied or
+// parsed; the kernel reads the file ahead as blocks are streamed.
+template <typename NeuronT>
+class datasetReader
+{
+  public:
+    typedef Eigen::Matrix<NeuronT, Eigen::Dynamic, Eigen::Dynamic>
+        neuronMatrix;
+    typedef Eigen::Map<const neuronMatrix> sampleBlock;
+    typedef Eigen::Map<const Eigen::VectorXi> labelBlock;
+
+  private:
+    shared_ptr<mappedFile> file;
+    datasetFileHeader header;
+
+    // Next sample handed out by nextBlock
+    int64_t position;
+
+  public:
+    // Constructor
+    datasetReader();
+
+    // Maps inFile, the samples must be stored in NeuronT
+    bool open(string inFile);
+
+    int64_t getNumSamples() const { return header.numSamples; }
+    int getSampleSize() const { return header.sampleSize; }
+    int getNeuronBits() const { return header.neuronBits; }
+    bool hasLabels() const { return header.hasLabels != 0; }
+
+    // Random access - count samples, or labels, starting at first
+    sampleBlock samples(int64_t first, int count) const;
+    labelBlock labels(int64_t first, int count) const;
+
+    // Streaming - Hands out consecutive blocks of up to blockSize samples,
+    // returns false once all samples were handed out
+    void rewind();
+    bool nextBlock(int blockSize, int64_t &first, int &count);
+};
+
+#endif
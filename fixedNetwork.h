@@ -0,0 +1,110 @@
+#ifndef FixedNetwork
+#define FixedNetwork
+
+#include <cstdint>
+
+using namespace std;
+
+// Kernels of the fixed-size networks written by tools/generateNetwork.cpp.
+// Sizes are template parameters taken from the arrays passed in, so the
+// compiler sees every loop bound and the weights, and can unroll and
+// vectorize freely. Results are the same as IntegerModel's for the model the
+// network was generated from.
+
+// Input neurons, then the bias neuron
+template <typename NeuronT, int Size>
+inline void fixedInput(const NeuronT *in, NeuronT bias,
+                       NeuronT (&neurons)[Size + 1])
+{
+    for (int i = 0; i < Size; i++)
+        neurons[i] = in[i];
+    neurons[Size] = bias;
+}
+
+// sums[j] = sum_i weights[j][i] * in[i], weights holding one row per output
+// neuron (the columns of the model's weight matrix, bias weight last)
+template <typename AccT, typename NeuronT, typename WeightT, int SizeIn,
+          int SizeOut>
+inline void fixedProduct(const WeightT (&weights)[SizeOut][SizeIn],
+                         const NeuronT (&in)[SizeIn], AccT (&sums)[SizeOut])
+{
+    for (int j = 0; j < SizeOut; j++) {
+        AccT sum = 0;
+        for (int i = 0; i < SizeIn; i++)
+            sum += (AccT)weights[j][i] * (AccT)in[i];
+        sums[j] = sum;
+    }
+}
+
+// Activation LUT lookup of a requantized accumulator, the table holding the
+// saturated activations of [-5 * MaxNeuron, 5 * MaxNeuron)
+template <int MaxNeuron, typename NeuronT, typename AccT>
+inline NeuronT fixedActivation(AccT in,
+                               const NeuronT (&table)[10 * MaxNeuron],
+                               NeuronT top)
+{
+    if (in >= 5 * MaxNeuron)
+        return top;
+    else if (in <= -5 * MaxNeuron)
+        return 0;
+    else
+        return table[(int)in + 5 * MaxNeuron];
+}
+
+// Activations of a layer with a global scale - Accumulators are divided by
+// 2^Shift, rounding to nearest
+template <int MaxNeuron, int Shift, typename NeuronT, typename AccT,
+          int SizeOut, int SizeNext>
+inline void fixedActivate(const AccT (&sums)[SizeOut],
+                          const NeuronT (&table)[10 * MaxNeuron], NeuronT top,
+                          NeuronT (&out)[SizeNext])
+{
+    static_assert(SizeNext == SizeOut || SizeNext == SizeOut + 1,
+                  "outputs are the layer's neurons, and maybe a bias");
+
+    const AccT half = Shift == 0 ? 0 : (AccT)1 << (Shift > 0 ? Shift - 1 : 0);
+
+    for (int j = 0; j < SizeOut; j++) {
+        AccT sum = Shift == 0 ? sums[j] : (sums[j] + half) >> Shift;
+        out[j] = fixedActivation<MaxNeuron>(sum, table, top);
+    }
+}
+
+// Activations of a layer with output scales - Accumulators are multiplied by
+// their neuron's scale in 64 bits, then divided by 2^Bits (scale fraction bits
+// plus the shift), rounding to nearest
+template <int MaxNeuron, int Bits, typename NeuronT, typename AccT,
+          int SizeOut, int SizeNext>
+inline void fixedActivateScaled(const AccT (&sums)[SizeOut],
+                                const int32_t (&scales)[SizeOut],
+                                const NeuronT (&table)[10 * MaxNeuron],
+                                NeuronT top, NeuronT (&out)[SizeNext])
+{
+    static_assert(SizeNext == SizeOut || SizeNext == SizeOut + 1,
+                  "outputs are the layer's neurons, and maybe a bias");
+
+    for (int j = 0; j < SizeOut; j++) {
+        int64_t product = (int64_t)sums[j] * scales[j];
+        AccT sum = (AccT)((product + ((int64_t)1 << (Bits - 1))) >> Bits);
+        out[j] = fixedActivation<MaxNeuron>(sum, table, top);
+    }
+}
+
+// Index of the largest output, the first one on ties
+template <int MaxNeuron, typename NeuronT, int Size>
+inline int fixedOutputClass(const NeuronT (&out)[Size])
+{
+    int max = -1 * MaxNeuron;
+    int result = 0;
+
+    for (int k = 0; k < Size; k++) {
+        if (out[k] > max) {
+            max = out[k];
+            result = k;
+        }
+    }
+
+    return result;
+}
+
+#endif
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <math.h>
+#include <thread>
+
+#include "fpConversion.h"
+#include "mappedFile.h"
+
+using namespace std;
+
+// Chunks per worker, so the pool can balance uneven chunks
+static const int chunksPerThread = 4;
+
+int conversionThreads()
+{
+    int threads = thread::hardware_concurrency();
+    return threads < 1 ? 1 : threads;
+}
+
+static inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' ||
+           c == '\f';
+}
+
+static inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Parses the token [begin, end). Decimals with up to 19 significant digits
+// and a power of ten up to 22 are converted with one exact multiplication or
+// division, which rounds correctly. Other numbers go through strtod. Returns
+// false if the token is not a number.
+static bool parseToken(const char *begin, const char *end, double &value)
+{
+    static const double powers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                    1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                    1e18, 1e19, 1e20, 1e21, 1e22};
+
+    const char *p = begin;
+    bool negative = false;
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool anyDigit = false, exact = true;
+
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    for (; p < end && isDigit(*p); p++) {
+        anyDigit = true;
+        if (mantissa == 0 && *p == '0')
+            continue;
+        if (++digits > 19)
+            exact = false;
+        mantissa = mantissa * 10 + (*p - '0');
+    }
+
+    if (p < end && *p == '.') {
+        for (p++; p < end && isDigit(*p); p++) {
+            anyDigit = true;
+            if (mantissa == 0 && *p == '0') {
+                exponent--;
+                continue;
+            }
+            if (++digits > 19)
+                exact = false;
+            mantissa = mantissa * 10 + (*p - '0');
+            exponent--;
+        }
+    }
+
+    if (!anyDigit)
+        return false;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool negativeExp = false;
+        int exp = 0;
+
+        if (q < end && (*q == '-' || *q == '+'))
+            negativeExp = *q++ == '-';
+        if (q == end || !isDigit(*q))
+            return false;
+        for (; q < end && isDigit(*q); q++)
+            exp = min(exp * 10 + (*q - '0'), 100000);
+
+        exponent += negativeExp ? -exp : exp;
+        p = q;
+    }
+
+    if (p != end)
+        return false;
+
+    if (exact && mantissa == 0) {
+        value = negative ? -0.0 : 0.0;
+        return true;
+    }
+
+    if (exact && mantissa <= (1ull << 53) && exponent >= -22 &&
+        exponent <= 22) {
+        double m = (double)mantissa;
+        value = exponent < 0 ? m / powers[-exponent] : m * powers[exponent];
+        if (negative)
+            value = -value;
+        return true;
+    }
+
+    // Slow path - strtod needs a terminated copy of the token
+    char buffer[512];
+    size_t length = end - begin;
+    string longToken;
+    char *token = buffer;
+
+    if (length >= sizeof(buffer)) {
+        longToken.assign(begin, end);
+        token = &longToken[0];
+    } else {
+        memcpy(buffer, begin, length);
+        buffer[length] = 0;
+    }
+
+    value = strtod(token, 0);
+    return true;
+}
+
+// Parses the tokens starting in [begin, end), the last one may run past end
+static void parseChunk(const char *begin, const char *end,
+                       const char *fileEnd, vector<double> &values)
+{
+    const char *p = begin;
+
+    while (true) {
+        while (p < end && isSpace(*p))
+            p++;
+        if (p >= end)
+            return;
+
+        const char *token = p;
+        while (p < fileEnd && !isSpace(*p))
+            p++;
+
+        double value;
+        if (parseToken(token, p, value))
+            values.push_back(value);
+    }
+}
+
+bool parseFPFile(string inFile, workStealingPool &pool,
+                 vector<double> &values)
+{
+    mappedFile file;
+    values.clear();
+
+    if (!file.open(inFile))
+        return false;
+
+    file.adviseSequential();
+
+    // Chunk boundaries are moved forward to whitespace, so no token is split
+    const char *data = file.data();
+    const char *fileEnd = data + file.size();
+    int numChunks = pool.getNumThreads() * chunksPerThread;
+    vector<const char *> bounds(numChunks + 1);
+
+    bounds[0] = data;
+    for (int c = 1; c < numChunks; c++) {
+        const char *p = data + file.size() * c / numChunks;
+        while (p < fileEnd && !isSpace(*p))
+            p++;
+        bounds[c] = max(p, bounds[c - 1]);
+    }
+    bounds[numChunks] = fileEnd;
+
+    vector<vector<double>> chunks(numChunks);
+
+    pool.run(numChunks, [&](int, int c) {
+        chunks[c].reserve((bounds[c + 1] - bounds[c]) / 4);
+        parseChunk(bounds[c], bounds[c + 1], fileEnd, chunks[c]);
+    });
+
+    // Gather the chunks in order
+    vector<size_t> offsets(numChunks + 1, 0);
+    for (int c = 0; c < numChunks; c++)
+        offsets[c + 1] = offsets[c] + chunks[c].size();
+
+    values.resize(offsets[numChunks]);
+
+    pool.run(numChunks, [&](int, int c) {
+        copy(chunks[c].begin(), chunks[c].end(), values.begin() + offsets[c]);
+        vector<double>().swap(chunks[c]);
+    });
+
+    return true;
+}
+
+size_t parseFPValues(const char *&begin, const char *end, double *values,
+                     size_t count)
+{
+    const char *p = begin;
+    size_t parsed = 0;
+
+    while (parsed < count) {
+        while (p < end && isSpace(*p))
+            p++;
+        if (p >= end)
+            break;
+
+        const char *token = p;
+        while (p < end && !isSpace(*p))
+            p++;
+
+        if (parseToken(token, p, values[parsed]))
+            parsed++;
+    }
+
+    begin = p;
+    return parsed;
+}
+
+double maxAbsolute(const vector<double> &values, size_t first,
+                   workStealingPool &pool)
+{
+    int numChunks = pool.getNumThreads() * chunksPerThread;
+    size_t size = values.size() > first ? values.size() - first : 0;
+    vector<double> maxima(numChunks, 0.0);
+
+    pool.run(numChunks, [&](int, int c) {
+        size_t begin = first + size * c / numChunks;
+        size_t end = first + size * (c + 1) / numChunks;
+        double max = 0.0;
+
+        for (size_t i = begin; i < end; i++)
+            max = fmax(max, fabs(values[i]));
+        maxima[c] = max;
+    });
+
+    return *max_element(maxima.begin(), maxima.end());
+}
+
+void appendInt(string &out, int value)
+{
+    char digits[12];
+    int length = 0;
+    // Negated as unsigned, so the most negative int is handled too
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : value;
+
+    do {
+        digits[length++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude);
+
+    if (value < 0)
+        out += '-';
+    while (length)
+        out += digits[--length];
+}
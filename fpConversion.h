@@ -0,0 +1,35 @@
+#ifndef FpConversion
+#define FpConversion
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "workStealingPool.h"
+
+using namespace std;
+
+// Threads used by the FP converters, one per hardware thread
+int conversionThreads();
+
+// Parses every number of a text file, in file order. The file is mapped and
+// split in chunks at whitespace, chunks are parsed by the pool's workers.
+// Words, such as section labels, are skipped. Values are rounded exactly as
+// strtod rounds them.
+bool parseFPFile(string inFile, workStealingPool &pool,
+                 vector<double> &values);
+
+// Parses numbers from [begin, end) into values, up to count of them, skipping
+// words as parseFPFile does. begin is moved past the tokens parsed. Returns
+// the number of values parsed, less than count only at the end of the text.
+size_t parseFPValues(const char *&begin, const char *end, double *values,
+                     size_t count);
+
+// Largest absolute value of values[first, end), as a parallel reduction
+double maxAbsolute(const vector<double> &values, size_t first,
+                   workStealingPool &pool);
+
+// Appends value in decimal, as operator<< would write it
+void appendInt(string &out, int value);
+
+#endif
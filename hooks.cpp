@@ -45,9 +45,38 @@
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if ENABLE_LATENCY_REPORT
+#include "latencyHistogram.h"
+#endif
+
+#if ENABLE_REGIONS
+#include <mutex>
+#include <string>
+#include <vector>
+#endif
+
+#if ENABLE_PERF_COUNTERS && defined(__linux__)
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define USE_PERF_COUNTERS 1
+#else
+#define USE_PERF_COUNTERS 0
+#endif
+
+/** \brief Current time in seconds, from the monotonic clock. */
+static double monotonic_seconds()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
 
 #if ENABLE_TIMING
-#include <sys/time.h>
 /** \brief Time at beginning of execution of Region-of-Interest.
  *
  * This variable will store the time when the Region-of-Interest is entered.
@@ -68,6 +97,173 @@ static double time_begin;
 static double time_end;
 #endif // ENABLE_TIMING
 
+#if ENABLE_REGIONS
+/** \brief Hardware events counted in each region. */
+enum { NUM_COUNTERS = 4 };
+
+/** \brief Statistics of a region, summed over every time it was entered.
+ *
+ * Regions are identified by their path, the names of the regions they are
+ * nested in and their own joined by '/', and kept in order of first entry.
+ */
+struct region_stats {
+    std::string path;
+    int depth;
+    uint64_t calls;
+    double seconds;
+    uint64_t counts[NUM_COUNTERS];
+    uint64_t counted_calls;
+};
+
+/** \brief Region entered by a thread and not left yet. */
+struct open_region {
+    const char *name;
+    std::string path;
+    size_t index;
+    double start;
+    uint64_t counts[NUM_COUNTERS];
+    bool counted;
+};
+
+/** \brief Statistics of all regions, shared by all threads. */
+static std::mutex regions_lock;
+static std::vector<region_stats> regions;
+
+/** \brief Stack of the regions open on the calling thread. */
+static thread_local std::vector<open_region> open_regions;
+
+#if USE_PERF_COUNTERS
+/** \brief Events counted in each region, and their names in the summary. */
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} counter_events[NUM_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}};
+
+/** \brief Counters of the process, opened once with inherit set.
+ *
+ * They are opened on the thread that calls __parsec_bench_begin (or enters
+ * the first region), and every thread it or its threads start afterwards
+ * inherits them, so reading them gives the sum over all those threads, live
+ * or joined. Work handed to other threads, such as the pool of
+ * parallelEvaluator or the reader and quantizer of pipelinedEvaluator, is
+ * counted in the regions open on the thread waiting for it. Threads started
+ * before the counters were opened are not counted.
+ *
+ * Each event is counted on its own, so events the CPU does not support do
+ * not disable the others.
+ */
+static std::once_flag counters_once;
+static int counter_fds[NUM_COUNTERS] = {-1, -1, -1, -1};
+
+/** \brief Events opened, as a bit mask. */
+static unsigned counters_available = 0;
+
+static void open_counters()
+{
+    struct perf_event_attr attr;
+    int error = 0;
+
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counter_events[c].type;
+        attr.config = counter_events[c].config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1;
+        attr.read_format =
+            PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        counter_fds[c] =
+            (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (counter_fds[c] >= 0)
+            counters_available |= 1u << c;
+        else
+            error = errno;
+    }
+
+    if (!counters_available)
+        fprintf(stderr,
+                HOOKS_PREFIX " Performance counters unavailable (%s), "
+                             "regions are only timed\n",
+                strerror(error));
+}
+
+/** \brief Reads the counters, summed over the counted threads and scaled
+ * when the kernel multiplexed them. Returns false if none could be opened.
+ */
+static bool read_counters(uint64_t *counts)
+{
+    std::call_once(counters_once, open_counters);
+    if (!counters_available)
+        return false;
+
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+        uint64_t values[3] = {0, 0, 0};
+
+        counts[c] = 0;
+        if (counter_fds[c] < 0 ||
+            read(counter_fds[c], values, sizeof(values)) !=
+                (ssize_t)sizeof(values))
+            continue;
+
+        counts[c] = values[2] && values[2] < values[1]
+                        ? (uint64_t)((double)values[0] * values[1] / values[2])
+                        : values[0];
+    }
+
+    return true;
+}
+#else
+static const unsigned counters_available = 0;
+
+static bool read_counters(uint64_t *) { return false; }
+#endif // USE_PERF_COUNTERS
+
+/** \brief Opens the counters before the benchmark starts any thread. */
+static void start_counters()
+{
+    uint64_t counts[NUM_COUNTERS];
+
+    read_counters(counts);
+}
+
+/** \brief Index of the statistics of a region, added on its first entry. */
+static size_t find_region(const std::string &path, int depth)
+{
+    std::lock_guard<std::mutex> guard(regions_lock);
+
+    for (size_t r = 0; r < regions.size(); r++) {
+        if (regions[r].path == path)
+            return r;
+    }
+
+    region_stats stats;
+    stats.path = path;
+    stats.depth = depth;
+    stats.calls = stats.counted_calls = 0;
+    stats.seconds = 0.0;
+    for (int c = 0; c < NUM_COUNTERS; c++)
+        stats.counts[c] = 0;
+    regions.push_back(stats);
+
+    return regions.size() - 1;
+}
+
+/** \brief Prints one derived counter of the summary, or - if unavailable. */
+static void print_count(FILE *out, int width, bool available, double value)
+{
+    if (available)
+        fprintf(out, " %*.2f", width, value);
+    else
+        fprintf(out, " %*s", width, "-");
+}
+#endif // ENABLE_REGIONS
+
 /** Enable debugging code */
 #define DEBUG 0
 
@@ -133,6 +329,10 @@ void __parsec_bench_begin(enum __parsec_benchmark __bench)
 
     // Store global benchmark ID for other hook functions
     bench = __bench;
+
+#if ENABLE_REGIONS
+    start_counters();
+#endif
 }
 
 void __parsec_bench_end()
@@ -150,6 +350,10 @@ void __parsec_bench_end()
     printf(HOOKS_PREFIX " Total time spent in ROI: %.3fs\n",
            time_end - time_begin);
 #endif // ENABLE_TIMING
+    __parsec_region_report(stdout);
+#if ENABLE_LATENCY_REPORT
+    latencyRecorder::report(stdout, HOOKS_PREFIX);
+#endif
     printf(HOOKS_PREFIX " Terminating\n");
 }
 
@@ -167,11 +371,11 @@ void __parsec_roi_begin()
     fflush(NULL);
 
 #if ENABLE_TIMING
-    struct timeval t;
-    gettimeofday(&t, NULL);
-    time_begin = (double)t.tv_sec + (double)t.tv_usec * 1e-6;
+    time_begin = monotonic_seconds();
 #endif // ENABLE_TIMING
 
+    __parsec_region_begin("ROI");
+
 #if ENABLE_GEM5_HOOKS
     printf(GEM5_HOOKS_PREFIX " Beginning of ROI\n");
     m5_checkpoint(0, 0);
@@ -189,10 +393,10 @@ void __parsec_roi_end()
     assert(num_bench_ends == 0);
 #endif // DEBUG
 
+    __parsec_region_end("ROI");
+
 #if ENABLE_TIMING
-    struct timeval t;
-    gettimeofday(&t, NULL);
-    time_end = (double)t.tv_sec + (double)t.tv_usec * 1e-6;
+    time_end = monotonic_seconds();
 #endif // ENABLE_TIMING
 
 #if ENABLE_GEM5_HOOKS
@@ -205,3 +409,114 @@ void __parsec_roi_end()
     printf(HOOKS_PREFIX " Leaving ROI\n");
     fflush(NULL);
 }
+
+void __parsec_region_begin(const char *name)
+{
+#if ENABLE_REGIONS
+    open_region region;
+    std::string path = name;
+
+    if (!open_regions.empty())
+        path = open_regions.back().path + "/" + path;
+
+    region.name = name;
+    region.path = path;
+    region.index = find_region(path, open_regions.size());
+    region.start = monotonic_seconds();
+    region.counted = read_counters(region.counts);
+    open_regions.push_back(region);
+#else
+    (void)name;
+#endif // ENABLE_REGIONS
+}
+
+void __parsec_region_end(const char *name)
+{
+#if ENABLE_REGIONS
+    uint64_t counts[NUM_COUNTERS];
+    bool counted = read_counters(counts);
+    double end = monotonic_seconds();
+
+    if (open_regions.empty() || strcmp(open_regions.back().name, name) != 0) {
+        fprintf(stderr,
+                HOOKS_PREFIX " Region %s is not the innermost open one\n",
+                name);
+        return;
+    }
+
+    const open_region &region = open_regions.back();
+    std::lock_guard<std::mutex> guard(regions_lock);
+    region_stats &stats = regions[region.index];
+
+    stats.calls++;
+    stats.seconds += end - region.start;
+    if (counted && region.counted) {
+        for (int c = 0; c < NUM_COUNTERS; c++)
+            stats.counts[c] += counts[c] - region.counts[c];
+        stats.counted_calls++;
+    }
+    open_regions.pop_back();
+#else
+    (void)name;
+#endif // ENABLE_REGIONS
+}
+
+void __parsec_region_report(FILE *out)
+{
+#if ENABLE_REGIONS
+    std::lock_guard<std::mutex> guard(regions_lock);
+
+    if (regions.empty())
+        return;
+
+    // Counters are reported per region as millions of cycles and
+    // instructions, instructions per cycle, and misses per thousand
+    // instructions: a low IPC with many cache misses points to a memory-bound
+    // region, a high IPC to a compute-bound one
+    bool counted = counters_available != 0;
+
+    fprintf(out, HOOKS_PREFIX " %-32s %8s %10s %10s", "Region", "Calls",
+            "Total s", "Mean ms");
+    if (counted)
+        fprintf(out, " %10s %10s %6s %10s %10s", "Mcycles", "Minstr", "IPC",
+                "Cache/ki", "Branch/ki");
+    fprintf(out, "\n");
+
+    for (size_t r = 0; r < regions.size(); r++) {
+        const region_stats &stats = regions[r];
+        std::string name(2 * stats.depth, ' ');
+
+        name += stats.path.substr(stats.path.rfind('/') + 1);
+        fprintf(out, HOOKS_PREFIX " %-32s %8llu %10.4f %10.4f",
+                name.c_str(), (unsigned long long)stats.calls, stats.seconds,
+                stats.calls ? 1e3 * stats.seconds / stats.calls : 0.0);
+
+        if (counted) {
+            double cycles = (double)stats.counts[0];
+            double instructions = (double)stats.counts[1];
+
+            if (stats.counted_calls == 0) {
+                fprintf(out, " %10s %10s %6s %10s %10s", "-", "-", "-", "-",
+                        "-");
+            } else {
+                print_count(out, 10, counters_available & 1, cycles * 1e-6);
+                print_count(out, 10, counters_available & 2,
+                            instructions * 1e-6);
+                print_count(out, 6, (counters_available & 3) == 3 && cycles,
+                            instructions / cycles);
+                print_count(out, 10, (counters_available & 6) == 6 &&
+                                         instructions,
+                            1e3 * stats.counts[2] / instructions);
+                print_count(out, 10, (counters_available & 10) == 10 &&
+                                         instructions,
+                            1e3 * stats.counts[3] / instructions);
+            }
+        }
+        fprintf(out, "\n");
+    }
+
+    fflush(out);
+#else
+    (void)out;
+#endif // ENABLE_REGIONS
+}
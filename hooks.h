@@ -68,6 +68,8 @@
 /** Guard macro to prevent multiple inclusions. */
 #define _PARSEC_HOOKS_HOOKS_H 1
 
+#include <stdio.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -117,7 +119,9 @@ enum __parsec_benchmark {
  *
  * \param[in] __bench Unique workload identifier.
  *
- * This function is executed exactly once, as soon as the program starts.
+ * This function is executed exactly once, as soon as the program starts,
+ * before it starts any thread: the hardware counters of the regions are
+ * opened here, and only threads started afterwards are counted.
  *
  * Its logical counterpart is __parsec_bench_end.
  */
@@ -153,6 +157,41 @@ void __parsec_roi_begin();
  */
 void __parsec_roi_end();
 
+/** \brief Beginning of a named region.
+ *
+ * \param[in] name Name of the region, reported with those of the regions it
+ * is nested in.
+ *
+ * Regions may be nested and entered any number of times, from any thread.
+ * Each thread has its own stack of open regions. Times are those of the
+ * thread that opened the region. Hardware counters are opened once, by
+ * __parsec_bench_begin or else the first region, and inherited by every
+ * thread started afterwards: they sum all of them, live or joined, so work
+ * handed to other threads counts in the region of the thread waiting for it.
+ * The Region-of-Interest is the region named "ROI".
+ *
+ * The logical counterpart of this function is __parsec_region_end.
+ */
+void __parsec_region_begin(const char *name);
+
+/** \brief End of a named region.
+ *
+ * \param[in] name Name of the region, which must be the innermost one open
+ * on the calling thread.
+ *
+ * The logical counterpart of this function is __parsec_region_begin.
+ */
+void __parsec_region_end(const char *name);
+
+/** \brief Summary of the regions.
+ *
+ * \param[in] out Stream the summary is printed to.
+ *
+ * Prints the calls, time and, if available, hardware counters of every
+ * region entered so far. __parsec_bench_end prints it to stdout.
+ */
+void __parsec_region_report(FILE *out);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -0,0 +1,91 @@
+#include <algorithm>
+
+#include "inferenceContext.h"
+#include "integerModel.h"
+
+using namespace std;
+
+// Constructor
+template <typename NeuronT, typename WeightT, typename AccT>
+InferenceContext<NeuronT, WeightT, AccT>::InferenceContext(
+    const IntegerModel<NeuronT, WeightT, AccT> &model, int batchSize)
+    : neurons(model.getNumLayers() + 1), deltaUpdates(-1),
+      batchNeurons(model.getNumLayers() + 1)
+{
+    int numLayers = model.getNumLayers();
+    int maxSize = 0;
+
+    // Initialize layers
+    for (int l = 0; l <= numLayers; l++) {
+        neurons[l].setZero(model.getLayerSize(l) + (l < numLayers ? 1 : 0));
+        if (l > 0)
+            maxSize = max(maxSize, model.getLayerSize(l));
+    }
+    neuronSums.resize(maxSize);
+    inputIndices.resize(model.getSizeInput() + 1);
+
+    // Words of the widest layer input (with the bias neuron), one plane per
+    // bit of NeuronT
+    int maxWords = 0;
+    for (int l = 0; l < numLayers; l++)
+        maxWords = max(maxWords, (model.getLayerSize(l) + 1 + 63) / 64);
+    inputPlanes.resize((size_t)maxWords * 8 * sizeof(NeuronT));
+
+    deltaInput.setZero(model.getSizeInput() + 1);
+    deltaSums.setZero(model.getLayerSize(1));
+    deltaChanges.resize(model.getSizeInput());
+
+    reserveBatch(batchSize);
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void InferenceContext<NeuronT, WeightT, AccT>::resetDelta()
+{
+    deltaInput.setZero();
+    deltaUpdates = -1;
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void InferenceContext<NeuronT, WeightT, AccT>::reserveBatch(int count)
+{
+    if (batchSums.cols() >= count)
+        return;
+
+    for (size_t l = 0; l < neurons.size(); l++)
+        batchNeurons[l].resize(neurons[l].size(), count);
+    batchSums.resize(neuronSums.size(), count);
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+bool InferenceContext<NeuronT, WeightT, AccT>::dumpTrace(
+    ofstream &trace) const
+{
+    // Neurons are printed as int, streams would print 8-bit types as
+    // characters
+    if (trace.is_open()) {
+        int last = neurons.size() - 1;
+
+        trace << "===================================\n"
+              << "== Input layer:" << endl;
+        trace << neurons[0].template cast<int>();
+
+        for (int l = 1; l < last; l++) {
+            trace << "\n\n)== Hidden layer";
+            if (last > 2)
+                trace << " " << l;
+            trace << ":" << endl;
+            trace << neurons[l].template cast<int>();
+        }
+
+        trace << "\n\n== Output layer:" << endl;
+        trace << neurons[last].template cast<int>();
+
+        trace << "===================================\n" << endl;
+
+        return true;
+    } else {
+        return false;
+    }
+}
+
+INSTANTIATE_INTEGER_NET(InferenceContext)
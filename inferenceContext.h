@@ -0,0 +1,67 @@
+#ifndef InferenceContext_H
+#define InferenceContext_H
+
+#include <fstream>
+#include <vector>
+
+#include "ext/eigen-library/Eigen/Core"
+#include "integerTypes.h"
+
+using namespace std;
+// Scratch state of one classification in flight. Contexts are cheap compared
+// to the model they are built for, so each thread keeps its own.
+template <typename NeuronT, typename WeightT, typename AccT>
+class InferenceContext
+{
+  public:
+    typedef integerNetMatrices<NeuronT, WeightT, AccT> matrices;
+
+    // Layer Neurons - One Eigen vector per layer, from the input to the
+    // output. All but the output end with the bias neuron.
+    vector<typename matrices::neuronVector> neurons;
+
+    // Accumulators of the layer being computed
+    typename matrices::accVector neuronSums;
+
+    // Indices of the nonzero inputs of the sample being classified, or of
+    // the changed inputs for incremental classifying
+    vector<int32_t> inputIndices;
+
+    // Bit planes of the inputs of a layer with binary or ternary weights
+    // (see planesKernel16), sized for the widest layer input
+    vector<uint64_t> inputPlanes;
+
+    // Incremental classifying - Inputs (with the bias neuron) and first-layer
+    // accumulators of the last sample, updates since the accumulators were
+    // last computed in full (-1 before the first sample), and the changes of
+    // the inputs listed in inputIndices
+    typename matrices::neuronVector deltaInput;
+    typename matrices::accVector deltaSums;
+    int deltaUpdates;
+    vector<AccT> deltaChanges;
+
+    // Batched Layer Neurons - One column per sample of the current block,
+    // sized for the largest block seen so far
+    vector<typename matrices::neuronMatrix> batchNeurons;
+
+    // Accumulators of the layer being computed for the current block
+    typename matrices::accMatrix batchSums;
+
+    // Constructor - Sized for the layers of model and blocks of up to
+    // batchSize samples
+    InferenceContext(const IntegerModel<NeuronT, WeightT, AccT> &model,
+                     int batchSize = 64);
+
+    // Grows the batch scratch to hold blocks of count samples
+    void reserveBatch(int count);
+
+    // Forgets the last sample of incremental classifying, whose accumulators
+    // are stale once the model's weights change: the next one is computed in
+    // full, against inputs of zero for the index form of classifyDelta
+    void resetDelta();
+
+    // Tracing functions
+    bool dumpTrace(ofstream &trace) const;
+};
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef IntegerKernels
+#define IntegerKernels
+
+#include "ext/eigen-library/Eigen/Core"
+#include "layerKernels.h"
+#include "sparseWeights.h"
+#include "ternaryWeights.h"
+
+using namespace std;
+
+// Dot product of a weight column and a neuron vector, with every product
+// widened to the accumulator type. Written as a plain loop so the compiler
+// vectorizes it for narrow operands (e.g. multiply-add of 16-bit pairs).
+template <typename AccT, typename WeightT, typename NeuronT>
+inline AccT dotProduct(const WeightT *w, const NeuronT *in, int size)
+{
+    AccT acc = 0;
+
+    for (int i = 0; i < size; i++)
+        acc += (AccT)w[i] * (AccT)in[i];
+
+    return acc;
+}
+
+// Layer product out = weights^T * in for one sample, on a column-major
+// rows x cols weight matrix. 8- and 16-bit operands summed in 32 bits go
+// through the kernels selected for the CPU, other types through dotProduct.
+template <typename AccT, typename WeightT, typename NeuronT>
+inline void layerProduct(const layerKernels &, const WeightT *weights,
+                         int rows, int cols, const NeuronT *in, AccT *out)
+{
+    for (int j = 0; j < cols; j++)
+        out[j] = dotProduct<AccT>(weights + (size_t)j * rows, in, rows);
+}
+
+inline void layerProduct(const layerKernels &kernels, const int16_t *weights,
+                         int rows, int cols, const int16_t *in, int32_t *out)
+{
+    kernels.product16(weights, rows, cols, in, out);
+}
+
+inline void layerProduct(const layerKernels &kernels, const int8_t *weights,
+                         int rows, int cols, const int8_t *in, int32_t *out)
+{
+    kernels.product8(weights, rows, cols, in, out);
+}
+
+// Layer product out = weights^T * in for one sample whose partial sums are
+// known to fit 16 bits (see narrowKernel8). 8-bit operands go through the
+// narrow-accumulator kernels, other types through layerProduct.
+template <typename AccT, typename WeightT, typename NeuronT>
+inline void narrowLayerProduct(const layerKernels &kernels,
+                               const WeightT *weights, int rows, int cols,
+                               const NeuronT *in, AccT *out)
+{
+    layerProduct(kernels, weights, rows, cols, in, out);
+}
+
+inline void narrowLayerProduct(const layerKernels &kernels,
+                               const int8_t *weights, int rows, int cols,
+                               const int8_t *in, int32_t *out)
+{
+    kernels.narrow8(weights, rows, cols, in, out);
+}
+
+// Layer product out = weights^T * in for one sample on blocked sparse
+// weights, with the same kernel selection as layerProduct
+template <typename AccT, typename WeightT, typename NeuronT>
+inline void sparseLayerProduct(const layerKernels &,
+                               const sparseWeights<WeightT> &weights,
+                               const NeuronT *in, AccT *out)
+{
+    const int32_t *columnStarts = weights.getColumnStarts();
+    const int32_t *blockRows = weights.getBlockRows();
+    const WeightT *blocks = weights.getBlocks();
+
+    for (int j = 0; j < weights.getCols(); j++) {
+        AccT acc = 0;
+
+        for (int b = columnStarts[j]; b < columnStarts[j + 1]; b++) {
+            acc += dotProduct<AccT>(blocks + (size_t)b * sparseBlockRows,
+                                    in + blockRows[b], sparseBlockRows);
+        }
+        out[j] = acc;
+    }
+}
+
+inline void sparseLayerProduct(const layerKernels &kernels,
+                               const sparseWeights<int16_t> &weights,
+                               const int16_t *in, int32_t *out)
+{
+    kernels.sparse16(weights.getBlocks(), weights.getBlockRows(),
+                     weights.getColumnStarts(), weights.getCols(), in, out);
+}
+
+inline void sparseLayerProduct(const layerKernels &kernels,
+                               const sparseWeights<int8_t> &weights,
+                               const int8_t *in, int32_t *out)
+{
+    kernels.sparse8(weights.getBlocks(), weights.getBlockRows(),
+                    weights.getColumnStarts(), weights.getCols(), in, out);
+}
+
+// Stores the indices of the nonzero inputs and returns their count, with the
+// same kernel selection as layerProduct
+template <typename NeuronT>
+inline int nonzeroInputs(const layerKernels &, const NeuronT *in, int size,
+                         int32_t *indices)
+{
+    int count = 0;
+
+    for (int i = 0; i < size; i++) {
+        indices[count] = i;
+        count += in[i] != 0;
+    }
+
+    return count;
+}
+
+inline int nonzeroInputs(const layerKernels &kernels, const int16_t *in,
+                         int size, int32_t *indices)
+{
+    return kernels.nonzero16(in, size, indices);
+}
+
+inline int nonzeroInputs(const layerKernels &kernels, const int8_t *in,
+                         int size, int32_t *indices)
+{
+    return kernels.nonzero8(in, size, indices);
+}
+
+// Layer product out = weights^T * in for one sample whose nonzero inputs are
+// listed in indices, from a row-major copy of the weights (see rowsKernel16)
+template <typename AccT, typename WeightT, typename NeuronT>
+inline void rowsProduct(const layerKernels &, const WeightT *weightRows,
+                        int stride, int cols, const int32_t *indices,
+                        int count, const NeuronT *in, AccT *out)
+{
+    for (int j = 0; j < cols; j++)
+        out[j] = 0;
+
+    for (int k = 0; k < count; k++) {
+        const WeightT *w = weightRows + (size_t)indices[k] * stride;
+        AccT x = in[indices[k]];
+
+        for (int j = 0; j < cols; j++)
+            out[j] += (AccT)w[j] * x;
+    }
+}
+
+inline void rowsProduct(const layerKernels &kernels,
+                        const int16_t *weightRows, int stride, int cols,
+                        const int32_t *indices, int count, const int16_t *in,
+                        int32_t *out)
+{
+    kernels.rows16(weightRows, stride, cols, indices, count, in, out);
+}
+
+inline void rowsProduct(const layerKernels &kernels, const int8_t *weightRows,
+                        int stride, int cols, const int32_t *indices,
+                        int count, const int8_t *in, int32_t *out)
+{
+    kernels.rows8(weightRows, stride, cols, indices, count, in, out);
+}
+
+// Layer product out = weights^T * in for one sample on bit-packed binary or
+// ternary weights. 8- and 16-bit inputs summed in 32 bits are split into the
+// bit planes of planesKernel16 (planes has room for them), then summed with
+// popcounts by the kernels selected for the CPU. Other types test each
+// weight's bits directly.
+template <typename AccT, typename WeightT, typename NeuronT>
+inline void ternaryLayerProduct(const layerKernels &,
+                                const ternaryWeights<WeightT> &weights,
+                                const NeuronT *in, uint64_t *, AccT *out)
+{
+    const uint64_t *positive = weights.getPositive();
+    const uint64_t *negative = weights.getNegative();
+    int stride = weights.getStride();
+
+    for (int j = 0; j < weights.getCols(); j++) {
+        AccT acc = 0;
+
+        for (int i = 0; i < weights.getRows(); i++) {
+            size_t k = (size_t)(i / 64) * stride + j;
+            uint64_t bit = (uint64_t)1 << (i % 64);
+
+            if (positive[k] & bit)
+                acc += in[i];
+            else if (!negative || (negative[k] & bit))
+                acc -= in[i];
+        }
+        out[j] = acc;
+    }
+}
+
+inline void ternaryLayerProduct(const layerKernels &kernels,
+                                const ternaryWeights<int16_t> &weights,
+                                const int16_t *in, uint64_t *planes,
+                                int32_t *out)
+{
+    int numPlanes = kernels.planes16(in, weights.getRows(), planes);
+
+    kernels.ternary(weights.getPositive(), weights.getNegative(),
+                    weights.getStride(), weights.getWords(),
+                    weights.getCols(), planes, numPlanes, out);
+}
+
+inline void ternaryLayerProduct(const layerKernels &kernels,
+                                const ternaryWeights<int8_t> &weights,
+                                const int8_t *in, uint64_t *planes,
+                                int32_t *out)
+{
+    int numPlanes = kernels.planes8(in, weights.getRows(), planes);
+
+    kernels.ternary(weights.getPositive(), weights.getNegative(),
+                    weights.getStride(), weights.getWords(),
+                    weights.getCols(), planes, numPlanes, out);
+}
+
+// Layer product out = weights^T * in for a block of count samples, sample s
+// read from in + s * inStride and summed into out + s * outStride, with the
+// same kernel selection as layerProduct. Samples are processed four at a time
+// so each weight column is loaded once for all four of them.
+template <typename AccT, typename WeightT, typename NeuronT>
+inline void blockLayerProduct(const layerKernels &, const WeightT *weights,
+                              int rows, int cols, const NeuronT *in,
+                              int inStride, int count, AccT *out,
+                              int outStride)
+{
+    int s = 0;
+
+    for (; s + 4 <= count; s += 4) {
+        const NeuronT *in0 = in + (size_t)s * inStride;
+        const NeuronT *in1 = in0 + inStride;
+        const NeuronT *in2 = in1 + inStride;
+        const NeuronT *in3 = in2 + inStride;
+        AccT *o = out + (size_t)s * outStride;
+
+        for (int j = 0; j < cols; j++) {
+            const WeightT *w = weights + (size_t)j * rows;
+            AccT acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+
+            for (int i = 0; i < rows; i++) {
+                acc0 += (AccT)w[i] * (AccT)in0[i];
+                acc1 += (AccT)w[i] * (AccT)in1[i];
+                acc2 += (AccT)w[i] * (AccT)in2[i];
+                acc3 += (AccT)w[i] * (AccT)in3[i];
+            }
+
+            o[j] = acc0;
+            o[outStride + j] = acc1;
+            o[2 * outStride + j] = acc2;
+            o[3 * outStride + j] = acc3;
+        }
+    }
+
+    for (; s < count; s++) {
+        for (int j = 0; j < cols; j++)
+            out[(size_t)s * outStride + j] = dotProduct<AccT>(
+                weights + (size_t)j * rows, in + (size_t)s * inStride, rows);
+    }
+}
+
+inline void blockLayerProduct(const layerKernels &kernels,
+                              const int16_t *weights, int rows, int cols,
+                              const int16_t *in, int inStride, int count,
+                              int32_t *out, int outStride)
+{
+    kernels.block16(weights, rows, cols, in, inStride, count, out, outStride);
+}
+
+inline void blockLayerProduct(const layerKernels &kernels,
+                              const int8_t *weights, int rows, int cols,
+                              const int8_t *in, int inStride, int count,
+                              int32_t *out, int outStride)
+{
+    kernels.block8(weights, rows, cols, in, inStride, count, out, outStride);
+}
+
+#endif
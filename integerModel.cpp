@@ -0,0 +1,1408 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <math.h>
+#include <sstream>
+#include <vector>
+
+#include "datasetFile.h"
+#include "fpConversion.h"
+#include "integerKernels.h"
+#include "integerModel.h"
+#include "modelFile.h"
+#include "rangeAnalysis.h"
+
+using namespace std;
+
+// Constructors
+template <typename NeuronT, typename WeightT, typename AccT>
+IntegerModel<NeuronT, WeightT, AccT>::IntegerModel(const vector<int> &sizes,
+                                                   int maxN,
+                                                   const vector<int> &maxW)
+    : layers(sizes.size() - 1), neuronBits(maxN), weightScale(0.0),
+      activationTable(0), compactEnabled(true),
+      kernels(&detectLayerKernels()), sparseDensity(defaultSparseDensity),
+      inputDensity(defaultInputDensity), ternaryEnabled(true),
+      narrowEnabled(true), deltaRefresh(1024),
+      latencyTracking(false)
+{
+    assert(sizes.size() >= 2 && maxW.size() == layers.size());
+    assert(maxN <= numeric_limits<NeuronT>::digits + 1);
+
+    maxNeuron = (int)pow(2, maxN - 1);
+    biasNeuron = -1 * maxNeuron + 1;
+
+    for (size_t l = 0; l < layers.size(); l++) {
+        denseLayer &layer = layers[l];
+
+        layer.sizeIn = sizes[l];
+        layer.sizeOut = sizes[l + 1];
+        layer.weightBits = maxW[l];
+        layer.maxWeight = (int)pow(2, maxW[l] - 1);
+        layer.shift = 0;
+        layer.scaleBits = 0;
+        layer.rowStride = 0;
+        layer.accumulatorBits = 0;
+        layer.narrow = false;
+
+        // The bit depths must fit the storage types (up to one saturated
+        // value) and the worst case sums must fit the accumulators
+        assert(maxW[l] <= numeric_limits<WeightT>::digits + 1);
+        assert((layer.sizeIn + 1) * pow(2, maxN + maxW[l] - 2) <=
+               (double)numeric_limits<AccT>::max());
+
+        // Initialize weights
+        layer.ownedWeights.setZero(layer.sizeIn + 1, layer.sizeOut);
+        layer.weights = layer.ownedWeights.data();
+    }
+
+    ownedActivationTable.assign(10 * maxNeuron, 0);
+    activationTable = ownedActivationTable.data();
+    updateWeightCopies();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+IntegerModel<NeuronT, WeightT, AccT>::IntegerModel(const vector<int> &sizes,
+                                                   int maxN, int maxW)
+    : IntegerModel(sizes, maxN, vector<int>(sizes.size() - 1, maxW))
+{
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+IntegerModel<NeuronT, WeightT, AccT>::IntegerModel(int numIn, int numHid,
+                                                   int numOut, int maxN,
+                                                   int maxW)
+    : IntegerModel(vector<int>{numIn, numHid, numOut}, maxN, maxW)
+{
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::setShift(int l, int shift)
+{
+    // The rounding term added before shifting must not overflow either
+    assert(shift >= 0 && shift < numeric_limits<AccT>::digits);
+    assert(shift == 0 ||
+           (layers[l].sizeIn + 1) *
+                   pow(2, neuronBits + layers[l].weightBits - 2) +
+               pow(2, shift - 1) <=
+               (double)numeric_limits<AccT>::max());
+
+    assert(shift + layers[l].scaleBits < 63);
+
+    layers[l].shift = shift;
+    clearAccumulatorBits(l + 1);
+    invalidateResults();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+int IntegerModel<NeuronT, WeightT, AccT>::maxScaleBits(int l) const
+{
+    // Products of the worst case sums with multipliers up to 2^scaleBits
+    // must fit 63 bits
+    double worstSum = (layers[l].sizeIn + 1) *
+                      pow(2, neuronBits + layers[l].weightBits - 2);
+
+    return min(30, 62 - (int)ceil(log2(worstSum + 1)));
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::setScales(
+    int l, const vector<int32_t> &scales, int scaleBits)
+{
+    denseLayer &layer = layers[l];
+
+    assert(scales.empty() || (int)scales.size() == layer.sizeOut);
+    assert(scales.empty() ||
+           (scaleBits > 0 && scaleBits <= maxScaleBits(l) &&
+            scaleBits + layer.shift < 63));
+
+    layer.scales = scales;
+    layer.scaleBits = scales.empty() ? 0 : scaleBits;
+    clearAccumulatorBits(l + 1);
+    invalidateResults();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+bool IntegerModel<NeuronT, WeightT, AccT>::weightsOwned() const
+{
+    for (size_t l = 0; l < layers.size(); l++) {
+        if (layers[l].weights != layers[l].ownedWeights.data())
+            return false;
+    }
+
+    return true;
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::useOwnedWeights()
+{
+    if (weightsOwned())
+        return;
+
+    // Copy the mapped weights so they can be written, then drop the mapping
+    // once nothing points into it
+    for (size_t l = 0; l < layers.size(); l++) {
+        denseLayer &layer = layers[l];
+
+        layer.ownedWeights = getWeights(l);
+        layer.weights = layer.ownedWeights.data();
+    }
+
+    if (activationTable == ownedActivationTable.data())
+        mapping.reset();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::useOwnedActivationTable()
+{
+    if (activationTable == ownedActivationTable.data())
+        return;
+
+    ownedActivationTable.assign(activationTable,
+                                activationTable + 10 * maxNeuron);
+    activationTable = ownedActivationTable.data();
+
+    if (weightsOwned())
+        mapping.reset();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+NeuronT IntegerModel<NeuronT, WeightT, AccT>::activationFunction(AccT in) const
+{
+    // Look Up Table used for integer activation function
+    if (in >= 5 * maxNeuron)
+        return saturateCast<NeuronT>(maxNeuron);
+    else if (in <= -5 * maxNeuron)
+        return 0;
+    else if (compactTable.isValid())
+        return saturateCast<NeuronT>(compactTable.lookup((int)in));
+    else
+        return saturateCast<NeuronT>(
+            activationTable[(int)in + 5 * maxNeuron]);
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::updateCompactTable()
+{
+    if (compactEnabled)
+        compactTable.build(activationTable, maxNeuron);
+    else
+        compactTable.clear();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::setCompactActivation(bool enable)
+{
+    compactEnabled = enable;
+    updateCompactTable();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::updateWeightCopies()
+{
+    for (size_t l = 0; l < layers.size(); l++) {
+        denseLayer &layer = layers[l];
+
+        if (ternaryEnabled)
+            layer.ternary.build(layer.weights, layer.sizeIn + 1,
+                                layer.sizeOut);
+        else
+            layer.ternary.clear();
+
+        // Packed layers have no use for a sparse copy
+        if (sparseDensity > 0.0 && !layer.ternary.isValid())
+            layer.sparse.build(layer.weights, layer.sizeIn + 1, layer.sizeOut,
+                               sparseDensity);
+        else
+            layer.sparse.clear();
+    }
+
+    // Rows of the first layer, transposed from its weight columns
+    denseLayer &first = layers[0];
+
+    vector<WeightT>().swap(first.weightRows);
+    first.rowStride = 0;
+
+    if (inputDensity > 0.0) {
+        weightMap weights = getWeights(0);
+
+        first.rowStride = (first.sizeOut + weightRowsAlignment - 1) /
+                          weightRowsAlignment * weightRowsAlignment;
+        first.weightRows.assign((size_t)(first.sizeIn + 1) * first.rowStride,
+                                0);
+
+        for (int i = 0; i <= first.sizeIn; i++) {
+            for (int j = 0; j < first.sizeOut; j++)
+                first.weightRows[(size_t)i * first.rowStride + j] =
+                    weights(i, j);
+        }
+    }
+
+    updateNarrowLayers();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::updateNarrowLayers()
+{
+    // The narrow kernels move the sign of each neuron onto its weight, which
+    // the most negative weight does not survive
+    for (size_t l = 0; l < layers.size(); l++) {
+        denseLayer &layer = layers[l];
+        const WeightT *weights = layer.weights;
+        size_t size = (size_t)(layer.sizeIn + 1) * layer.sizeOut;
+
+        layer.narrow = narrowEnabled && sizeof(NeuronT) == 1 &&
+                       sizeof(WeightT) == 1 && layer.accumulatorBits > 0 &&
+                       layer.accumulatorBits <= 16 &&
+                       find(weights, weights + size,
+                            numeric_limits<WeightT>::min()) == weights + size;
+    }
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::clearAccumulatorBits(int first)
+{
+    for (size_t l = first; l < layers.size(); l++)
+        layers[l].accumulatorBits = 0;
+    updateNarrowLayers();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::setAccumulatorBits(int l, int bits)
+{
+    assert(bits >= 0 && bits <= 64);
+
+    layers[l].accumulatorBits = bits;
+    updateNarrowLayers();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::setNarrowAccumulators(bool enable)
+{
+    narrowEnabled = enable;
+    updateNarrowLayers();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::invalidateResults()
+{
+    if (cache)
+        cache->clear();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::enableResultCache(
+    size_t capacity, int numShards, cacheEviction eviction, bool keepOutputs)
+{
+    cache.reset(new cacheType(getSizeInput(), getSizeOutput(), capacity,
+                              numShards, eviction, keepOutputs));
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+cacheStats IntegerModel<NeuronT, WeightT, AccT>::getResultCacheStats() const
+{
+    cacheStats none = {0, 0, 0, 0, 0, 0};
+
+    return cache ? cache->getStats() : none;
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::setSparseDensity(double density)
+{
+    sparseDensity = density;
+    updateWeightCopies();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::setTernaryWeights(bool enable)
+{
+    ternaryEnabled = enable;
+    updateWeightCopies();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::setInputDensity(double density)
+{
+    inputDensity = density;
+    updateWeightCopies();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+inline AccT IntegerModel<NeuronT, WeightT, AccT>::requantize(AccT sum,
+                                                            int shift) const
+{
+    // Division by 2^shift, rounding to nearest (right shifts of negative
+    // values are arithmetic with the compilers this builds with)
+    if (shift == 0)
+        return sum;
+    else
+        return (sum + ((AccT)1 << (shift - 1))) >> shift;
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+inline AccT IntegerModel<NeuronT, WeightT, AccT>::rescale(
+    const denseLayer &layer, AccT sum, int j) const
+{
+    if (layer.scales.empty())
+        return requantize(sum, layer.shift);
+
+    // Multipliers are at most 1.0 (maxWeight for binary and ternary weights,
+    // whose sums are that much smaller), so the result fits AccT again
+    int bits = layer.scaleBits + layer.shift;
+    int64_t product = (int64_t)sum * layer.scales[j];
+
+    return (AccT)((product + ((int64_t)1 << (bits - 1))) >> bits);
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::product(const denseLayer &layer,
+                                                   const NeuronT *in,
+                                                   AccT *out,
+                                                   int32_t *inputIndices,
+                                                   uint64_t *inputPlanes) const
+{
+    int rows = layer.sizeIn + 1;
+
+    // Sparse inputs - Only the rows of the nonzero inputs, when few enough
+    if (inputIndices && !layer.weightRows.empty()) {
+        int count = nonzeroInputs(*kernels, in, rows, inputIndices);
+
+        if (count <= inputDensity * rows) {
+            rowsProduct(*kernels, layer.weightRows.data(), layer.rowStride,
+                        layer.sizeOut, inputIndices, count, in, out);
+            return;
+        }
+    }
+
+    // Binary and ternary weights - Popcounts over the input bit planes
+    if (layer.ternary.isValid())
+        ternaryLayerProduct(*kernels, layer.ternary, in, inputPlanes, out);
+    else if (layer.sparse.isValid())
+        sparseLayerProduct(*kernels, layer.sparse, in, out);
+    else if (layer.narrow)
+        narrowLayerProduct(*kernels, layer.weights, rows, layer.sizeOut, in,
+                           out);
+    else
+        layerProduct(*kernels, layer.weights, rows, layer.sizeOut, in, out);
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+NeuronT IntegerModel<NeuronT, WeightT, AccT>::activateSum(int l, AccT sum,
+                                                         int j) const
+{
+    return activationFunction(rescale(layers[l], sum, j));
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::activateLayer(contextType &context,
+                                                         int l,
+                                                         const AccT *sums) const
+{
+    const denseLayer &layer = layers[l];
+    neuronVector &neuronsOut = context.neurons[l + 1];
+
+    for (int j = 0; j < layer.sizeOut; j++)
+        neuronsOut(j) = activationFunction(rescale(layer, sums[j], j));
+    if (l + 1 < (int)layers.size())
+        neuronsOut(layer.sizeOut) = biasNeuron;
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::feedForwardLayers(
+    contextType &context, int first) const
+{
+    AccT *sums = context.neuronSums.data();
+
+    for (int l = first; l < (int)layers.size(); l++) {
+        product(layers[l], context.neurons[l].data(), sums,
+                l == 0 ? context.inputIndices.data() : 0,
+                context.inputPlanes.data());
+        activateLayer(context, l, sums);
+    }
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::feedForward(contextType &context,
+                                                       const NeuronT *in) const
+{
+    neuronVector &neuronsInput = context.neurons[0];
+    copy(in, in + layers[0].sizeIn, neuronsInput.data());
+    neuronsInput(layers[0].sizeIn) = biasNeuron;
+
+    feedForwardLayers(context, 0);
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::updateDelta(contextType &context,
+                                                       int count) const
+{
+    typedef typename make_unsigned<AccT>::type unsignedAcc;
+
+    const denseLayer &first = layers[0];
+    AccT *sums = context.deltaSums.data();
+
+    // Changed rows times their change, summed as unsigned: partial sums may
+    // leave the range of AccT even though the final ones do not
+    if (context.deltaUpdates >= 0) {
+        bool rowMajor = !first.weightRows.empty();
+        size_t step = rowMajor ? 1 : first.sizeIn + 1;
+
+        for (int k = 0; k < count; k++) {
+            int i = context.inputIndices[k];
+            unsignedAcc change = (unsignedAcc)context.deltaChanges[k];
+            const WeightT *w =
+                rowMajor ? &first.weightRows[(size_t)i * first.rowStride]
+                         : first.weights + i;
+
+            for (int j = 0; j < first.sizeOut; j++)
+                sums[j] = (AccT)((unsignedAcc)sums[j] +
+                                 (unsignedAcc)w[j * step] * change);
+        }
+        context.deltaUpdates++;
+    }
+
+    // Full recomputation, on the first sample and then periodically
+    if (context.deltaUpdates < 0 ||
+        (deltaRefresh > 0 && context.deltaUpdates >= deltaRefresh)) {
+        AccT *fullSums = context.neuronSums.data();
+
+        context.deltaInput(first.sizeIn) = biasNeuron;
+        product(first, context.deltaInput.data(), fullSums,
+                context.inputIndices.data(), context.inputPlanes.data());
+
+        assert(context.deltaUpdates < 0 ||
+               equal(fullSums, fullSums + first.sizeOut, sums));
+
+        copy(fullSums, fullSums + first.sizeOut, sums);
+        context.deltaUpdates = 0;
+    }
+
+    // The rest of the network is computed as usual
+    copy(context.deltaInput.data(), context.deltaInput.data() + first.sizeIn,
+         context.neurons[0].data());
+    context.neurons[0](first.sizeIn) = biasNeuron;
+
+    activateLayer(context, 0, sums);
+    feedForwardLayers(context, 1);
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::feedForwardBatch(
+    contextType &context, const Eigen::Ref<const neuronMatrix> &in, int first,
+    int count) const
+{
+    typedef Eigen::Block<neuronMatrix> neuronBlock;
+    typedef Eigen::Block<typename matrices::accMatrix> accBlock;
+
+    int numLayers = layers.size();
+
+    // Each layer is computed as a matrix-matrix product over a block of
+    // samples, so the weights are streamed once per block instead of once per
+    // sample. Blocks are views on the context's scratch, which only grows.
+    context.reserveBatch(count);
+
+    neuronBlock batchInput = context.batchNeurons[0].topLeftCorner(
+        layers[0].sizeIn + 1, count);
+    batchInput.topRows(layers[0].sizeIn) = in.middleCols(first, count);
+    batchInput.row(layers[0].sizeIn).setConstant(biasNeuron);
+
+    for (int l = 0; l < numLayers; l++) {
+        const denseLayer &layer = layers[l];
+        bool hasBias = l + 1 < numLayers;
+
+        neuronBlock batchIn = context.batchNeurons[l].topLeftCorner(
+            layer.sizeIn + 1, count);
+        neuronBlock batchOut = context.batchNeurons[l + 1].topLeftCorner(
+            layer.sizeOut + (hasBias ? 1 : 0), count);
+        accBlock sums = context.batchSums.topLeftCorner(layer.sizeOut, count);
+
+        // Layers with packed, sparse weights, sparse inputs or narrow
+        // accumulators go through their kernels one sample at a time, their
+        // weights are small enough to stay in cache across the block
+        if (layer.ternary.isValid() || layer.sparse.isValid() ||
+            layer.narrow || !layer.weightRows.empty()) {
+            for (int s = 0; s < count; s++)
+                product(layer, batchIn.col(s).data(), sums.col(s).data(),
+                        l == 0 ? context.inputIndices.data() : 0,
+                        context.inputPlanes.data());
+        } else {
+            blockLayerProduct(*kernels, layer.weights, layer.sizeIn + 1,
+                              layer.sizeOut, batchIn.data(),
+                              batchIn.outerStride(), count, sums.data(),
+                              sums.outerStride());
+        }
+
+        for (int s = 0; s < count; s++) {
+            for (int j = 0; j < layer.sizeOut; j++)
+                batchOut(j, s) =
+                    activationFunction(rescale(layer, sums(j, s), j));
+        }
+        if (hasBias)
+            batchOut.row(layer.sizeOut).setConstant(biasNeuron);
+    }
+}
+
+// Label of the weights of layer l of numLayers in text weights files
+static string weightsLabel(int l, int numLayers)
+{
+    return string("Weights ") + (l == 0 ? "Input" : "Hidden") + " To " +
+           (l == numLayers - 1 ? "Output" : "Hidden") + ":";
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+bool IntegerModel<NeuronT, WeightT, AccT>::saveWeights(string outFile) const
+{
+    fstream output;
+    output.open(outFile, ios::out);
+
+    if (output.is_open()) {
+        int numLayers = layers.size();
+
+        output << "Dimensions:\n" << getLayerSize(0);
+        for (int l = 1; l <= numLayers; l++)
+            output << " " << getLayerSize(l);
+        output << endl;
+
+        for (int l = 0; l < numLayers; l++) {
+            weightMap weights = getWeights(l);
+
+            output << weightsLabel(l, numLayers) << "\n";
+            for (int i = 0; i < weights.rows(); i++) {
+                for (int j = 0; j < weights.cols(); j++)
+                    output << (int)weights(i, j) << " ";
+                output << endl;
+            }
+        }
+
+        // Output scales of the scaled layers, after all weights: fraction
+        // bits, then one multiplier per output neuron
+        for (int l = 0; l < numLayers; l++) {
+            if (layers[l].scales.empty())
+                continue;
+
+            output << "Scales " << weightsLabel(l, numLayers) << "\n"
+                   << layers[l].scaleBits;
+            for (size_t j = 0; j < layers[l].scales.size(); j++)
+                output << " " << layers[l].scales[j];
+            output << endl;
+        }
+
+        output.close();
+        return true;
+    } else {
+        return false;
+    }
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+bool IntegerModel<NeuronT, WeightT, AccT>::loadWeights(string inFile)
+{
+    fstream input;
+    input.open(inFile, ios::in);
+
+    if (input.is_open()) {
+        int numLayers = layers.size();
+        vector<int> sizes;
+        int temp;
+        string line = "";
+
+        getline(input, line); // Dimensions Label
+        getline(input, line); // Dimensions
+        istringstream dimensions(line);
+        while (dimensions >> temp)
+            sizes.push_back(temp);
+
+        bool sizesMatch = (int)sizes.size() == numLayers + 1;
+        for (int l = 0; sizesMatch && l <= numLayers; l++)
+            sizesMatch = sizes[l] == getLayerSize(l);
+
+        if (!sizesMatch)
+            return false;
+
+        // The whole file is read and checked before the model changes, a
+        // bad file leaves it as it was
+        vector<weightMatrix> loaded(numLayers);
+
+        // Values are read as int, operator>> would read 8-bit types as
+        // characters
+        for (int l = 0; l < numLayers; l++) {
+            weightMatrix &weights = loaded[l];
+
+            weights.resize(layers[l].sizeIn + 1, layers[l].sizeOut);
+            getline(input, line); // Weights Label
+            for (int i = 0; i < weights.rows(); i++) {
+                for (int j = 0; j < weights.cols(); j++) {
+                    input >> temp;
+                    weights(i, j) = saturateCast<WeightT>(temp);
+                }
+                getline(input, line); // Clear line feed and newline
+            }
+        }
+        if (input.fail())
+            return false;
+
+        // Optional output scales, layers without them use the global scale.
+        // Fraction bits are checked as loadModel does, rescale needs at
+        // least one and room for them and the shift in 64 bits
+        vector<vector<int32_t> > scales(numLayers);
+        vector<int> scaleBits(numLayers, 0);
+
+        while (getline(input, line)) {
+            for (int l = 0; l < numLayers; l++) {
+                if (line != "Scales " + weightsLabel(l, numLayers))
+                    continue;
+
+                scales[l].resize(layers[l].sizeOut);
+                input >> scaleBits[l];
+                for (int j = 0; j < layers[l].sizeOut; j++)
+                    input >> scales[l][j];
+                getline(input, line); // Clear line feed and newline
+
+                if (input.fail() || scaleBits[l] <= 0 ||
+                    scaleBits[l] > maxScaleBits(l) ||
+                    scaleBits[l] + layers[l].shift >= 63)
+                    return false;
+            }
+        }
+        input.close();
+
+        useOwnedWeights();
+        for (int l = 0; l < numLayers; l++) {
+            layers[l].ownedWeights.swap(loaded[l]);
+            layers[l].weights = layers[l].ownedWeights.data();
+        }
+        clearAccumulatorBits(0);
+        updateWeightCopies();
+        invalidateResults();
+
+        for (int l = 0; l < numLayers; l++)
+            setScales(l, scales[l], scaleBits[l]);
+        return true;
+    } else {
+        return false;
+    }
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+bool IntegerModel<NeuronT, WeightT, AccT>::loadActivationTable(string inFile)
+{
+    fstream input;
+    input.open(inFile, ios::in);
+
+    if (input.is_open()) {
+        useOwnedActivationTable();
+
+        for (int i = 0; i < 10 * maxNeuron; i++) {
+            input >> ownedActivationTable[i];
+        }
+
+        input.close();
+        updateCompactTable();
+        clearAccumulatorBits(1);
+        invalidateResults();
+        return true;
+    } else {
+        return false;
+    }
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+bool IntegerModel<NeuronT, WeightT, AccT>::saveModel(string outFile) const
+{
+    int numLayers = layers.size();
+
+    modelFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, modelFileMagic, sizeof(header.magic));
+    header.version = modelFileVersion;
+    header.headerSize = sizeof(header);
+    header.numLayers = numLayers;
+    header.neuronBits = neuronBits;
+    header.maxNeuron = maxNeuron;
+    header.neuronBytes = sizeof(NeuronT);
+    header.weightBytes = sizeof(WeightT);
+    header.accumulatorBytes = sizeof(AccT);
+    header.tableBytes = sizeof(int);
+    header.weightScale = weightScale;
+
+    // Block layout - Layer table, weights of each layer, activation table
+    vector<modelFileLayer> layerTable(numLayers);
+    uint64_t offset = sizeof(header) + numLayers * sizeof(modelFileLayer);
+
+    for (int l = 0; l < numLayers; l++) {
+        const denseLayer &layer = layers[l];
+        modelFileLayer &entry = layerTable[l];
+
+        memset(&entry, 0, sizeof(entry));
+        entry.sizeIn = layer.sizeIn;
+        entry.sizeOut = layer.sizeOut;
+        entry.weightBits = layer.weightBits;
+        entry.maxWeight = layer.maxWeight;
+        entry.shift = layer.shift;
+        entry.scaleBits = layer.scaleBits;
+        entry.accumulatorBits = layer.accumulatorBits;
+        entry.weightsOffset = alignModelOffset(offset);
+        entry.weightsBytes =
+            (uint64_t)(layer.sizeIn + 1) * layer.sizeOut * sizeof(WeightT);
+
+        offset = entry.weightsOffset + entry.weightsBytes;
+
+        if (!layer.scales.empty()) {
+            entry.scalesOffset = alignModelOffset(offset);
+            offset = entry.scalesOffset + layer.sizeOut * sizeof(int32_t);
+        }
+    }
+
+    header.activationOffset = alignModelOffset(offset);
+    header.activationEntries = 10 * maxNeuron;
+    header.fileSize = alignModelOffset(
+        header.activationOffset + header.activationEntries * sizeof(int));
+
+    // The file is assembled in memory, padding included, so the checksum
+    // covers exactly the bytes written
+    vector<char> file(header.fileSize, 0);
+    memcpy(&file[sizeof(header)], layerTable.data(),
+           numLayers * sizeof(modelFileLayer));
+    for (int l = 0; l < numLayers; l++) {
+        memcpy(&file[layerTable[l].weightsOffset], layers[l].weights,
+               layerTable[l].weightsBytes);
+        if (!layers[l].scales.empty()) {
+            memcpy(&file[layerTable[l].scalesOffset], layers[l].scales.data(),
+                   layers[l].sizeOut * sizeof(int32_t));
+        }
+    }
+    memcpy(&file[header.activationOffset], activationTable,
+           header.activationEntries * sizeof(int));
+
+    header.checksum = modelFileChecksum(&file[sizeof(header)],
+                                        file.size() - sizeof(header));
+    memcpy(&file[0], &header, sizeof(header));
+
+    ofstream output(outFile, ios::out | ios::binary);
+
+    if (output.is_open()) {
+        output.write(&file[0], file.size());
+        output.close();
+        return !output.fail();
+    } else {
+        return false;
+    }
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+bool IntegerModel<NeuronT, WeightT, AccT>::loadModel(string inFile,
+                                                     bool verifyChecksum)
+{
+    int numLayers = layers.size();
+
+    shared_ptr<mappedFile> file(new mappedFile());
+    modelFileHeader header;
+    vector<modelFileLayer> layerTable(numLayers);
+    size_t tableEnd = sizeof(header) + numLayers * sizeof(modelFileLayer);
+
+    if (!file->open(inFile) || file->size() < tableEnd)
+        return false;
+
+    memcpy(&header, file->data(), sizeof(header));
+
+    // Format and layer checks
+    if (memcmp(header.magic, modelFileMagic, sizeof(header.magic)) != 0 ||
+        header.version != modelFileVersion ||
+        header.headerSize != sizeof(header) ||
+        header.fileSize != file->size())
+        return false;
+
+    if (header.numLayers != numLayers || header.neuronBits != neuronBits ||
+        header.neuronBytes != sizeof(NeuronT) ||
+        header.weightBytes != sizeof(WeightT) ||
+        header.tableBytes != sizeof(int))
+        return false;
+
+    memcpy(layerTable.data(), file->data() + sizeof(header),
+           numLayers * sizeof(modelFileLayer));
+
+    // Block checks - The views need aligned blocks inside the file
+    for (int l = 0; l < numLayers; l++) {
+        const denseLayer &layer = layers[l];
+        const modelFileLayer &entry = layerTable[l];
+        uint64_t weightsBytes =
+            (uint64_t)(layer.sizeIn + 1) * layer.sizeOut * sizeof(WeightT);
+
+        if (entry.sizeIn != layer.sizeIn || entry.sizeOut != layer.sizeOut ||
+            entry.weightBits != layer.weightBits ||
+            entry.weightsBytes != weightsBytes ||
+            entry.weightsOffset % modelFileAlignment != 0 ||
+            entry.weightsOffset < tableEnd ||
+            entry.weightsOffset + weightsBytes > header.fileSize)
+            return false;
+
+        if (entry.scaleBits != 0 &&
+            (entry.scaleBits < 0 || entry.scaleBits > maxScaleBits(l) ||
+             entry.scalesOffset % sizeof(int32_t) != 0 ||
+             entry.scalesOffset < tableEnd ||
+             entry.scalesOffset + layer.sizeOut * sizeof(int32_t) >
+                 header.fileSize))
+            return false;
+
+        // Shifts of unscaled layers apply to AccT, those of scaled layers
+        // to the 64-bit products with their multipliers
+        if (entry.shift < 0 ||
+            (entry.scaleBits == 0 &&
+             entry.shift >= numeric_limits<AccT>::digits) ||
+            (entry.scaleBits != 0 && entry.shift + entry.scaleBits >= 63) ||
+            entry.accumulatorBits < 0 || entry.accumulatorBits > 64)
+            return false;
+    }
+
+    uint64_t activationBytes = (uint64_t)10 * maxNeuron * sizeof(int);
+
+    if (header.activationEntries != (uint64_t)10 * maxNeuron ||
+        header.activationOffset % modelFileAlignment != 0 ||
+        header.activationOffset + activationBytes > header.fileSize)
+        return false;
+
+    if (verifyChecksum &&
+        modelFileChecksum(file->data() + sizeof(header),
+                          file->size() - sizeof(header)) != header.checksum)
+        return false;
+
+    // Point the views at the mapped blocks and release the owned storage
+    const char *data = file->data();
+
+    for (int l = 0; l < numLayers; l++) {
+        denseLayer &layer = layers[l];
+
+        const modelFileLayer &entry = layerTable[l];
+
+        layer.weights = (const WeightT *)(data + entry.weightsOffset);
+        layer.ownedWeights.resize(0, 0);
+        layer.accumulatorBits = entry.accumulatorBits;
+
+        // Scales are small, they are copied
+        const int32_t *scales = (const int32_t *)(data + entry.scalesOffset);
+        setScales(l, vector<int32_t>(), 0);
+        setShift(l, entry.shift);
+        if (entry.scaleBits != 0) {
+            setScales(l, vector<int32_t>(scales, scales + layer.sizeOut),
+                      entry.scaleBits);
+        }
+    }
+
+    activationTable = (const int *)(data + header.activationOffset);
+    vector<int>().swap(ownedActivationTable);
+
+    mapping = file;
+    weightScale = header.weightScale;
+    updateCompactTable();
+    updateWeightCopies();
+
+    // Accumulator bits pick the narrow kernels, which overflow silently: a
+    // file claiming fewer bits than its weights' worst case over the full
+    // neuron range gets the worst case
+    bool annotated = false;
+    for (int l = 0; l < numLayers; l++)
+        annotated = annotated || layers[l].accumulatorBits != 0;
+
+    if (annotated) {
+        rangeAnalyzer<NeuronT, WeightT, AccT> ranges(*this, -maxNeuron,
+                                                     maxNeuron);
+
+        for (int l = 0; l < numLayers; l++) {
+            if (layers[l].accumulatorBits != 0)
+                layers[l].accumulatorBits = max(layers[l].accumulatorBits,
+                                                ranges.getWorstBits(l));
+        }
+        updateNarrowLayers();
+    }
+    invalidateResults();
+
+    return true;
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+int IntegerModel<NeuronT, WeightT, AccT>::classify(
+    contextType &context, const Eigen::Ref<const neuronVector> &in) const
+{
+    return classify(context, in.data(), in.size());
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+int IntegerModel<NeuronT, WeightT, AccT>::classify(contextType &context,
+                                                   const NeuronT *in,
+                                                   int size) const
+{
+    uint64_t start = latencyTracking ? latencyClock::now() : 0;
+    uint64_t key = 0;
+    bool cached = false;
+    int result;
+
+    assert(size == getSizeInput());
+    (void)size;
+
+    if (cache) {
+        key = cache->hash(in);
+        cached = cache->find(key, in, result, context.neurons.back().data());
+    }
+
+    if (!cached) {
+        feedForward(context, in);
+        result = outputClass(context);
+
+        if (cache)
+            cache->insert(key, in, result, context.neurons.back().data());
+    }
+
+    if (latencyTracking)
+        latencyRecorder::record(latencyClock::now() - start);
+
+    return result;
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+int IntegerModel<NeuronT, WeightT, AccT>::outputClass(
+    const contextType &context) const
+{
+    const neuronVector &neuronsOutput = context.neurons.back();
+    int max = -1 * maxNeuron;
+    int result = 0;
+
+    for (int k = 0; k < getSizeOutput(); k++) {
+        if (neuronsOutput(k) > max) {
+            max = neuronsOutput(k);
+            result = k;
+        }
+    }
+
+    return result;
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+int IntegerModel<NeuronT, WeightT, AccT>::classifyDelta(contextType &context,
+                                                        const NeuronT *in,
+                                                        int size) const
+{
+    uint64_t start = latencyTracking ? latencyClock::now() : 0;
+    NeuronT *previous = context.deltaInput.data();
+    int count = 0;
+
+    assert(size == getSizeInput());
+
+    for (int i = 0; i < size; i++) {
+        if (in[i] != previous[i]) {
+            context.inputIndices[count] = i;
+            context.deltaChanges[count] = (AccT)in[i] - (AccT)previous[i];
+            previous[i] = in[i];
+            count++;
+        }
+    }
+
+    updateDelta(context, count);
+    int result = outputClass(context);
+
+    if (latencyTracking)
+        latencyRecorder::record(latencyClock::now() - start);
+
+    return result;
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+int IntegerModel<NeuronT, WeightT, AccT>::classifyDelta(
+    contextType &context, const int32_t *indices, const NeuronT *values,
+    int count) const
+{
+    uint64_t start = latencyTracking ? latencyClock::now() : 0;
+    NeuronT *previous = context.deltaInput.data();
+
+    assert(count >= 0 && count <= getSizeInput());
+
+    for (int k = 0; k < count; k++) {
+        int i = indices[k];
+
+        assert(i >= 0 && i < getSizeInput());
+
+        context.inputIndices[k] = i;
+        context.deltaChanges[k] = (AccT)values[k] - (AccT)previous[i];
+        previous[i] = values[k];
+    }
+
+    updateDelta(context, count);
+    int result = outputClass(context);
+
+    if (latencyTracking)
+        latencyRecorder::record(latencyClock::now() - start);
+
+    return result;
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void IntegerModel<NeuronT, WeightT, AccT>::classifyBatch(
+    contextType &context, const Eigen::Ref<const neuronMatrix> &in,
+    int *results, int blockSize) const
+{
+    const neuronMatrix &batchOutput = context.batchNeurons.back();
+    int sizeOutput = getSizeOutput();
+
+    for (int first = 0; first < in.cols(); first += blockSize) {
+        int count = min(blockSize, (int)in.cols() - first);
+
+        feedForwardBatch(context, in, first, count);
+
+        for (int s = 0; s < count; s++) {
+            int max = -1 * maxNeuron;
+            int result = 0;
+
+            for (int k = 0; k < sizeOutput; k++) {
+                if (batchOutput(k, s) > max) {
+                    max = batchOutput(k, s);
+                    result = k;
+                }
+            }
+
+            results[first + s] = result;
+        }
+    }
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+vector<int> IntegerModel<NeuronT, WeightT, AccT>::classifyBatch(
+    contextType &context, const Eigen::Ref<const neuronMatrix> &in,
+    int blockSize) const
+{
+    vector<int> results(in.cols());
+
+    classifyBatch(context, in, results.data(), blockSize);
+
+    return results;
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+bool IntegerModel<NeuronT, WeightT, AccT>::parseFPWeights(
+    string inFile, workStealingPool &pool, vector<double> &values) const
+{
+    // The labels are skipped, which leaves the dimensions followed by the
+    // weight matrices of the layers row by row
+    int numLayers = layers.size();
+    size_t numWeights = 0;
+
+    for (int l = 0; l < numLayers; l++)
+        numWeights += (size_t)(layers[l].sizeIn + 1) * layers[l].sizeOut;
+
+    if (!parseFPFile(inFile, pool, values) ||
+        values.size() != numLayers + 1 + numWeights)
+        return false;
+
+    for (int l = 0; l <= numLayers; l++) {
+        if (values[l] != getLayerSize(l))
+            return false;
+    }
+
+    return true;
+}
+
+// Means of sums / counts over the groups of weight columns sharing a scale,
+// stored for each column (0 for groups with nothing counted)
+static void groupMeans(const vector<double> &sums,
+                       const vector<double> &counts,
+                       const vector<int> &firstColumn, weightScaling scaling,
+                       vector<double> &means)
+{
+    int numColumns = sums.size();
+    vector<double> groupSums(numColumns, 0.0), groupCounts(numColumns, 0.0);
+    vector<int> groups(numColumns);
+
+    for (int column = 0; column < numColumns; column++) {
+        int l = upper_bound(firstColumn.begin(), firstColumn.end(), column) -
+                firstColumn.begin() - 1;
+
+        groups[column] = scaling == scalePerNeuron  ? column
+                         : scaling == scalePerLayer ? l
+                                                    : 0;
+        groupSums[groups[column]] += sums[column];
+        groupCounts[groups[column]] += counts[column];
+    }
+
+    for (int column = 0; column < numColumns; column++) {
+        int g = groups[column];
+        means[column] = groupCounts[g] > 0.0 ? groupSums[g] / groupCounts[g]
+                                             : 0.0;
+    }
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+bool IntegerModel<NeuronT, WeightT, AccT>::convertFPWeights(
+    string inFile, string outFile, weightScaling scaling,
+    weightQuantization quantization)
+{
+    workStealingPool pool(conversionThreads());
+    vector<double> values;
+    int numLayers = layers.size();
+
+    // The file is parsed once, for both the scales and the conversion
+    if (!parseFPWeights(inFile, pool, values))
+        return false;
+
+    double max = maxAbsolute(values, numLayers + 1, pool);
+
+    useOwnedWeights();
+    weightScale = max;
+
+    // Rows and columns of all layers follow each other
+    vector<int> firstRow(numLayers + 1, 0), firstColumn(numLayers + 1, 0);
+    vector<const double *> layerValues(numLayers);
+    const double *next = &values[numLayers + 1];
+
+    for (int l = 0; l < numLayers; l++) {
+        firstRow[l + 1] = firstRow[l] + layers[l].sizeIn + 1;
+        firstColumn[l + 1] = firstColumn[l] + layers[l].sizeOut;
+        layerValues[l] = next;
+        next += (size_t)(layers[l].sizeIn + 1) * layers[l].sizeOut;
+    }
+
+    // Scale of each output neuron - One task per weight column
+    int numColumns = firstColumn[numLayers];
+    vector<double> columnScales(numColumns, max);
+
+    // Binary and ternary weights - Weights become -1, 0 or +1 times the scale
+    // of their group: the mean absolute weight for binary weights, and for
+    // ternary ones (as in ternary weight networks) the mean absolute weight
+    // over those above 0.7 times it, the others becoming 0
+    vector<double> thresholds(numColumns, -1.0);
+
+    if (quantization != quantizeLinear) {
+        vector<double> sums(numColumns), counts(numColumns);
+
+        auto sumColumns = [&]() {
+            pool.run(numColumns, [&](int, int column) {
+                int l = upper_bound(firstColumn.begin(), firstColumn.end(),
+                                    column) -
+                        firstColumn.begin() - 1;
+                const denseLayer &layer = layers[l];
+                int j = column - firstColumn[l];
+
+                sums[column] = counts[column] = 0.0;
+                for (int i = 0; i <= layer.sizeIn; i++) {
+                    double weight =
+                        fabs(layerValues[l][(size_t)i * layer.sizeOut + j]);
+
+                    if (weight > thresholds[column]) {
+                        sums[column] += weight;
+                        counts[column] += 1.0;
+                    }
+                }
+            });
+        };
+
+        sumColumns();
+        groupMeans(sums, counts, firstColumn, scaling, columnScales);
+
+        if (quantization == quantizeTernary) {
+            for (int column = 0; column < numColumns; column++)
+                thresholds[column] = 0.7 * columnScales[column];
+
+            sumColumns();
+            groupMeans(sums, counts, firstColumn, scaling, columnScales);
+        }
+    } else if (scaling != scaleGlobal) {
+        pool.run(numColumns, [&](int, int column) {
+            int l = upper_bound(firstColumn.begin(), firstColumn.end(),
+                                column) -
+                    firstColumn.begin() - 1;
+            const denseLayer &layer = layers[l];
+            int j = column - firstColumn[l];
+            double columnMax = 0.0;
+
+            for (int i = 0; i <= layer.sizeIn; i++) {
+                columnMax = fmax(
+                    columnMax,
+                    fabs(layerValues[l][(size_t)i * layer.sizeOut + j]));
+            }
+            columnScales[column] = columnMax;
+        });
+
+        for (int l = 0; l < numLayers; l++) {
+            double *scales = &columnScales[firstColumn[l]];
+            int sizeOut = layers[l].sizeOut;
+
+            if (scaling == scalePerLayer)
+                fill(scales, scales + sizeOut,
+                     *max_element(scales, scales + sizeOut));
+
+            // All-zero columns keep the global scale
+            for (int j = 0; j < sizeOut; j++) {
+                if (scales[j] == 0.0)
+                    scales[j] = max;
+            }
+        }
+    }
+
+    // Quantization - One task per weight row
+    pool.run(firstRow[numLayers], [&](int, int row) {
+        int l = upper_bound(firstRow.begin(), firstRow.end(), row) -
+                firstRow.begin() - 1;
+        denseLayer &layer = layers[l];
+        const double *scales = &columnScales[firstColumn[l]];
+        const double *limits = &thresholds[firstColumn[l]];
+        int i = row - firstRow[l];
+
+        for (int j = 0; j < layer.sizeOut; j++) {
+            double temp = layerValues[l][(size_t)i * layer.sizeOut + j];
+
+            if (quantization != quantizeLinear)
+                layer.ownedWeights(i, j) =
+                    fabs(temp) <= limits[j] ? 0 : temp < 0.0 ? -1 : 1;
+            else
+                layer.ownedWeights(i, j) = saturateCast<WeightT>(
+                    (int)((temp / scales[j]) * (double)layer.maxWeight));
+        }
+    });
+
+    // Multipliers bringing each output back to the global scale
+    for (int l = 0; l < numLayers; l++) {
+        vector<int32_t> multipliers;
+        int scaleBits = maxScaleBits(l);
+
+        if (scaling != scaleGlobal || quantization != quantizeLinear) {
+            for (int j = 0; j < layers[l].sizeOut; j++) {
+                double ratio = columnScales[firstColumn[l] + j] / max;
+                multipliers.push_back(
+                    (int32_t)min(llround(ratio * pow(2, scaleBits)),
+                                 1ll << scaleBits));
+            }
+        }
+
+        // Binary and ternary weights of 1 stand for their group's scale
+        // times maxWeight, one fraction bit less per weight bit above 1
+        // multiplies them by it
+        if (quantization != quantizeLinear)
+            scaleBits -= layers[l].weightBits - 1;
+
+        setScales(l, multipliers, scaleBits);
+    }
+
+    clearAccumulatorBits(0);
+    updateWeightCopies();
+    invalidateResults();
+    saveWeights(outFile);
+    return true;
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+double IntegerModel<NeuronT, WeightT, AccT>::getMaxFPWeight(string inFile) const
+{
+    workStealingPool pool(conversionThreads());
+    vector<double> values;
+
+    if (!parseFPWeights(inFile, pool, values))
+        return 0.0;
+
+    return maxAbsolute(values, layers.size() + 1, pool);
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+bool IntegerModel<NeuronT, WeightT, AccT>::buildActivationTable(string outFile)
+{
+    fstream output;
+    output.open(outFile, ios::out);
+
+    if (output.is_open()) {
+        useOwnedActivationTable();
+
+        for (int i = 0; i < 10 * maxNeuron; i++) {
+            ownedActivationTable[i] =
+                (int)((double)maxNeuron /
+                      (1.0 + exp(-((double)i - (5.0 * (double)maxNeuron)) /
+                                 (double)maxNeuron)));
+            output << ownedActivationTable[i] << endl;
+        }
+
+        output.close();
+        updateCompactTable();
+        clearAccumulatorBits(1);
+        invalidateResults();
+        return true;
+    } else {
+        return false;
+    }
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+bool IntegerModel<NeuronT, WeightT, AccT>::convertFPInputs(
+    string inFile, string outFile, string datasetFile, string labelsFile,
+    double inputScale) const
+{
+    workStealingPool pool(conversionThreads());
+    vector<double> values;
+
+    // The file is parsed once, the largest value scales all inputs unless
+    // the scale is given
+    if (!parseFPFile(inFile, pool, values) || values.empty())
+        return false;
+
+    double max = inputScale > 0.0 ? inputScale : maxAbsolute(values, 0, pool);
+
+    // Only complete samples are converted, in chunks of samples
+    int sizeInput = getSizeInput();
+    size_t numSamples = values.size() / sizeInput;
+    int numChunks = pool.getNumThreads() * 4;
+    vector<int> quantized(numSamples * sizeInput);
+    vector<string> text(outFile.empty() ? 0 : numChunks);
+    vector<NeuronT> samples(datasetFile.empty() ? 0 : quantized.size());
+
+    pool.run(numChunks, [&](int, int c) {
+        size_t first = numSamples * c / numChunks * sizeInput;
+        size_t end = numSamples * (c + 1) / numChunks * sizeInput;
+
+        for (size_t i = first; i < end; i++)
+            quantized[i] = (int)((double)maxNeuron * (values[i] / max));
+
+        if (!text.empty()) {
+            for (size_t i = first; i < end; i++) {
+                appendInt(text[c], quantized[i]);
+                text[c] += (i + 1) % sizeInput == 0 ? " \n" : " ";
+            }
+        }
+
+        if (!samples.empty()) {
+            for (size_t i = first; i < end; i++)
+                samples[i] = saturateCast<NeuronT>(quantized[i]);
+        }
+    });
+
+    if (!outFile.empty()) {
+        ofstream output(outFile, ios::out);
+        if (!output.is_open())
+            return false;
+
+        for (int c = 0; c < numChunks; c++)
+            output << text[c];
+        output.close();
+    }
+
+    if (datasetFile.empty())
+        return true;
+
+    // Labels, one per sample
+    vector<int32_t> labels;
+
+    if (!labelsFile.empty()) {
+        fstream input;
+        int temp;
+
+        input.open(labelsFile, ios::in);
+        if (!input.is_open())
+            return false;
+
+        for (size_t s = 0; s < numSamples && input >> temp; s++)
+            labels.push_back(temp);
+        input.close();
+    }
+
+    return writeDatasetFile(datasetFile, sizeInput, neuronBits, samples,
+                            labelsFile.empty() ? 0 : &labels);
+}
+
+INSTANTIATE_INTEGER_NET(IntegerModel)
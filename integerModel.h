@@ -0,0 +1,355 @@
+#ifndef IntegerModel_H
+#define IntegerModel_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "compactActivation.h"
+#include "ext/eigen-library/Eigen/Core"
+#include "inferenceContext.h"
+#include "integerTypes.h"
+#include "latencyHistogram.h"
+#include "layerKernels.h"
+#include "mappedFile.h"
+#include "resultCache.h"
+#include "sparseWeights.h"
+#include "ternaryWeights.h"
+#include "workStealingPool.h"
+
+using namespace std;
+
+// Granularity of the weight scales chosen by convertFPWeights. Weights are
+// always quantized against the largest absolute weight of their group.
+enum weightScaling {
+    scaleGlobal,   // One scale for the whole model
+    scalePerLayer, // One scale per layer
+    scalePerNeuron // One scale per output neuron (weight column)
+};
+
+// Weight values chosen by convertFPWeights. Binary and ternary weights are
+// -1, 0 or +1 times one scale per group of the weight scaling, kept in the
+// output multipliers. Their accumulators are brought back to the scale of
+// linear weights at the layer's weight bit depth, so the shifts and the
+// activation table of a linear model at that depth carry over.
+enum weightQuantization {
+    quantizeLinear, // Weights scaled to the full weight bit depth
+    quantizeBinary, // Signs of the weights, 0 counting as positive
+    quantizeTernary // Signs of the largest weights, the others 0
+};
+
+// Fraction of nonzero inputs under which the first layer only sums the
+// weight rows of the nonzero inputs (see tools/sparseBench.cpp)
+const double defaultInputDensity = 0.3;
+
+// Read-only part of the network: a stack of dense layers and the activation
+// table. Once loaded, a model may be shared by const reference between any
+// number of threads, each classifying with its own InferenceContext.
+//
+// Neurons and weights are stored in NeuronT and WeightT, products are summed
+// in AccT. integerNetTypes picks them from the bit depths. Neurons share one
+// bit depth, each layer has its own weight bit depth and requantization
+// shift: its accumulators are divided by 2^shift (rounding to nearest, with
+// an arithmetic shift) before the activation function.
+//
+// Layers converted with per-layer or per-neuron scales also keep, for each
+// output neuron, the ratio of its weight scale to the global one as a
+// fixed-point multiplier with scaleBits fraction bits. The accumulators are
+// multiplied by it in 64 bits, then shifted by scaleBits + shift, so the
+// activation sees the same index range as with one global scale.
+template <typename NeuronT, typename WeightT, typename AccT>
+class IntegerModel
+{
+  public:
+    typedef integerNetMatrices<NeuronT, WeightT, AccT> matrices;
+    typedef typename matrices::neuronVector neuronVector;
+    typedef typename matrices::neuronMatrix neuronMatrix;
+    typedef typename matrices::weightMatrix weightMatrix;
+    typedef Eigen::Map<const weightMatrix> weightMap;
+    typedef InferenceContext<NeuronT, WeightT, AccT> contextType;
+    typedef resultCache<NeuronT> cacheType;
+
+  private:
+    static_assert(integerNetCheck<NeuronT, WeightT, AccT>::value, "");
+
+    // Dense layer - out = activation(requantize(weights^T * [in; bias]))
+    struct denseLayer {
+        // Sizes, not counting the bias neuron appended to the input
+        int sizeIn, sizeOut;
+
+        // Integer Range - Bit depth and bound of the weights
+        int weightBits, maxWeight;
+
+        // Requantization shift of the accumulators
+        int shift;
+
+        // Output scales - Fixed-point multipliers, empty with a global scale
+        int scaleBits;
+        vector<int32_t> scales;
+
+        // Owned storage, and the (sizeIn + 1) x sizeOut column-major weights
+        // in use - Either the owned storage or the mapped file
+        weightMatrix ownedWeights;
+        const WeightT *weights;
+
+        // Blocked sparse copy of the weights, built when sparse enough and
+        // then used for products instead of them
+        sparseWeights<WeightT> sparse;
+
+        // Bit-packed copy of binary or ternary weights, built when all of
+        // them are -1, 0 or +1 and then used for products instead of them
+        ternaryWeights<WeightT> ternary;
+
+        // Bits every partial sum of the products fits in, 0 if unknown, and
+        // whether products go through the narrow-accumulator kernels
+        int accumulatorBits;
+        bool narrow;
+
+        // Row-major copy of the weights, rows padded with zeros to rowStride
+        // - First layer only, for samples with mostly zero inputs
+        vector<WeightT> weightRows;
+        int rowStride;
+    };
+
+    vector<denseLayer> layers;
+
+    // Integer Ranges - Bit depth and bound of integer scales in power of 2
+    int neuronBits, maxNeuron;
+
+    // Largest absolute floating-point weight, 0 until weights are converted
+    double weightScale;
+
+    // Bias neuron value
+    NeuronT biasNeuron;
+
+    // Activation LUT in use, and its owned storage
+    vector<int> ownedActivationTable;
+    const int *activationTable;
+
+    // Mapped binary model file, if weights or table point into it
+    shared_ptr<mappedFile> mapping;
+
+    // Compact copy of the activation LUT, used whenever it encodes the table
+    // exactly - Rebuilt each time the table changes
+    compactActivation compactTable;
+    bool compactEnabled;
+
+    // Layer product kernels - Selected for the CPU at construction
+    const layerKernels *kernels;
+
+    // Block density under which layers use sparse weights, 0 for never
+    double sparseDensity;
+
+    // Fraction of nonzero inputs under which the first layer skips the zero
+    // ones, 0 for never
+    double inputDensity;
+
+    // Use the bit-packed copy of binary and ternary layers
+    bool ternaryEnabled;
+
+    // Use the narrow-accumulator kernels on layers known to be safe
+    bool narrowEnabled;
+
+    // Incremental updates between full recomputations, 0 for never
+    int deltaRefresh;
+
+    // Results of classify, shared by all contexts - Null unless enabled
+    unique_ptr<cacheType> cache;
+
+    // Record the latency of each classify and classifyDelta call
+    bool latencyTracking;
+
+    // Functions - Private member functions
+    AccT requantize(AccT sum, int shift) const;
+    AccT rescale(const denseLayer &layer, AccT sum, int j) const;
+    int maxScaleBits(int l) const;
+    bool weightsOwned() const;
+    void useOwnedWeights();
+    void useOwnedActivationTable();
+    void updateCompactTable();
+    void updateWeightCopies();
+    void updateNarrowLayers();
+    void clearAccumulatorBits(int first);
+    void invalidateResults();
+    bool parseFPWeights(string inFile, workStealingPool &pool,
+                        vector<double> &values) const;
+    void product(const denseLayer &layer, const NeuronT *in, AccT *out,
+                 int32_t *inputIndices, uint64_t *inputPlanes) const;
+    void activateLayer(contextType &context, int l, const AccT *sums) const;
+    void feedForwardLayers(contextType &context, int first) const;
+    void feedForward(contextType &context, const NeuronT *in) const;
+    void updateDelta(contextType &context, int count) const;
+    int outputClass(const contextType &context) const;
+    void feedForwardBatch(contextType &context,
+                          const Eigen::Ref<const neuronMatrix> &in, int first,
+                          int count) const;
+
+  public:
+    // Constructors - sizes lists the input size then the size of each layer,
+    // maxN and maxW are the bit depths of neurons and weights (one per layer
+    // or shared), they must fit NeuronT and WeightT. Shifts start at 0.
+    IntegerModel(const vector<int> &sizes, int maxN, const vector<int> &maxW);
+    IntegerModel(const vector<int> &sizes, int maxN, int maxW);
+    IntegerModel(int numIn, int numHid, int numOut, int maxN, int maxW);
+
+    // Views point into the model itself, copies would share them
+    IntegerModel(const IntegerModel &) = delete;
+    IntegerModel &operator=(const IntegerModel &) = delete;
+
+    // Layers - Layer sizes are numbered from the input (0) to the output
+    // (getNumLayers()), weights and shifts from the first layer (0)
+    int getNumLayers() const { return layers.size(); }
+    int getLayerSize(int l) const
+    {
+        return l == 0 ? layers[0].sizeIn : layers[l - 1].sizeOut;
+    }
+    int getSizeInput() const { return layers.front().sizeIn; }
+    int getSizeOutput() const { return layers.back().sizeOut; }
+    int getNeuronBits() const { return neuronBits; }
+    int getMaxNeuron() const { return maxNeuron; }
+    NeuronT getBiasNeuron() const { return biasNeuron; }
+    int getWeightBits(int l) const { return layers[l].weightBits; }
+    int getShift(int l) const { return layers[l].shift; }
+    void setShift(int l, int shift);
+    int getScaleBits(int l) const { return layers[l].scaleBits; }
+    const vector<int32_t> &getScales(int l) const { return layers[l].scales; }
+    // Multipliers of each output neuron, with up to maxScaleBits fraction
+    // bits, or none to drop the layer's scales
+    void setScales(int l, const vector<int32_t> &scales, int scaleBits);
+    weightMap getWeights(int l) const
+    {
+        return weightMap(layers[l].weights, layers[l].sizeIn + 1,
+                         layers[l].sizeOut);
+    }
+
+    // Layer product kernels, only used for 8- and 16-bit operands
+    const layerKernels &getKernels() const { return *kernels; }
+    void setKernels(const layerKernels &k) { kernels = &k; }
+
+    // Sparse weights - Layers whose weights are zero in all but sparseDensity
+    // of their blocks (see sparseWeights.h) keep a sparse copy and skip the
+    // zero blocks. Chosen again each time weights are loaded or converted,
+    // the copy is owned even when the model is mapped.
+    bool usesSparseWeights(int l) const { return layers[l].sparse.isValid(); }
+    double getSparseDensity() const { return sparseDensity; }
+    void setSparseDensity(double density);
+
+    // Binary and ternary weights - Layers whose weights are all -1, 0 or +1
+    // (see convertFPWeights) keep a bit-packed copy and sum their products
+    // with popcounts over the bit planes of the inputs (see ternaryWeights.h).
+    // Chosen again each time weights are loaded or converted, and used
+    // instead of sparse weights (samples with sparse inputs still skip their
+    // zero inputs).
+    bool usesTernaryWeights(int l) const { return layers[l].ternary.isValid(); }
+    bool getTernaryWeights() const { return ternaryEnabled; }
+    void setTernaryWeights(bool enable);
+
+    // Accumulator ranges - Bits every partial sum of a layer's products fits
+    // in, in any order, as found by range analysis (see rangeAnalysis.h), 0
+    // if unknown. Saved with binary models, and cleared when the weights or,
+    // for the layers they feed, the activation table, shifts or scales
+    // change. Values are trusted, they must hold for every sample
+    // classified. Layers of 8-bit operands within 16 bits use the
+    // narrow-accumulator kernels (see narrowKernel8) unless disabled.
+    int getAccumulatorBits(int l) const { return layers[l].accumulatorBits; }
+    void setAccumulatorBits(int l, int bits);
+    bool usesNarrowAccumulators(int l) const { return layers[l].narrow; }
+    bool getNarrowAccumulators() const { return narrowEnabled; }
+    void setNarrowAccumulators(bool enable);
+
+    // Sparse inputs - Samples with at most inputDensity of their inputs
+    // nonzero skip the weight rows of the zero ones in the first layer, from
+    // a row-major copy of its weights. Checked for each sample.
+    double getInputDensity() const { return inputDensity; }
+    void setInputDensity(double density);
+
+    // Activation LUT in use, compact unless disabled or the table can not be
+    // encoded exactly
+    bool usesCompactActivation() const { return compactTable.isValid(); }
+    void setCompactActivation(bool enable);
+    // Activation of one requantized accumulator
+    NeuronT activationFunction(AccT in) const;
+    // Activation of output neuron j of layer l from its accumulator,
+    // requantized and rescaled as when classifying
+    NeuronT activateSum(int l, AccT sum, int j) const;
+
+    // Saving and Loading - Not safe while the model is used for classifying
+    bool saveWeights(string outFile) const;
+    bool loadWeights(string inFile);
+    bool loadActivationTable(string inFile);
+
+    // Binary model file with layers and activation table (see modelFile.h).
+    // Loading maps the file read-only and uses it in place, so processes
+    // loading the same file share one physical copy. Accumulator bits below
+    // the worst case of the loaded weights (see rangeAnalysis.h) are raised
+    // to it.
+    bool saveModel(string outFile) const;
+    bool loadModel(string inFile, bool verifyChecksum = true);
+
+    // Classifying - Reentrant, as long as each thread uses its own context.
+    // Samples are read in place and all scratch lives in the context, so once
+    // the context has seen the largest block size these never allocate.
+    int classify(contextType &context,
+                 const Eigen::Ref<const neuronVector> &in) const;
+    int classify(contextType &context, const NeuronT *in, int size) const;
+    void classifyBatch(contextType &context,
+                       const Eigen::Ref<const neuronMatrix> &in, int *results,
+                       int blockSize = 64) const;
+    vector<int> classifyBatch(contextType &context,
+                              const Eigen::Ref<const neuronMatrix> &in,
+                              int blockSize = 64) const;
+
+    // Incremental classifying - For streams of samples that differ in few
+    // inputs. The context keeps the inputs and first-layer accumulators of
+    // its last sample, and only adds the weight rows of the inputs that
+    // changed, times their change. Results are the same as classify's.
+    // The first sample of a context, and every getDeltaRefresh() updates,
+    // are computed in full instead (and checked against the update in debug
+    // builds). Contexts must be recreated, or their resetDelta called, after
+    // loading new weights.
+    int classifyDelta(contextType &context, const NeuronT *in,
+                      int size) const;
+    // Changes from the context's last sample, as distinct input indices and
+    // their new values (inputs start at 0 in a new context)
+    int classifyDelta(contextType &context, const int32_t *indices,
+                      const NeuronT *values, int count) const;
+    int getDeltaRefresh() const { return deltaRefresh; }
+    void setDeltaRefresh(int updates) { deltaRefresh = updates; }
+
+    // Result cache - Bounded cache of the results of classify, keyed by the
+    // sample (see resultCache.h), safe to use from any number of contexts.
+    // Cleared whenever weights, scales, shifts or the activation table
+    // change. Hits also restore the output neurons into the context when
+    // keepOutputs is set, the other layers keep their last values.
+    // classifyBatch and classifyDelta always compute their samples.
+    void enableResultCache(size_t capacity, int numShards = 16,
+                           cacheEviction eviction = evictLRU,
+                           bool keepOutputs = false);
+    void disableResultCache() { cache.reset(); }
+    bool usesResultCache() const { return cache != nullptr; }
+    cacheStats getResultCacheStats() const;
+
+    // Latencies - When enabled, every classify and classifyDelta call records
+    // its latency with latencyRecorder (see latencyHistogram.h), on the
+    // calling thread's histogram
+    bool getLatencyTracking() const { return latencyTracking; }
+    void setLatencyTracking(bool enable) { latencyTracking = enable; }
+
+    // Helper functions for new networks without integer weights or activation
+    // LUTs. Files are parsed once, on one thread per hardware thread.
+    bool convertFPWeights(string inFile, string outFile,
+                          weightScaling scaling = scaleGlobal,
+                          weightQuantization quantization = quantizeLinear);
+    double getMaxFPWeight(string inFile) const;
+    bool buildActivationTable(string outFile);
+    // Inputs are written as text to outFile and, if datasetFile is given, as
+    // a binary dataset (see datasetFile.h) with the labels read from
+    // labelsFile, if given. Either output may be skipped with an empty name.
+    // Inputs are quantized against inputScale, or the largest absolute value
+    // in the file if 0.
+    bool convertFPInputs(string inFile, string outFile,
+                         string datasetFile = "", string labelsFile = "",
+                         double inputScale = 0.0) const;
+};
+
+#endif
@@ -1,347 +1,130 @@
-#include <cstdlib>
-#include <fstream>
-#include <iostream>
-#include <math.h>
-#include <vector>
-
 #include "integerNeuralNet.h"
 
 using namespace std;
 
-// Constructor
-integerNeuralNet::integerNeuralNet(int numIn, int numHid, int numOut, int maxN,
-                                   int maxW)
-    : sizeInput(numIn), sizeHidden(numHid), sizeOutput(numOut), maxNeuron(maxN),
-      maxWeight(maxW), neuronsInput(numIn + 1), neuronsHidden(numHid + 1),
-      neuronsOutput(numOut), weightsInputToHidden(numIn + 1, numHid),
-      weightsHiddenToOutput(numHid + 1, numOut)
+// Constructors
+template <typename NeuronT, typename WeightT, typename AccT>
+integerNeuralNet<NeuronT, WeightT, AccT>::integerNeuralNet(
+    int numIn, int numHid, int numOut, int maxN, int maxW)
+    : model(numIn, numHid, numOut, maxN, maxW), context(model)
 {
-    maxNeuron = (int)pow(2, maxNeuron - 1);
-    maxWeight = (int)pow(2, maxWeight - 1);
-    biasNeuron = -1 * maxNeuron + 1;
-
-    activationTable = new int[10 * maxNeuron];
-    for (int i = 0; i < 10 * maxNeuron; i++) {
-        activationTable[i] = 0;
-    }
-
-    // Initialize layers
-    neuronsInput.setZero();
-    neuronsHidden.setZero();
-    neuronsOutput.setZero();
-
-    // Initialize weights
-    weightsInputToHidden.setZero();
-    weightsHiddenToOutput.setZero();
 }
 
-// Destructor
-integerNeuralNet::~integerNeuralNet() { delete[] activationTable; }
-
-int integerNeuralNet::activationFunction(int in)
+template <typename NeuronT, typename WeightT, typename AccT>
+integerNeuralNet<NeuronT, WeightT, AccT>::integerNeuralNet(
+    const vector<int> &sizes, int maxN, const vector<int> &maxW)
+    : model(sizes, maxN, maxW), context(model)
 {
-    // Look Up Table used for integer activation function
-    if (in >= 5 * maxNeuron)
-        return maxNeuron;
-    else if (in <= -5 * maxNeuron)
-        return 0;
-    else
-        return activationTable[in + 5 * maxNeuron];
 }
 
-void integerNeuralNet::feedForward(Eigen::VectorXi in)
+template <typename NeuronT, typename WeightT, typename AccT>
+bool integerNeuralNet<NeuronT, WeightT, AccT>::saveWeights(string outFile)
 {
-    neuronsInput << in, biasNeuron;
-
-    neuronsHidden << (weightsInputToHidden.transpose() * neuronsInput),
-        biasNeuron;
-    for (int j = 0; j < sizeHidden; j++) {
-        neuronsHidden(j) = activationFunction(neuronsHidden(j));
-    }
-
-    neuronsOutput = weightsHiddenToOutput.transpose() * neuronsHidden;
-    for (int k = 0; k < sizeOutput; k++) {
-        neuronsOutput(k) = activationFunction(neuronsOutput(k));
-    }
+    return model.saveWeights(outFile);
 }
 
-bool integerNeuralNet::saveWeights(string outFile)
+template <typename NeuronT, typename WeightT, typename AccT>
+bool integerNeuralNet<NeuronT, WeightT, AccT>::loadWeights(string inFile)
 {
-    fstream output;
-    output.open(outFile, ios::out);
-
-    if (output.is_open()) {
-        output << "Dimensions:\n"
-               << sizeInput << " " << sizeHidden << " " << sizeOutput << endl;
-
-        output << "Weights Input To Hidden:\n";
-        for (int i = 0; i <= sizeInput; i++) {
-            for (int j = 0; j < sizeHidden; j++)
-                output << weightsInputToHidden(i, j) << " ";
-            output << endl;
-        }
-
-        output << "Weights Hidden To Output:\n";
-        for (int j = 0; j <= sizeHidden; j++) {
-            for (int k = 0; k < sizeOutput; k++)
-                output << weightsHiddenToOutput(j, k) << " ";
-            output << endl;
-        }
+    bool done = model.loadWeights(inFile);
 
-        output.close();
-        return true;
-    } else {
-        return false;
-    }
+    context.resetDelta();
+    return done;
 }
 
-bool integerNeuralNet::loadWeights(string inFile)
+template <typename NeuronT, typename WeightT, typename AccT>
+bool integerNeuralNet<NeuronT, WeightT, AccT>::loadActivationTable(
+    string inFile)
 {
-    fstream input;
-    input.open(inFile, ios::in);
+    bool done = model.loadActivationTable(inFile);
 
-    if (input.is_open()) {
-        int numInput, numHidden, numOutput;
-        string line = "";
-
-        getline(input, line); // Dimensions Label
-        input >> numInput >> numHidden >> numOutput;
-        getline(input, line); // Clear line feed and newline characters
-
-        if ((numInput == sizeInput) && (numHidden == sizeHidden) &&
-            (numOutput == sizeOutput)) {
-            getline(input, line); // Weights Label
-            for (int i = 0; i <= sizeInput; i++) {
-                for (int j = 0; j < sizeHidden; j++)
-                    input >> weightsInputToHidden(i, j);
-                getline(input, line); // Clear line feed and newline characters
-            }
-
-            getline(input, line); // Weights Label
-            for (int j = 0; j <= sizeHidden; j++) {
-                for (int k = 0; k < sizeOutput; k++)
-                    input >> weightsHiddenToOutput(j, k);
-                getline(input, line); // Clear line feed and newline characters
-            }
-            input.close();
-            return true;
-        } else {
-            input.close();
-            return false;
-        }
-    } else {
-        return false;
-    }
+    context.resetDelta();
+    return done;
 }
 
-bool integerNeuralNet::loadActivationTable(string inFile)
+template <typename NeuronT, typename WeightT, typename AccT>
+bool integerNeuralNet<NeuronT, WeightT, AccT>::saveModel(string outFile)
 {
-    fstream input;
-    input.open(inFile, ios::in);
-
-    if (input.is_open()) {
-        for (int i = 0; i < 10 * maxNeuron; i++) {
-            input >> activationTable[i];
-        }
-
-        input.close();
-        return true;
-    } else {
-        return false;
-    }
+    return model.saveModel(outFile);
 }
 
-int integerNeuralNet::classify(Eigen::VectorXi in)
+template <typename NeuronT, typename WeightT, typename AccT>
+bool integerNeuralNet<NeuronT, WeightT, AccT>::loadModel(string inFile)
 {
-    int max = -1 * maxNeuron;
-    int result = 0;
+    bool done = model.loadModel(inFile);
 
-    feedForward(in);
-
-    for (int k = 0; k < sizeOutput; k++) {
-        if (neuronsOutput(k) > max) {
-            max = neuronsOutput(k);
-            result = k;
-        }
-    }
-
-    return result;
+    context.resetDelta();
+    return done;
 }
 
-bool integerNeuralNet::convertFPWeights(string inFile, string outFile)
+template <typename NeuronT, typename WeightT, typename AccT>
+int integerNeuralNet<NeuronT, WeightT, AccT>::classify(
+    const Eigen::Ref<const neuronVector> &in)
 {
-    double temp;
-    double max = getMaxFPWeight(inFile);
-
-    fstream input;
-    input.open(inFile, ios::in);
-
-    if (input.is_open()) {
-        int numInput, numHidden, numOutput;
-        string line = "";
-
-        getline(input, line); // Dimensions Label
-        input >> numInput >> numHidden >> numOutput;
-        getline(input, line); // Clear line feed and newline characters
-
-        if ((numInput == sizeInput) && (numHidden == sizeHidden) &&
-            (numOutput == sizeOutput)) {
-            getline(input, line); // Weights Label
-            for (int i = 0; i <= sizeInput; i++) {
-                for (int j = 0; j < sizeHidden; j++) {
-                    input >> temp;
-                    weightsInputToHidden(i, j) =
-                        (int)((temp / max) * (double)maxWeight);
-                }
-                getline(input, line); // Clear line feed and newline characters
-            }
-
-            getline(input, line); // Weights Label
-            for (int j = 0; j <= sizeHidden; j++) {
-                for (int k = 0; k < sizeOutput; k++) {
-                    input >> temp;
-                    weightsHiddenToOutput(j, k) =
-                        (int)((temp / max) * (double)maxWeight);
-                }
-                getline(input, line); // Clear line feed and newline characters
-            }
-            input.close();
-            saveWeights(outFile);
-            return true;
-        } else {
-            input.close();
-            return false;
-        }
-    } else {
-        return false;
-    }
+    return model.classify(context, in);
 }
 
-double integerNeuralNet::getMaxFPWeight(string inFile)
+template <typename NeuronT, typename WeightT, typename AccT>
+vector<int> integerNeuralNet<NeuronT, WeightT, AccT>::classifyBatch(
+    const Eigen::Ref<const neuronMatrix> &in, int blockSize)
 {
-    fstream input;
-    input.open(inFile, ios::in);
-
-    double temp;
-    double max = 0.0;
-
-    if (input.is_open()) {
-        int numInput, numHidden, numOutput;
-        string line = "";
-
-        getline(input, line); // Dimensions Label
-        input >> numInput >> numHidden >> numOutput;
-        getline(input, line); // Clear line feed and newline characters
-
-        if ((numInput == sizeInput) && (numHidden == sizeHidden) &&
-            (numOutput == sizeOutput)) {
-            getline(input, line); // Weights Label
-            for (int i = 0; i <= sizeInput; i++) {
-                for (int j = 0; j < sizeHidden; j++) {
-                    input >> temp;
-                    if (fabs(temp) > max)
-                        max = fabs(temp);
-                }
-                getline(input, line); // Clear line feed and newline characters
-            }
-
-            getline(input, line); // Weights Label
-            for (int j = 0; j <= sizeHidden; j++) {
-                for (int k = 0; k < sizeOutput; k++) {
-                    input >> temp;
-                    if (fabs(temp) > max)
-                        max = fabs(temp);
-                }
-                getline(input, line); // Clear line feed and newline characters
-            }
-            input.close();
-            return max;
-        } else {
-            input.close();
-            return 0.0;
-        }
-    } else {
-        return 0.0;
-    }
+    return model.classifyBatch(context, in, blockSize);
 }
 
-bool integerNeuralNet::buildActivationTable(string outFile)
+template <typename NeuronT, typename WeightT, typename AccT>
+int integerNeuralNet<NeuronT, WeightT, AccT>::classifyDelta(
+    const Eigen::Ref<const neuronVector> &in)
 {
-    fstream output;
-    output.open(outFile, ios::out);
-
-    if (output.is_open()) {
-        for (int i = 0; i < 10 * maxNeuron; i++) {
-            activationTable[i] =
-                (int)((double)maxNeuron /
-                      (1.0 + exp(-((double)i - (5.0 * (double)maxNeuron)) /
-                                 (double)maxNeuron)));
-            output << activationTable[i] << endl;
-        }
-
-        output.close();
-        return true;
-    } else {
-        return false;
-    }
+    return model.classifyDelta(context, in.data(), in.size());
 }
 
-bool integerNeuralNet::convertFPInputs(string inFile, string outFile)
+template <typename NeuronT, typename WeightT, typename AccT>
+int integerNeuralNet<NeuronT, WeightT, AccT>::classifyDelta(
+    const int32_t *indices, const NeuronT *values, int count)
 {
-    fstream input;
-    input.open(inFile, ios::in);
-    fstream output;
-    output.open(outFile, ios::out);
-
-    if (input.is_open() && output.is_open()) {
-        // Find largest value to scale all inputs
-        double max, temp;
-        int tempInt;
-        input >> max;
-        max = fabs(max);
-
-        while (input >> temp) {
-            if (fabs(temp) > max)
-                max = fabs(temp);
-        }
-        input.close();
+    return model.classifyDelta(context, indices, values, count);
+}
 
-        input.open(inFile, ios::in);
+template <typename NeuronT, typename WeightT, typename AccT>
+bool integerNeuralNet<NeuronT, WeightT, AccT>::convertFPWeights(
+    string inFile, string outFile, weightScaling scaling,
+    weightQuantization quantization)
+{
+    bool done = model.convertFPWeights(inFile, outFile, scaling, quantization);
 
-        while (!input.eof()) {
-            for (int i = 0; i < sizeInput; i++) {
-                input >> temp;
-                tempInt = (int)((double)maxNeuron * (temp / max));
-                output << tempInt << " ";
-            }
-            output << endl;
-        }
-        input.close();
-        output.close();
+    context.resetDelta();
+    return done;
+}
 
-        return true;
-    } else {
-        return false;
-    }
+template <typename NeuronT, typename WeightT, typename AccT>
+double integerNeuralNet<NeuronT, WeightT, AccT>::getMaxFPWeight(string inFile)
+{
+    return model.getMaxFPWeight(inFile);
 }
 
-bool integerNeuralNet::dumpTrace(ofstream &trace)
+template <typename NeuronT, typename WeightT, typename AccT>
+bool integerNeuralNet<NeuronT, WeightT, AccT>::buildActivationTable(
+    string outFile)
 {
-    if (trace.is_open()) {
-        trace << "===================================\n"
-              << "== Input layer:" << endl;
-        trace << neuronsInput;
+    bool done = model.buildActivationTable(outFile);
 
-        trace << "\n\n)== Hidden layer:" << endl;
-        trace << neuronsHidden;
+    context.resetDelta();
+    return done;
+}
 
-        trace << "\n\n== Output layer:" << endl;
-        trace << neuronsOutput;
+template <typename NeuronT, typename WeightT, typename AccT>
+bool integerNeuralNet<NeuronT, WeightT, AccT>::convertFPInputs(
+    string inFile, string outFile, string datasetFile, string labelsFile,
+    double inputScale)
+{
+    return model.convertFPInputs(inFile, outFile, datasetFile, labelsFile,
+                                 inputScale);
+}
 
-        trace << "===================================\n" << endl;
+template <typename NeuronT, typename WeightT, typename AccT>
+bool integerNeuralNet<NeuronT, WeightT, AccT>::dumpTrace(ofstream &trace)
+{
+    return context.dumpTrace(trace);
+}
 
-        return true;
-    } else {
-        return false;
-    }
-}
\ No newline at end of file
+INSTANTIATE_INTEGER_NET(integerNeuralNet)
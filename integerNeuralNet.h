@@ -2,58 +2,82 @@
 #define IntegerNeuralNet
 
 #include <string>
+#include <vector>
 
 #include "ext/eigen-library/Eigen/Core"
+#include "inferenceContext.h"
+#include "integerModel.h"
+#include "integerTypes.h"
 
 using namespace std;
+// Single-threaded network, bundling a model with the one context it classifies
+// with. To classify from several threads, share getModel() and give each
+// thread its own InferenceContext. The methods that change the model reset
+// the context's incremental state; changes made through getModel() must be
+// followed by resetDelta().
+template <typename NeuronT = int32_t, typename WeightT = int32_t,
+          typename AccT = int32_t>
 class integerNeuralNet
 {
-  private:
-    // Layer Sizes - Set at initialization
-    int sizeInput, sizeHidden, sizeOutput;
-
-    // Integer Ranges - Bound of integer scales in power of 2
-    int maxNeuron, maxWeight;
-    int *activationTable;
-
-    // Bias neuron value
-    int biasNeuron;
-
-    // Layer Neurons - Eigen vectors
-    Eigen::VectorXi neuronsInput;
-    Eigen::VectorXi neuronsHidden;
-    Eigen::VectorXi neuronsOutput;
-
-    // Layer Weights - Eigen matrices
-    Eigen::MatrixXi weightsInputToHidden;
-    Eigen::MatrixXi weightsHiddenToOutput;
+  public:
+    typedef NeuronT neuronType;
+    typedef WeightT weightType;
+    typedef AccT accumulatorType;
+    typedef IntegerModel<NeuronT, WeightT, AccT> modelType;
+    typedef typename modelType::neuronVector neuronVector;
+    typedef typename modelType::neuronMatrix neuronMatrix;
 
-    // Functions - Private member functions
-    int activationFunction(int in);
-    void feedForward(Eigen::VectorXi in);
+  private:
+    modelType model;
+    InferenceContext<NeuronT, WeightT, AccT> context;
 
   public:
-    // Constructor and Destructor
+    // Constructors - For one hidden layer, or any stack of layers (see
+    // IntegerModel)
     integerNeuralNet(int numIn, int numHid, int numOut, int maxN, int maxW);
-    ~integerNeuralNet();
+    integerNeuralNet(const vector<int> &sizes, int maxN,
+                     const vector<int> &maxW);
+
+    const modelType &getModel() const { return model; }
+    modelType &getModel() { return model; }
 
     // Saving and Loading
     bool saveWeights(string outFile);
     bool loadWeights(string inFile);
     bool loadActivationTable(string inFile);
+    bool saveModel(string outFile);
+    bool loadModel(string inFile);
 
     // Classifying
-    int classify(Eigen::VectorXi);
+    int classify(const Eigen::Ref<const neuronVector> &in);
+    vector<int> classifyBatch(const Eigen::Ref<const neuronMatrix> &in,
+                              int blockSize = 64);
+    // Incremental classifying, see IntegerModel::classifyDelta
+    int classifyDelta(const Eigen::Ref<const neuronVector> &in);
+    int classifyDelta(const int32_t *indices, const NeuronT *values,
+                      int count);
+    void resetDelta() { context.resetDelta(); }
 
     // Helper functions for new networks without integer weights or activation
     // LUTs
-    bool convertFPWeights(string inFile, string outFile);
+    bool convertFPWeights(string inFile, string outFile,
+                          weightScaling scaling = scaleGlobal,
+                          weightQuantization quantization = quantizeLinear);
     double getMaxFPWeight(string inFile);
     bool buildActivationTable(string outFile);
-    bool convertFPInputs(string inFile, string outFile);
+    bool convertFPInputs(string inFile, string outFile,
+                         string datasetFile = "", string labelsFile = "",
+                         double inputScale = 0.0);
 
     // Tracing functions
     bool dumpTrace(ofstream &trace);
 };
 
+// Network with the storage types picked for the given bit depths
+template <int NeuronBits, int WeightBits>
+using integerNeuralNetFor = integerNeuralNet<
+    typename integerNetTypes<NeuronBits, WeightBits>::neuron,
+    typename integerNetTypes<NeuronBits, WeightBits>::weight,
+    typename integerNetTypes<NeuronBits, WeightBits>::accumulator>;
+
 #endif
@@ -0,0 +1,113 @@
+#ifndef IntegerTypes
+#define IntegerTypes
+
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "ext/eigen-library/Eigen/Core"
+
+using namespace std;
+
+// Storage type for values of a given bit depth. A depth of b bits holds
+// values up to 2^(b-1), one more than the largest value of the matching
+// signed type, so that single value is saturated (e.g. 128 is stored as 127
+// in 8 bits).
+template <int Bits> struct integerStorage {
+    static_assert(Bits >= 2 && Bits <= 32, "bit depth must be in [2, 32]");
+
+    typedef typename conditional<
+        (Bits <= 8), int8_t,
+        typename conditional<(Bits <= 16), int16_t, int32_t>::type>::type type;
+};
+
+// Storage and accumulator types for a network of the given bit depths.
+// Neurons and weights share the narrowest type holding both depths. 32-bit
+// accumulators leave 32 - NeuronBits - WeightBits + 2 bits of headroom for the
+// sums, at least 9 (512 products at full scale), wider depths get 64 bits.
+template <int NeuronBits, int WeightBits> struct integerNetTypes {
+    typedef typename integerStorage<(NeuronBits > WeightBits
+                                         ? NeuronBits
+                                         : WeightBits)>::type neuron;
+    typedef neuron weight;
+    typedef typename conditional<(NeuronBits + WeightBits <= 24), int32_t,
+                                 int64_t>::type accumulator;
+};
+
+// Converts to a narrower type, clamping values out of its range
+template <typename T, typename U> inline T saturateCast(U value)
+{
+    if (value > (U)numeric_limits<T>::max())
+        return numeric_limits<T>::max();
+    if (value < (U)numeric_limits<T>::min())
+        return numeric_limits<T>::min();
+    return (T)value;
+}
+
+// Checks at compile time that a combination of types is usable
+template <typename NeuronT, typename WeightT, typename AccT>
+struct integerNetCheck {
+    static_assert(is_integral<NeuronT>::value && is_signed<NeuronT>::value,
+                  "neurons must be stored in a signed integer type");
+    static_assert(is_integral<WeightT>::value && is_signed<WeightT>::value,
+                  "weights must be stored in a signed integer type");
+    static_assert(is_integral<AccT>::value && is_signed<AccT>::value,
+                  "accumulators must be a signed integer type");
+    static_assert(sizeof(AccT) >= sizeof(NeuronT) &&
+                      sizeof(AccT) >= sizeof(WeightT),
+                  "accumulators must be at least as wide as their operands");
+    static const bool value = true;
+};
+
+// Eigen containers for the neurons, weights and accumulators of a network
+template <typename NeuronT, typename WeightT, typename AccT>
+struct integerNetMatrices {
+    typedef Eigen::Matrix<NeuronT, Eigen::Dynamic, 1> neuronVector;
+    typedef Eigen::Matrix<NeuronT, Eigen::Dynamic, Eigen::Dynamic> neuronMatrix;
+    typedef Eigen::Matrix<WeightT, Eigen::Dynamic, Eigen::Dynamic> weightMatrix;
+    typedef Eigen::Matrix<AccT, Eigen::Dynamic, 1> accVector;
+    typedef Eigen::Matrix<AccT, Eigen::Dynamic, Eigen::Dynamic> accMatrix;
+};
+
+// Forward declarations - The default types are the original 32-bit network
+template <typename NeuronT = int32_t, typename WeightT = int32_t,
+          typename AccT = int32_t>
+class IntegerModel;
+template <typename NeuronT = int32_t, typename WeightT = int32_t,
+          typename AccT = int32_t>
+class InferenceContext;
+
+// Explicitly instantiates a class template for every supported combination of
+// neuron, weight and accumulator types
+#define INSTANTIATE_INTEGER_NET(CLASS)                                         \
+    template class CLASS<int8_t, int8_t, int32_t>;                             \
+    template class CLASS<int16_t, int16_t, int32_t>;                           \
+    template class CLASS<int16_t, int16_t, int64_t>;                           \
+    template class CLASS<int32_t, int32_t, int32_t>;                           \
+    template class CLASS<int32_t, int32_t, int64_t>;
+
+// Calls f.template run<NeuronT, WeightT, AccT>() for the storage types of the
+// given sizes in bytes (as in the binary model file, see modelFile.h) and
+// stores its result. Fails for sizes other than the combinations
+// INSTANTIATE_INTEGER_NET covers.
+template <typename F>
+bool withIntegerNetTypes(int neuronBytes, int accumulatorBytes, const F &f,
+                         int &result)
+{
+    if (neuronBytes == 1 && accumulatorBytes == 4)
+        result = f.template run<int8_t, int8_t, int32_t>();
+    else if (neuronBytes == 2 && accumulatorBytes == 4)
+        result = f.template run<int16_t, int16_t, int32_t>();
+    else if (neuronBytes == 2 && accumulatorBytes == 8)
+        result = f.template run<int16_t, int16_t, int64_t>();
+    else if (neuronBytes == 4 && accumulatorBytes == 4)
+        result = f.template run<int32_t, int32_t, int32_t>();
+    else if (neuronBytes == 4 && accumulatorBytes == 8)
+        result = f.template run<int32_t, int32_t, int64_t>();
+    else
+        return false;
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <thread>
+
+#include "latencyHistogram.h"
+
+using namespace std;
+
+void latencyHistogram::clear()
+{
+    fill(counts, counts + numBuckets, 0);
+    count = total = maximum = 0;
+    minimum = ~0ull;
+}
+
+void latencyHistogram::add(uint64_t value, uint64_t times)
+{
+    if (times == 0)
+        return;
+
+    counts[bucketIndex(value)] += times;
+    count += times;
+    total += value * times;
+    minimum = min(minimum, value);
+    maximum = max(maximum, value);
+}
+
+void latencyHistogram::merge(const latencyHistogram &other)
+{
+    for (int b = 0; b < numBuckets; b++)
+        counts[b] += other.counts[b];
+
+    count += other.count;
+    total += other.total;
+    minimum = min(minimum, other.minimum);
+    maximum = max(maximum, other.maximum);
+}
+
+void latencyHistogram::addBuckets(const uint64_t *bucketCounts, uint64_t sum,
+                                  uint64_t smallest, uint64_t largest)
+{
+    uint64_t added = 0;
+
+    for (int b = 0; b < numBuckets; b++) {
+        counts[b] += bucketCounts[b];
+        added += bucketCounts[b];
+    }
+    if (added == 0)
+        return;
+
+    count += added;
+    total += sum;
+    minimum = min(minimum, smallest);
+    maximum = max(maximum, largest);
+}
+
+uint64_t latencyHistogram::bucketLast(int index)
+{
+    const int half = 1 << (bucketBits - 1);
+
+    if (index < 2 * half)
+        return index;
+
+    int shift = index / half - 1;
+    uint64_t first = (uint64_t)(index - shift * half);
+
+    return ((first + 1) << shift) - 1;
+}
+
+uint64_t latencyHistogram::valueAtPercentile(double percentile) const
+{
+    if (count == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)ceil(percentile / 100.0 * count);
+    uint64_t seen = 0;
+
+    rank = max(rank, (uint64_t)1);
+    for (int b = 0; b < numBuckets; b++) {
+        seen += counts[b];
+        if (seen >= rank)
+            return min(bucketLast(b), maximum);
+    }
+
+    return maximum;
+}
+
+// Clock - Ticks are calibrated against steady_clock since the program
+// started, over at least 10 ms
+static const chrono::steady_clock::time_point startTime =
+    chrono::steady_clock::now();
+static const uint64_t startTicks = latencyClock::now();
+
+double latencyClock::nanosecondsPerTick()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    chrono::steady_clock::time_point end;
+    uint64_t endTicks;
+
+    for (;;) {
+        end = chrono::steady_clock::now();
+        endTicks = now();
+        if (end - startTime >= chrono::milliseconds(10))
+            break;
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    return chrono::duration<double, nano>(end - startTime).count() /
+           (double)(endTicks - startTicks);
+#else
+    return 1.0;
+#endif
+}
+
+// Histogram of one thread - Written by its thread only, with relaxed loads
+// and stores (no atomic read-modify-writes), read by reports. Threads are
+// linked in a list so registering them never allocates.
+namespace {
+struct threadLatencies {
+    atomic<uint64_t> counts[latencyHistogram::numBuckets];
+    atomic<uint64_t> total, minimum, maximum;
+    threadLatencies *next;
+
+    threadLatencies();
+    ~threadLatencies();
+
+    void add(atomic<uint64_t> &counter, uint64_t value)
+    {
+        counter.store(counter.load(memory_order_relaxed) + value,
+                      memory_order_relaxed);
+    }
+    void collect(latencyHistogram &out) const;
+    void clear();
+};
+
+mutex threadsLock;
+threadLatencies *threads = 0;
+
+// Latencies of threads that have exited
+latencyHistogram exited;
+
+thread_local threadLatencies latencies;
+} // namespace
+
+threadLatencies::threadLatencies()
+{
+    clear();
+
+    lock_guard<mutex> guard(threadsLock);
+    next = threads;
+    threads = this;
+}
+
+threadLatencies::~threadLatencies()
+{
+    lock_guard<mutex> guard(threadsLock);
+
+    collect(exited);
+    for (threadLatencies **link = &threads; *link; link = &(*link)->next) {
+        if (*link == this) {
+            *link = next;
+            break;
+        }
+    }
+}
+
+void threadLatencies::collect(latencyHistogram &out) const
+{
+    uint64_t local[latencyHistogram::numBuckets];
+
+    for (int b = 0; b < latencyHistogram::numBuckets; b++)
+        local[b] = counts[b].load(memory_order_relaxed);
+
+    out.addBuckets(local, total.load(memory_order_relaxed),
+                   minimum.load(memory_order_relaxed),
+                   maximum.load(memory_order_relaxed));
+}
+
+void threadLatencies::clear()
+{
+    for (int b = 0; b < latencyHistogram::numBuckets; b++)
+        counts[b].store(0, memory_order_relaxed);
+    total.store(0, memory_order_relaxed);
+    minimum.store(~0ull, memory_order_relaxed);
+    maximum.store(0, memory_order_relaxed);
+}
+
+void latencyRecorder::record(uint64_t ticks)
+{
+    threadLatencies &t = latencies;
+
+    t.add(t.counts[latencyHistogram::bucketIndex(ticks)], 1);
+    t.add(t.total, ticks);
+    if (ticks < t.minimum.load(memory_order_relaxed))
+        t.minimum.store(ticks, memory_order_relaxed);
+    if (ticks > t.maximum.load(memory_order_relaxed))
+        t.maximum.store(ticks, memory_order_relaxed);
+}
+
+latencyHistogram latencyRecorder::snapshot()
+{
+    lock_guard<mutex> guard(threadsLock);
+    latencyHistogram merged = exited;
+
+    for (threadLatencies *t = threads; t; t = t->next)
+        t->collect(merged);
+
+    return merged;
+}
+
+void latencyRecorder::reset()
+{
+    lock_guard<mutex> guard(threadsLock);
+
+    exited.clear();
+    for (threadLatencies *t = threads; t; t = t->next)
+        t->clear();
+}
+
+void latencyRecorder::report(FILE *out, const char *prefix)
+{
+    latencyHistogram merged = snapshot();
+
+    if (merged.getCount() == 0)
+        return;
+
+    double us = latencyClock::nanosecondsPerTick() * 1e-3;
+
+    fprintf(out,
+            "%s %llu latencies (us): mean %.3f, p50 %.3f, p90 %.3f, "
+            "p99 %.3f, p99.9 %.3f, max %.3f\n",
+            prefix, (unsigned long long)merged.getCount(),
+            merged.getMean() * us, merged.valueAtPercentile(50) * us,
+            merged.valueAtPercentile(90) * us,
+            merged.valueAtPercentile(99) * us,
+            merged.valueAtPercentile(99.9) * us, merged.getMax() * us);
+    fflush(out);
+}
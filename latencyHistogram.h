@@ -0,0 +1,98 @@
+#ifndef LatencyHistogram
+#define LatencyHistogram
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+// Log-bucketed histogram of latencies (HDR-style). Values below 2^bucketBits
+// have a bucket each, larger ones share buckets 2^(bucketBits-1) to an octave,
+// so any value is reported within 1/64 of itself. Values are clock ticks (see
+// latencyClock), converted to nanoseconds when reported.
+class latencyHistogram
+{
+  public:
+    static const int bucketBits = 7;
+    static const int numBuckets = (64 - bucketBits + 2) << (bucketBits - 1);
+
+  private:
+    uint64_t counts[numBuckets];
+    uint64_t count, total, minimum, maximum;
+
+  public:
+    latencyHistogram() { clear(); }
+
+    void clear();
+    void add(uint64_t value, uint64_t times = 1);
+    void merge(const latencyHistogram &other);
+    // Adds values already counted per bucket, given their exact sum, minimum
+    // and maximum
+    void addBuckets(const uint64_t *bucketCounts, uint64_t sum,
+                    uint64_t smallest, uint64_t largest);
+
+    uint64_t getCount() const { return count; }
+    uint64_t getMin() const { return count ? minimum : 0; }
+    uint64_t getMax() const { return maximum; }
+    double getMean() const { return count ? (double)total / count : 0.0; }
+
+    // Smallest value at least the given percentile (in [0, 100]) of the
+    // values are at or below, as the largest value of its bucket
+    uint64_t valueAtPercentile(double percentile) const;
+
+    static int bucketIndex(uint64_t value)
+    {
+        const uint64_t linear = 1ull << bucketBits;
+
+        if (value < linear)
+            return (int)value;
+
+        int shift = 63 - __builtin_clzll(value) - bucketBits + 1;
+        return (shift << (bucketBits - 1)) + (int)(value >> shift);
+    }
+    static uint64_t bucketLast(int index);
+};
+
+// Timestamps for latencies - The time-stamp counter where available (a few
+// nanoseconds to read), steady_clock nanoseconds otherwise
+struct latencyClock {
+    static uint64_t now()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return chrono::duration_cast<chrono::nanoseconds>(
+                   chrono::steady_clock::now().time_since_epoch())
+            .count();
+#endif
+    }
+
+    // Nanoseconds per tick, measured against steady_clock since startup
+    static double nanosecondsPerTick();
+};
+
+// Latencies recorded by every thread. Each thread records into its own
+// histogram, with plain stores, and reports merge them all. Recording never
+// allocates.
+class latencyRecorder
+{
+  public:
+    static void record(uint64_t ticks);
+
+    // Merged histogram of all threads, in ticks
+    static latencyHistogram snapshot();
+    // Latencies recorded while resetting may be lost
+    static void reset();
+
+    // Count, mean, p50, p90, p99, p99.9 and max in microseconds, one line
+    // prefixed with prefix, nothing if no latency was recorded
+    static void report(FILE *out, const char *prefix);
+};
+
+#endif
@@ -0,0 +1,1389 @@
+#include <algorithm>
+
+#include "layerKernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ENABLE_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define ENABLE_X86_KERNELS 0
+#endif
+
+using namespace std;
+
+// ***
+// Scalar reference kernels
+// ***
+
+static void product16Scalar(const int16_t *weights, int rows, int cols,
+                            const int16_t *in, int32_t *out)
+{
+    for (int j = 0; j < cols; j++) {
+        const int16_t *w = weights + (size_t)j * rows;
+        int32_t acc = 0;
+
+        for (int i = 0; i < rows; i++)
+            acc += (int32_t)w[i] * (int32_t)in[i];
+        out[j] = acc;
+    }
+}
+
+static void product8Scalar(const int8_t *weights, int rows, int cols,
+                           const int8_t *in, int32_t *out)
+{
+    for (int j = 0; j < cols; j++) {
+        const int8_t *w = weights + (size_t)j * rows;
+        int32_t acc = 0;
+
+        for (int i = 0; i < rows; i++)
+            acc += (int32_t)w[i] * (int32_t)in[i];
+        out[j] = acc;
+    }
+}
+
+// Samples per group of the vector block kernels, whose weights are loaded
+// once for all of them
+const int blockSamples = 4;
+
+template <typename T>
+static void blockScalar(const T *weights, int rows, int cols, const T *in,
+                        int inStride, int count, int32_t *out, int outStride)
+{
+    for (int s = 0; s < count; s++) {
+        const T *x = in + (size_t)s * inStride;
+
+        for (int j = 0; j < cols; j++) {
+            const T *w = weights + (size_t)j * rows;
+            int32_t acc = 0;
+
+            for (int i = 0; i < rows; i++)
+                acc += (int32_t)w[i] * (int32_t)x[i];
+            out[(size_t)s * outStride + j] = acc;
+        }
+    }
+}
+
+static void sparse16Scalar(const int16_t *blocks, const int32_t *blockRows,
+                           const int32_t *columnStarts, int cols,
+                           const int16_t *in, int32_t *out)
+{
+    for (int j = 0; j < cols; j++) {
+        int32_t acc = 0;
+
+        for (int b = columnStarts[j]; b < columnStarts[j + 1]; b++) {
+            const int16_t *w = blocks + (size_t)b * sparseBlockRows;
+            const int16_t *x = in + blockRows[b];
+
+            for (int k = 0; k < sparseBlockRows; k++)
+                acc += (int32_t)w[k] * (int32_t)x[k];
+        }
+        out[j] = acc;
+    }
+}
+
+static void sparse8Scalar(const int8_t *blocks, const int32_t *blockRows,
+                          const int32_t *columnStarts, int cols,
+                          const int8_t *in, int32_t *out)
+{
+    for (int j = 0; j < cols; j++) {
+        int32_t acc = 0;
+
+        for (int b = columnStarts[j]; b < columnStarts[j + 1]; b++) {
+            const int8_t *w = blocks + (size_t)b * sparseBlockRows;
+            const int8_t *x = in + blockRows[b];
+
+            for (int k = 0; k < sparseBlockRows; k++)
+                acc += (int32_t)w[k] * (int32_t)x[k];
+        }
+        out[j] = acc;
+    }
+}
+
+// Every index is stored, and kept only if its input is nonzero
+template <typename T>
+static int nonzeroScalar(const T *in, int size, int32_t *indices)
+{
+    int count = 0;
+
+    for (int i = 0; i < size; i++) {
+        indices[count] = i;
+        count += in[i] != 0;
+    }
+
+    return count;
+}
+
+template <typename T>
+static void rowsScalar(const T *weightRows, int stride, int cols,
+                       const int32_t *indices, int count, const T *in,
+                       int32_t *out)
+{
+    for (int j = 0; j < cols; j++)
+        out[j] = 0;
+
+    for (int k = 0; k < count; k++) {
+        const T *w = weightRows + (size_t)indices[k] * stride;
+        int32_t x = in[indices[k]];
+
+        for (int j = 0; j < cols; j++)
+            out[j] += (int32_t)w[j] * x;
+    }
+}
+
+// Planes below the top (sign) plane that are equal to it only extend the
+// sign, the lowest of them can be the sign plane instead
+static int usedPlanes(const uint64_t *planes, int words, int numPlanes)
+{
+    while (numPlanes > 1) {
+        const uint64_t *top = planes + (size_t)(numPlanes - 1) * words;
+        const uint64_t *below = top - words;
+        int w = 0;
+
+        while (w < words && below[w] == top[w])
+            w++;
+        if (w < words)
+            break;
+        numPlanes--;
+    }
+
+    return numPlanes;
+}
+
+template <typename T>
+static int planesScalar(const T *in, int size, uint64_t *planes)
+{
+    typedef typename make_unsigned<T>::type bitsType;
+
+    const int bits = 8 * sizeof(T);
+    int words = (size + 63) / 64;
+
+    for (int w = 0; w < words; w++) {
+        for (int b = 0; b < bits; b++)
+            planes[(size_t)b * words + w] = 0;
+
+        for (int k = 0; k < 64 && 64 * w + k < size; k++) {
+            bitsType value = (bitsType)in[64 * w + k];
+
+            for (int b = 0; b < bits; b++)
+                planes[(size_t)b * words + w] |=
+                    (uint64_t)((value >> b) & 1) << k;
+        }
+    }
+
+    return usedPlanes(planes, words, bits);
+}
+
+// Shared by the scalar kernel and its popcnt build - Plane words outside,
+// so the columns of a word row are read in order. Sums wrap around in 32
+// bits: partial sums may leave the range of int32_t, the final ones do not.
+__attribute__((always_inline)) static inline void
+ternaryBody(const uint64_t *positive, const uint64_t *negative, int stride,
+            int words, int cols, const uint64_t *planes, int numPlanes,
+            int32_t *out)
+{
+    uint32_t *sums = (uint32_t *)out;
+
+    for (int j = 0; j < cols; j++)
+        sums[j] = 0;
+
+    for (int b = 0; b < numPlanes; b++) {
+        uint32_t weight = b == numPlanes - 1 ? -(1u << b) : 1u << b;
+
+        for (int w = 0; w < words; w++) {
+            uint64_t x = planes[(size_t)b * words + w];
+            const uint64_t *p = positive + (size_t)w * stride;
+
+            if (!x)
+                continue;
+
+            if (negative) {
+                const uint64_t *n = negative + (size_t)w * stride;
+
+                for (int j = 0; j < cols; j++)
+                    sums[j] += weight * (uint32_t)(__builtin_popcountll(
+                                                       x & p[j]) -
+                                                   __builtin_popcountll(
+                                                       x & n[j]));
+            } else {
+                uint32_t all = __builtin_popcountll(x);
+
+                for (int j = 0; j < cols; j++)
+                    sums[j] += weight *
+                               (2 * (uint32_t)__builtin_popcountll(x & p[j]) -
+                                all);
+            }
+        }
+    }
+}
+
+static void ternaryScalar(const uint64_t *positive, const uint64_t *negative,
+                          int stride, int words, int cols,
+                          const uint64_t *planes, int numPlanes, int32_t *out)
+{
+    ternaryBody(positive, negative, stride, words, cols, planes, numPlanes,
+                out);
+}
+
+#if ENABLE_X86_KERNELS
+
+// ***
+// Popcnt kernel - The scalar ternary kernel with the popcnt instruction, on
+// every CPU with AVX2
+// ***
+
+__attribute__((target("popcnt"))) static void
+ternaryPopcnt(const uint64_t *positive, const uint64_t *negative, int stride,
+              int words, int cols, const uint64_t *planes, int numPlanes,
+              int32_t *out)
+{
+    ternaryBody(positive, negative, stride, words, cols, planes, numPlanes,
+                out);
+}
+
+// ***
+// AVX2 kernels - vpmaddwd on 16 pairs of 16-bit operands per instruction,
+// 8-bit operands are sign-extended to 16 bits first
+// ***
+
+__attribute__((target("avx2"))) static int32_t horizontalSum(__m256i v)
+{
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v),
+                                _mm256_extracti128_si256(v, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+    return _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("avx2"))) static void
+product16Avx2(const int16_t *weights, int rows, int cols, const int16_t *in,
+              int32_t *out)
+{
+    for (int j = 0; j < cols; j++) {
+        const int16_t *w = weights + (size_t)j * rows;
+        __m256i acc0 = _mm256_setzero_si256();
+        __m256i acc1 = _mm256_setzero_si256();
+        int i = 0;
+
+        for (; i + 32 <= rows; i += 32) {
+            __m256i w0 = _mm256_loadu_si256((const __m256i *)(w + i));
+            __m256i w1 = _mm256_loadu_si256((const __m256i *)(w + i + 16));
+            __m256i x0 = _mm256_loadu_si256((const __m256i *)(in + i));
+            __m256i x1 = _mm256_loadu_si256((const __m256i *)(in + i + 16));
+            acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(w0, x0));
+            acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(w1, x1));
+        }
+        for (; i + 16 <= rows; i += 16) {
+            __m256i w0 = _mm256_loadu_si256((const __m256i *)(w + i));
+            __m256i x0 = _mm256_loadu_si256((const __m256i *)(in + i));
+            acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(w0, x0));
+        }
+
+        int32_t acc = horizontalSum(_mm256_add_epi32(acc0, acc1));
+        for (; i < rows; i++)
+            acc += (int32_t)w[i] * (int32_t)in[i];
+        out[j] = acc;
+    }
+}
+
+__attribute__((target("avx2"))) static void
+product8Avx2(const int8_t *weights, int rows, int cols, const int8_t *in,
+             int32_t *out)
+{
+    for (int j = 0; j < cols; j++) {
+        const int8_t *w = weights + (size_t)j * rows;
+        __m256i acc = _mm256_setzero_si256();
+        int i = 0;
+
+        for (; i + 16 <= rows; i += 16) {
+            __m256i w0 = _mm256_cvtepi8_epi16(
+                _mm_loadu_si128((const __m128i *)(w + i)));
+            __m256i x0 = _mm256_cvtepi8_epi16(
+                _mm_loadu_si128((const __m128i *)(in + i)));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(w0, x0));
+        }
+
+        int32_t sum = horizontalSum(acc);
+        for (; i < rows; i++)
+            sum += (int32_t)w[i] * (int32_t)in[i];
+        out[j] = sum;
+    }
+}
+
+// Block kernels - Groups of four samples share each weight load, the samples
+// left over go through the single-sample kernel
+__attribute__((target("avx2"))) static inline __m256i
+multiplyAddAvx2(__m256i acc, __m256i w, __m256i x)
+{
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(w, x));
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+load16Avx2(const int16_t *p)
+{
+    return _mm256_loadu_si256((const __m256i *)p);
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+load8Avx2(const int8_t *p)
+{
+    return _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)p));
+}
+
+// Horizontal sums of a, b, c and d, in that order
+__attribute__((target("avx2"))) static inline __m128i
+horizontalSums(__m256i a, __m256i b, __m256i c, __m256i d)
+{
+    __m256i sums = _mm256_hadd_epi32(_mm256_hadd_epi32(a, b),
+                                     _mm256_hadd_epi32(c, d));
+
+    return _mm_add_epi32(_mm256_castsi256_si128(sums),
+                         _mm256_extracti128_si256(sums, 1));
+}
+
+// Stores the sums of a group of samples, one column of each
+static inline void storeBlockSums(const int32_t *sums, int32_t *out,
+                                  int outStride)
+{
+    for (int k = 0; k < blockSamples; k++)
+        out[(size_t)k * outStride] = sums[k];
+}
+
+__attribute__((target("avx2"))) static void
+block16Avx2(const int16_t *weights, int rows, int cols, const int16_t *in,
+            int inStride, int count, int32_t *out, int outStride)
+{
+    int s = 0;
+
+    for (; s + blockSamples <= count; s += blockSamples) {
+        const int16_t *x0 = in + (size_t)s * inStride;
+        const int16_t *x1 = x0 + inStride;
+        const int16_t *x2 = x1 + inStride;
+        const int16_t *x3 = x2 + inStride;
+        int32_t *o = out + (size_t)s * outStride;
+
+        for (int j = 0; j < cols; j++) {
+            const int16_t *w = weights + (size_t)j * rows;
+            __m256i acc0 = _mm256_setzero_si256();
+            __m256i acc1 = _mm256_setzero_si256();
+            __m256i acc2 = _mm256_setzero_si256();
+            __m256i acc3 = _mm256_setzero_si256();
+            int i = 0;
+
+            for (; i + 16 <= rows; i += 16) {
+                __m256i w0 = load16Avx2(w + i);
+                acc0 = multiplyAddAvx2(acc0, w0, load16Avx2(x0 + i));
+                acc1 = multiplyAddAvx2(acc1, w0, load16Avx2(x1 + i));
+                acc2 = multiplyAddAvx2(acc2, w0, load16Avx2(x2 + i));
+                acc3 = multiplyAddAvx2(acc3, w0, load16Avx2(x3 + i));
+            }
+
+            int32_t sums[blockSamples];
+            _mm_storeu_si128((__m128i *)sums,
+                             horizontalSums(acc0, acc1, acc2, acc3));
+            for (; i < rows; i++) {
+                sums[0] += (int32_t)w[i] * (int32_t)x0[i];
+                sums[1] += (int32_t)w[i] * (int32_t)x1[i];
+                sums[2] += (int32_t)w[i] * (int32_t)x2[i];
+                sums[3] += (int32_t)w[i] * (int32_t)x3[i];
+            }
+            storeBlockSums(sums, o + j, outStride);
+        }
+    }
+
+    for (; s < count; s++)
+        product16Avx2(weights, rows, cols, in + (size_t)s * inStride,
+                      out + (size_t)s * outStride);
+}
+
+__attribute__((target("avx2"))) static void
+block8Avx2(const int8_t *weights, int rows, int cols, const int8_t *in,
+           int inStride, int count, int32_t *out, int outStride)
+{
+    int s = 0;
+
+    for (; s + blockSamples <= count; s += blockSamples) {
+        const int8_t *x0 = in + (size_t)s * inStride;
+        const int8_t *x1 = x0 + inStride;
+        const int8_t *x2 = x1 + inStride;
+        const int8_t *x3 = x2 + inStride;
+        int32_t *o = out + (size_t)s * outStride;
+
+        for (int j = 0; j < cols; j++) {
+            const int8_t *w = weights + (size_t)j * rows;
+            __m256i acc0 = _mm256_setzero_si256();
+            __m256i acc1 = _mm256_setzero_si256();
+            __m256i acc2 = _mm256_setzero_si256();
+            __m256i acc3 = _mm256_setzero_si256();
+            int i = 0;
+
+            for (; i + 16 <= rows; i += 16) {
+                __m256i w0 = load8Avx2(w + i);
+                acc0 = multiplyAddAvx2(acc0, w0, load8Avx2(x0 + i));
+                acc1 = multiplyAddAvx2(acc1, w0, load8Avx2(x1 + i));
+                acc2 = multiplyAddAvx2(acc2, w0, load8Avx2(x2 + i));
+                acc3 = multiplyAddAvx2(acc3, w0, load8Avx2(x3 + i));
+            }
+
+            int32_t sums[blockSamples];
+            _mm_storeu_si128((__m128i *)sums,
+                             horizontalSums(acc0, acc1, acc2, acc3));
+            for (; i < rows; i++) {
+                sums[0] += (int32_t)w[i] * (int32_t)x0[i];
+                sums[1] += (int32_t)w[i] * (int32_t)x1[i];
+                sums[2] += (int32_t)w[i] * (int32_t)x2[i];
+                sums[3] += (int32_t)w[i] * (int32_t)x3[i];
+            }
+            storeBlockSums(sums, o + j, outStride);
+        }
+    }
+
+    for (; s < count; s++)
+        product8Avx2(weights, rows, cols, in + (size_t)s * inStride,
+                     out + (size_t)s * outStride);
+}
+
+// Narrow-accumulator kernel - vpmaddubsw multiplies unsigned by signed bytes
+// into 16-bit pair sums: the sign of each neuron moves onto its weight
+// (|x| * sign(x) w), and the pair sums add up in 16-bit lanes, 32 products
+// per multiply-add instead of 16. The AVX-512 entries use it as well, it was
+// at least as fast as a 512-bit version on the layer shapes timed.
+__attribute__((target("avx2"))) static void
+narrow8Avx2(const int8_t *weights, int rows, int cols, const int8_t *in,
+            int32_t *out)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+
+    for (int j = 0; j < cols; j++) {
+        const int8_t *w = weights + (size_t)j * rows;
+        __m256i acc = _mm256_setzero_si256();
+        int i = 0;
+
+        for (; i + 32 <= rows; i += 32) {
+            __m256i w0 = _mm256_loadu_si256((const __m256i *)(w + i));
+            __m256i x0 = _mm256_loadu_si256((const __m256i *)(in + i));
+            acc = _mm256_add_epi16(
+                acc, _mm256_maddubs_epi16(_mm256_abs_epi8(x0),
+                                          _mm256_sign_epi8(w0, x0)));
+        }
+
+        int32_t sum = horizontalSum(_mm256_madd_epi16(acc, ones));
+        for (; i < rows; i++)
+            sum += (int32_t)w[i] * (int32_t)in[i];
+        out[j] = sum;
+    }
+}
+
+// Sparse kernels - One vpmaddwd per block. Blocks are 256 bits wide, so the
+// AVX-512 entries use these as well.
+__attribute__((target("avx2"))) static void
+sparse16Avx2(const int16_t *blocks, const int32_t *blockRows,
+             const int32_t *columnStarts, int cols, const int16_t *in,
+             int32_t *out)
+{
+    for (int j = 0; j < cols; j++) {
+        __m256i acc = _mm256_setzero_si256();
+
+        for (int b = columnStarts[j]; b < columnStarts[j + 1]; b++) {
+            __m256i w0 = _mm256_loadu_si256(
+                (const __m256i *)(blocks + (size_t)b * sparseBlockRows));
+            __m256i x0 =
+                _mm256_loadu_si256((const __m256i *)(in + blockRows[b]));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(w0, x0));
+        }
+
+        out[j] = horizontalSum(acc);
+    }
+}
+
+__attribute__((target("avx2"))) static void
+sparse8Avx2(const int8_t *blocks, const int32_t *blockRows,
+            const int32_t *columnStarts, int cols, const int8_t *in,
+            int32_t *out)
+{
+    for (int j = 0; j < cols; j++) {
+        __m256i acc = _mm256_setzero_si256();
+
+        for (int b = columnStarts[j]; b < columnStarts[j + 1]; b++) {
+            __m256i w0 = _mm256_cvtepi8_epi16(_mm_loadu_si128(
+                (const __m128i *)(blocks + (size_t)b * sparseBlockRows)));
+            __m256i x0 = _mm256_cvtepi8_epi16(
+                _mm_loadu_si128((const __m128i *)(in + blockRows[b])));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(w0, x0));
+        }
+
+        out[j] = horizontalSum(acc);
+    }
+}
+
+// Nonzero kernels - A byte mask of the zero inputs, the set bits of its
+// complement are the nonzero inputs (twice each for 16-bit inputs)
+__attribute__((target("avx2,bmi"))) static int
+nonzero16Avx2(const int16_t *in, int size, int32_t *indices)
+{
+    int count = 0;
+    int i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        __m256i x0 = _mm256_loadu_si256((const __m256i *)(in + i));
+        uint32_t zero = _mm256_movemask_epi8(
+            _mm256_cmpeq_epi16(x0, _mm256_setzero_si256()));
+        uint32_t mask = ~zero & 0x55555555;
+
+        for (; mask; mask &= mask - 1)
+            indices[count++] = i + (int)(__builtin_ctz(mask) >> 1);
+    }
+
+    for (; i < size; i++) {
+        indices[count] = i;
+        count += in[i] != 0;
+    }
+
+    return count;
+}
+
+__attribute__((target("avx2,bmi"))) static int
+nonzero8Avx2(const int8_t *in, int size, int32_t *indices)
+{
+    int count = 0;
+    int i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        __m256i x0 = _mm256_loadu_si256((const __m256i *)(in + i));
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(x0, _mm256_setzero_si256()));
+
+        for (; mask; mask &= mask - 1)
+            indices[count++] = i + (int)__builtin_ctz(mask);
+    }
+
+    for (; i < size; i++) {
+        indices[count] = i;
+        count += in[i] != 0;
+    }
+
+    return count;
+}
+
+// Rows kernels - Rows are taken two at a time and interleaved, so that one
+// vpmaddwd multiplies both by their inputs and adds them. The interleaving
+// works within 128-bit lanes, lo holds the sums of columns 0-3 and 8-11 of
+// the run, hi those of columns 4-7 and 12-15.
+__attribute__((target("avx2"))) static inline void
+storeRowSums(__m256i lo, __m256i hi, int32_t *out, int n)
+{
+    __m256i sums0 = _mm256_permute2x128_si256(lo, hi, 0x20);
+    __m256i sums1 = _mm256_permute2x128_si256(lo, hi, 0x31);
+
+    if (n >= 16) {
+        _mm256_storeu_si256((__m256i *)out, sums0);
+        _mm256_storeu_si256((__m256i *)(out + 8), sums1);
+    } else {
+        int32_t sums[16];
+
+        _mm256_storeu_si256((__m256i *)sums, sums0);
+        _mm256_storeu_si256((__m256i *)(sums + 8), sums1);
+        for (int j = 0; j < n; j++)
+            out[j] = sums[j];
+    }
+}
+
+// Pair of 16-bit inputs, first one in the low half
+static inline int32_t inputPair(int a, int b)
+{
+    return (int32_t)((uint32_t)(uint16_t)a | ((uint32_t)(uint16_t)b << 16));
+}
+
+__attribute__((target("avx2"))) static void
+rows16Avx2(const int16_t *weightRows, int stride, int cols,
+           const int32_t *indices, int count, const int16_t *in, int32_t *out)
+{
+    for (int c = 0; c < cols; c += 16) {
+        const int16_t *w = weightRows + c;
+        __m256i lo = _mm256_setzero_si256();
+        __m256i hi = _mm256_setzero_si256();
+
+        for (int k = 0; k < count; k += 2) {
+            int a = indices[k];
+            int b = k + 1 < count ? indices[k + 1] : a;
+            __m256i wa =
+                _mm256_loadu_si256((const __m256i *)(w + (size_t)a * stride));
+            __m256i wb =
+                _mm256_loadu_si256((const __m256i *)(w + (size_t)b * stride));
+            __m256i x = _mm256_set1_epi32(
+                inputPair(in[a], k + 1 < count ? in[b] : 0));
+
+            lo = _mm256_add_epi32(
+                lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(wa, wb), x));
+            hi = _mm256_add_epi32(
+                hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(wa, wb), x));
+        }
+
+        storeRowSums(lo, hi, out + c, cols - c);
+    }
+}
+
+__attribute__((target("avx2"))) static void
+rows8Avx2(const int8_t *weightRows, int stride, int cols,
+          const int32_t *indices, int count, const int8_t *in, int32_t *out)
+{
+    for (int c = 0; c < cols; c += 16) {
+        const int8_t *w = weightRows + c;
+        __m256i lo = _mm256_setzero_si256();
+        __m256i hi = _mm256_setzero_si256();
+
+        for (int k = 0; k < count; k += 2) {
+            int a = indices[k];
+            int b = k + 1 < count ? indices[k + 1] : a;
+            __m256i wa = _mm256_cvtepi8_epi16(
+                _mm_loadu_si128((const __m128i *)(w + (size_t)a * stride)));
+            __m256i wb = _mm256_cvtepi8_epi16(
+                _mm_loadu_si128((const __m128i *)(w + (size_t)b * stride)));
+            __m256i x = _mm256_set1_epi32(
+                inputPair(in[a], k + 1 < count ? in[b] : 0));
+
+            lo = _mm256_add_epi32(
+                lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(wa, wb), x));
+            hi = _mm256_add_epi32(
+                hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(wa, wb), x));
+        }
+
+        storeRowSums(lo, hi, out + c, cols - c);
+    }
+}
+
+// Planes kernels - Shifting bit b of each input to its sign bit, vpmovmskb
+// gathers it for 32 inputs (16-bit inputs are packed to bytes first, with
+// signed saturation keeping their sign). Partial words go through a copy
+// padded with zeros.
+__attribute__((target("avx2"))) static int
+planes16Avx2(const int16_t *in, int size, uint64_t *planes)
+{
+    int words = (size + 63) / 64;
+
+    for (int w = 0; w < words; w++) {
+        const int16_t *x = in + 64 * w;
+        int16_t padded[64];
+
+        if (size - 64 * w < 64) {
+            fill(copy(x, in + size, padded), padded + 64, 0);
+            x = padded;
+        }
+
+        __m256i x0 = _mm256_loadu_si256((const __m256i *)x);
+        __m256i x1 = _mm256_loadu_si256((const __m256i *)(x + 16));
+        __m256i x2 = _mm256_loadu_si256((const __m256i *)(x + 32));
+        __m256i x3 = _mm256_loadu_si256((const __m256i *)(x + 48));
+
+        for (int b = 0; b < 16; b++) {
+            __m128i count = _mm_cvtsi32_si128(15 - b);
+            __m256i lo = _mm256_packs_epi16(_mm256_sll_epi16(x0, count),
+                                            _mm256_sll_epi16(x1, count));
+            __m256i hi = _mm256_packs_epi16(_mm256_sll_epi16(x2, count),
+                                            _mm256_sll_epi16(x3, count));
+
+            // packs interleaves the 128-bit lanes of its operands
+            lo = _mm256_permute4x64_epi64(lo, 0xd8);
+            hi = _mm256_permute4x64_epi64(hi, 0xd8);
+
+            planes[(size_t)b * words + w] =
+                (uint32_t)_mm256_movemask_epi8(lo) |
+                (uint64_t)(uint32_t)_mm256_movemask_epi8(hi) << 32;
+        }
+    }
+
+    return usedPlanes(planes, words, 16);
+}
+
+__attribute__((target("avx2"))) static int
+planes8Avx2(const int8_t *in, int size, uint64_t *planes)
+{
+    int words = (size + 63) / 64;
+
+    for (int w = 0; w < words; w++) {
+        const int8_t *x = in + 64 * w;
+        int8_t padded[64];
+
+        if (size - 64 * w < 64) {
+            fill(copy(x, in + size, padded), padded + 64, 0);
+            x = padded;
+        }
+
+        __m256i x0 = _mm256_loadu_si256((const __m256i *)x);
+        __m256i x1 = _mm256_loadu_si256((const __m256i *)(x + 32));
+
+        // Shifting 16-bit lanes, the high byte's bit b lands on its own sign
+        // bit like the low byte's
+        for (int b = 0; b < 8; b++) {
+            __m128i count = _mm_cvtsi32_si128(7 - b);
+
+            planes[(size_t)b * words + w] =
+                (uint32_t)_mm256_movemask_epi8(_mm256_sll_epi16(x0, count)) |
+                (uint64_t)(uint32_t)_mm256_movemask_epi8(
+                    _mm256_sll_epi16(x1, count))
+                    << 32;
+        }
+    }
+
+    return usedPlanes(planes, words, 8);
+}
+
+// ***
+// AVX-512 kernels - 32 pairs of 16-bit operands per instruction, the tail is
+// handled with masked loads
+// ***
+
+__attribute__((target("avx512f,avx512bw,avx512vl"))) static int32_t
+horizontalSum512(__m512i v)
+{
+    int32_t lanes[16];
+    int32_t sum = 0;
+
+    _mm512_storeu_si512(lanes, v);
+    for (int i = 0; i < 16; i++)
+        sum += lanes[i];
+    return sum;
+}
+
+// Mask of the first n lanes, all of them when n is past the vector width
+static inline uint32_t laneMask32(int n)
+{
+    return n >= 32 ? ~(uint32_t)0 : ((uint32_t)1 << n) - 1;
+}
+
+static inline uint64_t laneMask64(int n)
+{
+    return n >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1;
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl"))) static void
+product16Avx512(const int16_t *weights, int rows, int cols, const int16_t *in,
+                int32_t *out)
+{
+    for (int j = 0; j < cols; j++) {
+        const int16_t *w = weights + (size_t)j * rows;
+        __m512i acc0 = _mm512_setzero_si512();
+        __m512i acc1 = _mm512_setzero_si512();
+        int i = 0;
+
+        for (; i + 64 <= rows; i += 64) {
+            __m512i w0 = _mm512_loadu_si512(w + i);
+            __m512i w1 = _mm512_loadu_si512(w + i + 32);
+            __m512i x0 = _mm512_loadu_si512(in + i);
+            __m512i x1 = _mm512_loadu_si512(in + i + 32);
+            acc0 = _mm512_add_epi32(acc0, _mm512_madd_epi16(w0, x0));
+            acc1 = _mm512_add_epi32(acc1, _mm512_madd_epi16(w1, x1));
+        }
+        for (; i < rows; i += 32) {
+            __mmask32 mask = laneMask32(rows - i);
+            __m512i w0 = _mm512_maskz_loadu_epi16(mask, w + i);
+            __m512i x0 = _mm512_maskz_loadu_epi16(mask, in + i);
+            acc0 = _mm512_add_epi32(acc0, _mm512_madd_epi16(w0, x0));
+        }
+
+        out[j] = horizontalSum512(_mm512_add_epi32(acc0, acc1));
+    }
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl"))) static void
+product8Avx512(const int8_t *weights, int rows, int cols, const int8_t *in,
+               int32_t *out)
+{
+    for (int j = 0; j < cols; j++) {
+        const int8_t *w = weights + (size_t)j * rows;
+        __m512i acc0 = _mm512_setzero_si512();
+        __m512i acc1 = _mm512_setzero_si512();
+        int i = 0;
+
+        for (; i + 64 <= rows; i += 64) {
+            __m512i w0 = _mm512_cvtepi8_epi16(
+                _mm256_loadu_si256((const __m256i *)(w + i)));
+            __m512i w1 = _mm512_cvtepi8_epi16(
+                _mm256_loadu_si256((const __m256i *)(w + i + 32)));
+            __m512i x0 = _mm512_cvtepi8_epi16(
+                _mm256_loadu_si256((const __m256i *)(in + i)));
+            __m512i x1 = _mm512_cvtepi8_epi16(
+                _mm256_loadu_si256((const __m256i *)(in + i + 32)));
+            acc0 = _mm512_add_epi32(acc0, _mm512_madd_epi16(w0, x0));
+            acc1 = _mm512_add_epi32(acc1, _mm512_madd_epi16(w1, x1));
+        }
+        for (; i < rows; i += 32) {
+            __mmask32 mask = laneMask32(rows - i);
+            __m512i w0 =
+                _mm512_cvtepi8_epi16(_mm256_maskz_loadu_epi8(mask, w + i));
+            __m512i x0 =
+                _mm512_cvtepi8_epi16(_mm256_maskz_loadu_epi8(mask, in + i));
+            acc0 = _mm512_add_epi32(acc0, _mm512_madd_epi16(w0, x0));
+        }
+
+        out[j] = horizontalSum512(_mm512_add_epi32(acc0, acc1));
+    }
+}
+
+// Block kernels - As the AVX2 ones, the tail of each column with masked loads
+__attribute__((target("avx512f,avx512bw,avx512vl"))) static inline __m512i
+multiplyAddAvx512(__m512i acc, __m512i w, __m512i x)
+{
+    return _mm512_add_epi32(acc, _mm512_madd_epi16(w, x));
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl"))) static inline __m512i
+load16Avx512(__mmask32 mask, const int16_t *p)
+{
+    return _mm512_maskz_loadu_epi16(mask, p);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl"))) static inline __m512i
+load8Avx512(__mmask32 mask, const int8_t *p)
+{
+    return _mm512_cvtepi8_epi16(_mm256_maskz_loadu_epi8(mask, p));
+}
+
+// Sum of the two halves of v, through memory like horizontalSum512
+__attribute__((target("avx512f,avx512bw,avx512vl"))) static inline __m256i
+foldHalves512(__m512i v)
+{
+    int32_t lanes[16];
+
+    _mm512_storeu_si512(lanes, v);
+    return _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)lanes),
+                            _mm256_loadu_si256((const __m256i *)(lanes + 8)));
+}
+
+// Horizontal sums of a, b, c and d, in that order
+__attribute__((target("avx512f,avx512bw,avx512vl"))) static inline __m128i
+horizontalSums512(__m512i a, __m512i b, __m512i c, __m512i d)
+{
+    return horizontalSums(foldHalves512(a), foldHalves512(b),
+                          foldHalves512(c), foldHalves512(d));
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl"))) static void
+block16Avx512(const int16_t *weights, int rows, int cols, const int16_t *in,
+              int inStride, int count, int32_t *out, int outStride)
+{
+    int s = 0;
+
+    for (; s + blockSamples <= count; s += blockSamples) {
+        const int16_t *x0 = in + (size_t)s * inStride;
+        const int16_t *x1 = x0 + inStride;
+        const int16_t *x2 = x1 + inStride;
+        const int16_t *x3 = x2 + inStride;
+        int32_t *o = out + (size_t)s * outStride;
+
+        for (int j = 0; j < cols; j++) {
+            const int16_t *w = weights + (size_t)j * rows;
+            __m512i acc0 = _mm512_setzero_si512();
+            __m512i acc1 = _mm512_setzero_si512();
+            __m512i acc2 = _mm512_setzero_si512();
+            __m512i acc3 = _mm512_setzero_si512();
+
+            for (int i = 0; i < rows; i += 32) {
+                __mmask32 mask = laneMask32(rows - i);
+                __m512i w0 = load16Avx512(mask, w + i);
+                acc0 = multiplyAddAvx512(acc0, w0, load16Avx512(mask, x0 + i));
+                acc1 = multiplyAddAvx512(acc1, w0, load16Avx512(mask, x1 + i));
+                acc2 = multiplyAddAvx512(acc2, w0, load16Avx512(mask, x2 + i));
+                acc3 = multiplyAddAvx512(acc3, w0, load16Avx512(mask, x3 + i));
+            }
+
+            int32_t sums[blockSamples];
+            _mm_storeu_si128((__m128i *)sums,
+                             horizontalSums512(acc0, acc1, acc2, acc3));
+            storeBlockSums(sums, o + j, outStride);
+        }
+    }
+
+    for (; s < count; s++)
+        product16Avx512(weights, rows, cols, in + (size_t)s * inStride,
+                        out + (size_t)s * outStride);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl"))) static void
+block8Avx512(const int8_t *weights, int rows, int cols, const int8_t *in,
+             int inStride, int count, int32_t *out, int outStride)
+{
+    int s = 0;
+
+    for (; s + blockSamples <= count; s += blockSamples) {
+        const int8_t *x0 = in + (size_t)s * inStride;
+        const int8_t *x1 = x0 + inStride;
+        const int8_t *x2 = x1 + inStride;
+        const int8_t *x3 = x2 + inStride;
+        int32_t *o = out + (size_t)s * outStride;
+
+        for (int j = 0; j < cols; j++) {
+            const int8_t *w = weights + (size_t)j * rows;
+            __m512i acc0 = _mm512_setzero_si512();
+            __m512i acc1 = _mm512_setzero_si512();
+            __m512i acc2 = _mm512_setzero_si512();
+            __m512i acc3 = _mm512_setzero_si512();
+
+            for (int i = 0; i < rows; i += 32) {
+                __mmask32 mask = laneMask32(rows - i);
+                __m512i w0 = load8Avx512(mask, w + i);
+                acc0 = multiplyAddAvx512(acc0, w0, load8Avx512(mask, x0 + i));
+                acc1 = multiplyAddAvx512(acc1, w0, load8Avx512(mask, x1 + i));
+                acc2 = multiplyAddAvx512(acc2, w0, load8Avx512(mask, x2 + i));
+                acc3 = multiplyAddAvx512(acc3, w0, load8Avx512(mask, x3 + i));
+            }
+
+            int32_t sums[blockSamples];
+            _mm_storeu_si128((__m128i *)sums,
+                             horizontalSums512(acc0, acc1, acc2, acc3));
+            storeBlockSums(sums, o + j, outStride);
+        }
+    }
+
+    for (; s < count; s++)
+        product8Avx512(weights, rows, cols, in + (size_t)s * inStride,
+                       out + (size_t)s * outStride);
+}
+
+// ***
+// AVX-512 VNNI kernels - vpdpwssd fuses the 16-bit multiply-add with the
+// accumulation. For 8 bits vpdpbusd multiplies unsigned by signed bytes, so
+// the neurons are offset by 128 into the unsigned range and 128 * sum(w) is
+// taken back out, sum(w) coming from a second vpdpbusd against ones.
+// ***
+
+__attribute__((target("avx512f,avx512bw,avx512vl,avx512vnni"))) static
+void product16Avx512Vnni(const int16_t *weights, int rows, int cols,
+                         const int16_t *in, int32_t *out)
+{
+    for (int j = 0; j < cols; j++) {
+        const int16_t *w = weights + (size_t)j * rows;
+        __m512i acc0 = _mm512_setzero_si512();
+        __m512i acc1 = _mm512_setzero_si512();
+        int i = 0;
+
+        for (; i + 64 <= rows; i += 64) {
+            __m512i w0 = _mm512_loadu_si512(w + i);
+            __m512i w1 = _mm512_loadu_si512(w + i + 32);
+            __m512i x0 = _mm512_loadu_si512(in + i);
+            __m512i x1 = _mm512_loadu_si512(in + i + 32);
+            acc0 = _mm512_dpwssd_epi32(acc0, w0, x0);
+            acc1 = _mm512_dpwssd_epi32(acc1, w1, x1);
+        }
+        for (; i < rows; i += 32) {
+            __mmask32 mask = laneMask32(rows - i);
+            __m512i w0 = _mm512_maskz_loadu_epi16(mask, w + i);
+            __m512i x0 = _mm512_maskz_loadu_epi16(mask, in + i);
+            acc0 = _mm512_dpwssd_epi32(acc0, w0, x0);
+        }
+
+        out[j] = horizontalSum512(_mm512_add_epi32(acc0, acc1));
+    }
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl,avx512vnni"))) static
+void product8Avx512Vnni(const int8_t *weights, int rows, int cols,
+                        const int8_t *in, int32_t *out)
+{
+    const __m512i offset = _mm512_set1_epi8((char)0x80);
+    const __m512i ones = _mm512_set1_epi8(1);
+
+    for (int j = 0; j < cols; j++) {
+        const int8_t *w = weights + (size_t)j * rows;
+        __m512i acc = _mm512_setzero_si512();
+        __m512i accWeights = _mm512_setzero_si512();
+
+        for (int i = 0; i < rows; i += 64) {
+            __mmask64 mask = laneMask64(rows - i);
+            __m512i w0 = _mm512_maskz_loadu_epi8(mask, w + i);
+            __m512i x0 = _mm512_xor_si512(
+                _mm512_maskz_loadu_epi8(mask, in + i), offset);
+            acc = _mm512_dpbusd_epi32(acc, x0, w0);
+            accWeights = _mm512_dpbusd_epi32(accWeights, ones, w0);
+        }
+
+        out[j] =
+            horizontalSum512(acc) - 128 * horizontalSum512(accWeights);
+    }
+}
+
+// Block kernels - As the AVX-512 ones; for 8 bits the weight sums are taken
+// once for the whole group of samples
+__attribute__((target("avx512f,avx512bw,avx512vl,avx512vnni"))) static
+void block16Avx512Vnni(const int16_t *weights, int rows, int cols,
+                       const int16_t *in, int inStride, int count,
+                       int32_t *out, int outStride)
+{
+    int s = 0;
+
+    for (; s + blockSamples <= count; s += blockSamples) {
+        const int16_t *x0 = in + (size_t)s * inStride;
+        const int16_t *x1 = x0 + inStride;
+        const int16_t *x2 = x1 + inStride;
+        const int16_t *x3 = x2 + inStride;
+        int32_t *o = out + (size_t)s * outStride;
+
+        for (int j = 0; j < cols; j++) {
+            const int16_t *w = weights + (size_t)j * rows;
+            __m512i acc0 = _mm512_setzero_si512();
+            __m512i acc1 = _mm512_setzero_si512();
+            __m512i acc2 = _mm512_setzero_si512();
+            __m512i acc3 = _mm512_setzero_si512();
+
+            for (int i = 0; i < rows; i += 32) {
+                __mmask32 mask = laneMask32(rows - i);
+                __m512i w0 = load16Avx512(mask, w + i);
+                acc0 = _mm512_dpwssd_epi32(acc0, w0,
+                                           load16Avx512(mask, x0 + i));
+                acc1 = _mm512_dpwssd_epi32(acc1, w0,
+                                           load16Avx512(mask, x1 + i));
+                acc2 = _mm512_dpwssd_epi32(acc2, w0,
+                                           load16Avx512(mask, x2 + i));
+                acc3 = _mm512_dpwssd_epi32(acc3, w0,
+                                           load16Avx512(mask, x3 + i));
+            }
+
+            int32_t sums[blockSamples];
+            _mm_storeu_si128((__m128i *)sums,
+                             horizontalSums512(acc0, acc1, acc2, acc3));
+            storeBlockSums(sums, o + j, outStride);
+        }
+    }
+
+    for (; s < count; s++)
+        product16Avx512Vnni(weights, rows, cols, in + (size_t)s * inStride,
+                            out + (size_t)s * outStride);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl,avx512vnni"))) static inline
+__m512i loadOffset8Avx512(__mmask64 mask, const int8_t *p)
+{
+    return _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, p),
+                            _mm512_set1_epi8((char)0x80));
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl,avx512vnni"))) static
+void block8Avx512Vnni(const int8_t *weights, int rows, int cols,
+                      const int8_t *in, int inStride, int count, int32_t *out,
+                      int outStride)
+{
+    const __m512i ones = _mm512_set1_epi8(1);
+    int s = 0;
+
+    for (; s + blockSamples <= count; s += blockSamples) {
+        const int8_t *x0 = in + (size_t)s * inStride;
+        const int8_t *x1 = x0 + inStride;
+        const int8_t *x2 = x1 + inStride;
+        const int8_t *x3 = x2 + inStride;
+        int32_t *o = out + (size_t)s * outStride;
+
+        for (int j = 0; j < cols; j++) {
+            const int8_t *w = weights + (size_t)j * rows;
+            __m512i acc0 = _mm512_setzero_si512();
+            __m512i acc1 = _mm512_setzero_si512();
+            __m512i acc2 = _mm512_setzero_si512();
+            __m512i acc3 = _mm512_setzero_si512();
+            __m512i accWeights = _mm512_setzero_si512();
+
+            for (int i = 0; i < rows; i += 64) {
+                __mmask64 mask = laneMask64(rows - i);
+                __m512i w0 = _mm512_maskz_loadu_epi8(mask, w + i);
+                acc0 = _mm512_dpbusd_epi32(
+                    acc0, loadOffset8Avx512(mask, x0 + i), w0);
+                acc1 = _mm512_dpbusd_epi32(
+                    acc1, loadOffset8Avx512(mask, x1 + i), w0);
+                acc2 = _mm512_dpbusd_epi32(
+                    acc2, loadOffset8Avx512(mask, x2 + i), w0);
+                acc3 = _mm512_dpbusd_epi32(
+                    acc3, loadOffset8Avx512(mask, x3 + i), w0);
+                accWeights = _mm512_dpbusd_epi32(accWeights, ones, w0);
+            }
+
+            __m128i offset = _mm_set1_epi32(128 * horizontalSum512(accWeights));
+            int32_t sums[blockSamples];
+            _mm_storeu_si128(
+                (__m128i *)sums,
+                _mm_sub_epi32(horizontalSums512(acc0, acc1, acc2, acc3),
+                              offset));
+            storeBlockSums(sums, o + j, outStride);
+        }
+    }
+
+    for (; s < count; s++)
+        product8Avx512Vnni(weights, rows, cols, in + (size_t)s * inStride,
+                           out + (size_t)s * outStride);
+}
+
+// Nonzero kernels - The indices of the nonzero inputs of each run of 16 are
+// written out with one vpcompressd, the tail is handled with masked loads
+__attribute__((target("avx512f,avx512bw,avx512vl"))) static int
+nonzero16Avx512(const int16_t *in, int size, int32_t *indices)
+{
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                            11, 12, 13, 14, 15);
+    int count = 0;
+
+    for (int i = 0; i < size; i += 16) {
+        __m256i x0 = _mm256_maskz_loadu_epi16(laneMask32(size - i), in + i);
+        __mmask16 mask = _mm256_test_epi16_mask(x0, x0);
+
+        _mm512_mask_compressstoreu_epi32(
+            indices + count, mask,
+            _mm512_add_epi32(lanes, _mm512_set1_epi32(i)));
+        count += __builtin_popcount(mask);
+    }
+
+    return count;
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl"))) static int
+nonzero8Avx512(const int8_t *in, int size, int32_t *indices)
+{
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                            11, 12, 13, 14, 15);
+    int count = 0;
+
+    for (int i = 0; i < size; i += 16) {
+        __m128i x0 = _mm_maskz_loadu_epi8(laneMask32(size - i), in + i);
+        __mmask16 mask = _mm_test_epi8_mask(x0, x0);
+
+        _mm512_mask_compressstoreu_epi32(
+            indices + count, mask,
+            _mm512_add_epi32(lanes, _mm512_set1_epi32(i)));
+        count += __builtin_popcount(mask);
+    }
+
+    return count;
+}
+
+// Sparse kernels - vpdpwssd on 256-bit blocks
+__attribute__((target("avx2,avx512f,avx512bw,avx512vl,avx512vnni"))) static
+void sparse16Avx512Vnni(const int16_t *blocks, const int32_t *blockRows,
+                        const int32_t *columnStarts, int cols,
+                        const int16_t *in, int32_t *out)
+{
+    for (int j = 0; j < cols; j++) {
+        __m256i acc = _mm256_setzero_si256();
+
+        for (int b = columnStarts[j]; b < columnStarts[j + 1]; b++) {
+            __m256i w0 = _mm256_loadu_si256(
+                (const __m256i *)(blocks + (size_t)b * sparseBlockRows));
+            __m256i x0 =
+                _mm256_loadu_si256((const __m256i *)(in + blockRows[b]));
+            acc = _mm256_dpwssd_epi32(acc, w0, x0);
+        }
+
+        out[j] = horizontalSum(acc);
+    }
+}
+
+__attribute__((target("avx2,avx512f,avx512bw,avx512vl,avx512vnni"))) static
+void sparse8Avx512Vnni(const int8_t *blocks, const int32_t *blockRows,
+                       const int32_t *columnStarts, int cols,
+                       const int8_t *in, int32_t *out)
+{
+    for (int j = 0; j < cols; j++) {
+        __m256i acc = _mm256_setzero_si256();
+
+        for (int b = columnStarts[j]; b < columnStarts[j + 1]; b++) {
+            __m256i w0 = _mm256_cvtepi8_epi16(_mm_loadu_si128(
+                (const __m128i *)(blocks + (size_t)b * sparseBlockRows)));
+            __m256i x0 = _mm256_cvtepi8_epi16(
+                _mm_loadu_si128((const __m128i *)(in + blockRows[b])));
+            acc = _mm256_dpwssd_epi32(acc, w0, x0);
+        }
+
+        out[j] = horizontalSum(acc);
+    }
+}
+
+// Planes kernels - vptestmw (vptestmb) gathers bit b of 32 (64) inputs into a
+// mask, two masks (one) per plane word
+__attribute__((target("avx512f,avx512bw,avx512vl"))) static int
+planes16Avx512(const int16_t *in, int size, uint64_t *planes)
+{
+    int words = (size + 63) / 64;
+
+    for (int w = 0; w < words; w++) {
+        int i = 64 * w;
+        __m512i x0 = _mm512_maskz_loadu_epi16(laneMask32(size - i), in + i);
+        __m512i x1 = _mm512_maskz_loadu_epi16(
+            size - i > 32 ? laneMask32(size - i - 32) : 0, in + i + 32);
+
+        for (int b = 0; b < 16; b++) {
+            __m512i bit = _mm512_set1_epi16((short)(1 << b));
+            uint64_t lo = _mm512_test_epi16_mask(x0, bit);
+            uint64_t hi = _mm512_test_epi16_mask(x1, bit);
+
+            planes[(size_t)b * words + w] = lo | hi << 32;
+        }
+    }
+
+    return usedPlanes(planes, words, 16);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl"))) static int
+planes8Avx512(const int8_t *in, int size, uint64_t *planes)
+{
+    int words = (size + 63) / 64;
+
+    for (int w = 0; w < words; w++) {
+        int i = 64 * w;
+        __m512i x0 = _mm512_maskz_loadu_epi8(laneMask64(size - i), in + i);
+
+        for (int b = 0; b < 8; b++)
+            planes[(size_t)b * words + w] =
+                _mm512_test_epi8_mask(x0, _mm512_set1_epi8((char)(1 << b)));
+    }
+
+    return usedPlanes(planes, words, 8);
+}
+
+// ***
+// AVX-512 VPOPCNTDQ kernel - 8 columns at a time, vpopcntq counting each
+// column's word against the broadcast plane word
+// ***
+
+__attribute__((target("avx2,avx512f,avx512bw,avx512vl,avx512vpopcntdq,"
+                      "popcnt"))) static void
+ternaryAvx512Popcnt(const uint64_t *positive, const uint64_t *negative,
+                    int stride, int words, int cols, const uint64_t *planes,
+                    int numPlanes, int32_t *out)
+{
+    for (int j = 0; j < cols; j += ternaryColumnAlignment) {
+        __m512i acc = _mm512_setzero_si512();
+
+        for (int b = 0; b < numPlanes; b++) {
+            const uint64_t *plane = planes + (size_t)b * words;
+            __m512i count = _mm512_setzero_si512();
+
+            for (int w = 0; w < words; w++) {
+                uint64_t x = plane[w];
+                size_t k = (size_t)w * stride + j;
+
+                if (!x)
+                    continue;
+
+                __m512i x0 = _mm512_set1_epi64((long long)x);
+                __m512i p = _mm512_popcnt_epi64(
+                    _mm512_and_si512(x0, _mm512_loadu_si512(positive + k)));
+
+                if (negative) {
+                    __m512i n = _mm512_popcnt_epi64(_mm512_and_si512(
+                        x0, _mm512_loadu_si512(negative + k)));
+                    count = _mm512_add_epi64(count, _mm512_sub_epi64(p, n));
+                } else {
+                    __m512i all = _mm512_set1_epi64(__builtin_popcountll(x));
+                    count = _mm512_add_epi64(
+                        count, _mm512_sub_epi64(_mm512_add_epi64(p, p), all));
+                }
+            }
+
+            __m512i weighted = _mm512_maskz_sllv_epi64(
+                (__mmask8)0xff, count, _mm512_set1_epi64(b));
+            acc = b == numPlanes - 1 ? _mm512_sub_epi64(acc, weighted)
+                                     : _mm512_add_epi64(acc, weighted);
+        }
+
+        _mm512_mask_cvtepi64_storeu_epi32(
+            out + j, (__mmask8)laneMask32(cols - j), acc);
+    }
+}
+
+#endif // ENABLE_X86_KERNELS
+
+// ***
+// Dispatch
+// ***
+
+static const layerKernels kernelTable[numKernelIsas] = {
+    {kernelScalar, "scalar", product16Scalar, product8Scalar, sparse16Scalar,
+     sparse8Scalar, nonzeroScalar<int16_t>, nonzeroScalar<int8_t>,
+     rowsScalar<int16_t>, rowsScalar<int8_t>, planesScalar<int16_t>,
+     planesScalar<int8_t>, ternaryScalar, product8Scalar,
+     blockScalar<int16_t>, blockScalar<int8_t>},
+#if ENABLE_X86_KERNELS
+    {kernelAvx2, "avx2", product16Avx2, product8Avx2, sparse16Avx2,
+     sparse8Avx2, nonzero16Avx2, nonzero8Avx2, rows16Avx2, rows8Avx2,
+     planes16Avx2, planes8Avx2, ternaryPopcnt, narrow8Avx2, block16Avx2,
+     block8Avx2},
+    {kernelAvx512, "avx512", product16Avx512, product8Avx512, sparse16Avx2,
+     sparse8Avx2, nonzero16Avx512, nonzero8Avx512, rows16Avx2, rows8Avx2,
+     planes16Avx512, planes8Avx512, ternaryPopcnt, narrow8Avx2,
+     block16Avx512, block8Avx512},
+    {kernelAvx512Vnni, "avx512vnni", product16Avx512Vnni, product8Avx512Vnni,
+     sparse16Avx512Vnni, sparse8Avx512Vnni, nonzero16Avx512, nonzero8Avx512,
+     rows16Avx2, rows8Avx2, planes16Avx512, planes8Avx512, ternaryPopcnt,
+     narrow8Avx2, block16Avx512Vnni, block8Avx512Vnni},
+    {kernelAvx512Popcnt, "avx512popcnt", product16Avx512Vnni,
+     product8Avx512Vnni, sparse16Avx512Vnni, sparse8Avx512Vnni,
+     nonzero16Avx512, nonzero8Avx512, rows16Avx2, rows8Avx2, planes16Avx512,
+     planes8Avx512, ternaryAvx512Popcnt, narrow8Avx2, block16Avx512Vnni,
+     block8Avx512Vnni},
+#else
+    {kernelAvx2, "avx2", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {kernelAvx512, "avx512", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {kernelAvx512Vnni, "avx512vnni", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {kernelAvx512Popcnt, "avx512popcnt", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0},
+#endif
+};
+
+static bool isaSupported(layerKernelIsa isa)
+{
+#if ENABLE_X86_KERNELS
+    __builtin_cpu_init();
+
+    switch (isa) {
+    case kernelScalar:
+        return true;
+    case kernelAvx2:
+        return __builtin_cpu_supports("avx2");
+    case kernelAvx512:
+        return __builtin_cpu_supports("avx512f") &&
+               __builtin_cpu_supports("avx512bw") &&
+               __builtin_cpu_supports("avx512vl");
+    case kernelAvx512Vnni:
+        return __builtin_cpu_supports("avx512f") &&
+               __builtin_cpu_supports("avx512bw") &&
+               __builtin_cpu_supports("avx512vl") &&
+               __builtin_cpu_supports("avx512vnni");
+    case kernelAvx512Popcnt:
+        return isaSupported(kernelAvx512Vnni) &&
+               __builtin_cpu_supports("avx512vpopcntdq");
+    default:
+        return false;
+    }
+#else
+    return isa == kernelScalar;
+#endif
+}
+
+static layerKernelIsa bestIsa()
+{
+    int isa = numKernelIsas - 1;
+    while (isa > kernelScalar && !isaSupported((layerKernelIsa)isa))
+        isa--;
+
+    return (layerKernelIsa)isa;
+}
+
+const layerKernels &detectLayerKernels()
+{
+    // Initialized once, thread-safe since C++11
+    static const layerKernels &best = kernelTable[bestIsa()];
+
+    return best;
+}
+
+const layerKernels *getLayerKernels(layerKernelIsa isa)
+{
+    if (isa < kernelScalar || isa >= numKernelIsas || !isaSupported(isa))
+        return 0;
+
+    return &kernelTable[isa];
+}
+
+const layerKernels *getLayerKernels(string name)
+{
+    for (int isa = 0; isa < numKernelIsas; isa++) {
+        if (name == kernelTable[isa].name)
+            return getLayerKernels((layerKernelIsa)isa);
+    }
+
+    return 0;
+}
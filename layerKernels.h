@@ -0,0 +1,130 @@
+#ifndef LayerKernels
+#define LayerKernels
+
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+// Layer product kernels for narrow operands. Each computes
+//   out[j] = sum_i weights[j * rows + i] * in[i]   for j in [0, cols)
+// on a column-major weight matrix, summing in 32 bits. All variants give
+// bit-exact results as long as the sums do not overflow, which the model
+// checks for its bit depths.
+typedef void (*layerKernel16)(const int16_t *weights, int rows, int cols,
+                              const int16_t *in, int32_t *out);
+typedef void (*layerKernel8)(const int8_t *weights, int rows, int cols,
+                             const int8_t *in, int32_t *out);
+
+// Height of the weight blocks of sparse layers, one 256-bit multiply-add of
+// 16-bit operands
+const int sparseBlockRows = 16;
+
+// Sparse layer product kernels on blocked columns (see sparseWeights.h).
+// Column j keeps the blocks [columnStarts[j], columnStarts[j + 1]), block b
+// holds the sparseBlockRows weights of rows blockRows[b] onwards, so
+//   out[j] = sum_b sum_k blocks[b * sparseBlockRows + k] * in[blockRows[b] + k]
+// Blocks lie inside the input, they never read past it.
+typedef void (*sparseKernel16)(const int16_t *blocks, const int32_t *blockRows,
+                               const int32_t *columnStarts, int cols,
+                               const int16_t *in, int32_t *out);
+typedef void (*sparseKernel8)(const int8_t *blocks, const int32_t *blockRows,
+                              const int32_t *columnStarts, int cols,
+                              const int8_t *in, int32_t *out);
+
+// Sparse input kernels, for first layers whose inputs are mostly zero. The
+// nonzero kernels store the indices of the nonzero inputs and return their
+// count, the rows kernels then sum only the matching weight rows
+//   out[j] = sum_k weightRows[indices[k] * stride + j] * in[indices[k]]
+// from a row-major copy of the weights. stride is a multiple of
+// weightRowsAlignment and the padding after the cols weights of a row is
+// zero, whole aligned runs of a row are read.
+const int weightRowsAlignment = 16;
+
+typedef int (*nonzeroKernel16)(const int16_t *in, int size, int32_t *indices);
+typedef int (*nonzeroKernel8)(const int8_t *in, int size, int32_t *indices);
+typedef void (*rowsKernel16)(const int16_t *weightRows, int stride, int cols,
+                             const int32_t *indices, int count,
+                             const int16_t *in, int32_t *out);
+typedef void (*rowsKernel8)(const int8_t *weightRows, int stride, int cols,
+                            const int32_t *indices, int count,
+                            const int8_t *in, int32_t *out);
+
+// Ternary layer product kernels, for weights of -1, 0 or +1 packed in bits
+// (see ternaryWeights.h). The planes kernels split the inputs in bit planes,
+// plane b holding bit b of inputs [64 * w, 64 * w + 64) in planes[b * words +
+// w], and return the number of planes used: the top one is the sign of the
+// two's complement inputs, and those above it would only repeat it. The
+// ternary kernels then sum, for each plane b and word w,
+//   out[j] += s_b * (popcount(plane & positive[w * stride + j]) -
+//                    popcount(plane & negative[w * stride + j]))
+// with s_b = 2^b, or -2^b for the top plane. Binary weights have no negative
+// words (negative is null), their weights are -1 wherever they are not +1.
+// stride is a multiple of ternaryColumnAlignment and the padding columns are
+// zero, whole aligned runs of a word row are read.
+const int ternaryColumnAlignment = 8;
+
+typedef int (*planesKernel16)(const int16_t *in, int size, uint64_t *planes);
+typedef int (*planesKernel8)(const int8_t *in, int size, uint64_t *planes);
+typedef void (*ternaryKernel)(const uint64_t *positive,
+                              const uint64_t *negative, int stride, int words,
+                              int cols, const uint64_t *planes,
+                              int numPlanes, int32_t *out);
+
+// Layer product kernel for 8-bit operands summed in 16-bit lanes, twice the
+// products per instruction of layerKernel8. Results are the same only when
+// every partial sum of a column's products, in any order, fits int16_t (see
+// rangeAnalysis.h) and no weight is -128; the scalar entry is product8.
+typedef layerKernel8 narrowKernel8;
+
+// Block layer product kernels, layerKernel16 and layerKernel8 for count
+// samples at once. Sample s is read from in + s * inStride and its sums are
+// written to out + s * outStride. The vector kernels load each weight once
+// for a group of samples.
+typedef void (*blockKernel16)(const int16_t *weights, int rows, int cols,
+                              const int16_t *in, int inStride, int count,
+                              int32_t *out, int outStride);
+typedef void (*blockKernel8)(const int8_t *weights, int rows, int cols,
+                             const int8_t *in, int inStride, int count,
+                             int32_t *out, int outStride);
+
+// Instruction sets with a kernel implementation, from least to most capable
+// (avx512popcnt adds VPOPCNTDQ to avx512vnni)
+enum layerKernelIsa {
+    kernelScalar,
+    kernelAvx2,
+    kernelAvx512,
+    kernelAvx512Vnni,
+    kernelAvx512Popcnt,
+    numKernelIsas
+};
+
+struct layerKernels {
+    layerKernelIsa isa;
+    const char *name;
+    layerKernel16 product16;
+    layerKernel8 product8;
+    sparseKernel16 sparse16;
+    sparseKernel8 sparse8;
+    nonzeroKernel16 nonzero16;
+    nonzeroKernel8 nonzero8;
+    rowsKernel16 rows16;
+    rowsKernel8 rows8;
+    planesKernel16 planes16;
+    planesKernel8 planes8;
+    ternaryKernel ternary;
+    narrowKernel8 narrow8;
+    blockKernel16 block16;
+    blockKernel8 block8;
+};
+
+// Best kernels supported by this CPU (and OS), detected with CPUID on the
+// first call
+const layerKernels &detectLayerKernels();
+
+// Kernels for a given instruction set, or null if this CPU lacks it. The
+// scalar kernels are always available and serve as the reference.
+const layerKernels *getLayerKernels(layerKernelIsa isa);
+const layerKernels *getLayerKernels(string name);
+
+#endif
@@ -1,25 +1,71 @@
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <thread>
+#include <vector>
 
+#include "datasetFile.h"
 #include "ext/eigen-library/Eigen/Core"
 #include "integerNeuralNet.h"
+#include "parallelEvaluator.h"
+#include "pipelinedEvaluator.h"
 
 #define ENABLE_PARSEC_HOOKS 1
 #define ENABLE_TRACING 0
 #define ENABLE_WEIGHT_CONVERSION 1
+// Classify the test data in blocks of samples (ignored when tracing, which
+// needs the per-sample neuron values)
+#define ENABLE_BATCH_INFERENCE 1
+// Classify the test data on a pool of worker threads, the thread count may be
+// given as the first argument (also ignored when tracing)
+#define ENABLE_PARALLEL_EVALUATION 1
+// Classify the floating-point input file while a pipeline of threads parses
+// and quantizes it, instead of the converted test data (also ignored when
+// tracing)
+#define ENABLE_PIPELINED_EVALUATION 0
+// Load the network from the binary model file, mapped in place, instead of
+// the text weights and activation files
+#define ENABLE_BINARY_MODEL 1
+// Load the test data and labels from the binary dataset file, mapped in place,
+// instead of parsing the text input and output files
+#define ENABLE_BINARY_DATASET 1
+// Cache the results of classify for repeated samples, and print the cache's
+// counters at the end (off by default: the test samples are all distinct,
+// and the batched ROI never uses the cache)
+#define ENABLE_RESULT_CACHE 0
+// Record the latency of every classify call, their percentiles are printed
+// by the hooks at the end (off by default: the batched ROI records nothing,
+// only the few classify calls around it would be counted)
+#define ENABLE_LATENCY_TRACKING 0
 
 #if ENABLE_PARSEC_HOOKS
 #include "hooks.h"
+// Named regions, timed and summarized by the hooks library
+#define REGION_BEGIN(name) __parsec_region_begin(name)
+#define REGION_END(name) __parsec_region_end(name)
+#else
+#define REGION_BEGIN(name)
+#define REGION_END(name)
 #endif
 
 using namespace std;
-int main()
+
+int main(int argc, char *argv[])
 {
 #if ENABLE_PARSEC_HOOKS
     __parsec_bench_begin(__custom_integer_nn);
 #endif
 
-    int bits_neurons = 12, bits_weights = 12;
+    // Bit depths are compile-time constants, they select the storage types of
+    // the network (16-bit neurons and weights for 12 bits)
+    const int bits_neurons = 12, bits_weights = 12;
+    typedef integerNeuralNetFor<bits_neurons, bits_weights> network;
+
+    int num_threads = thread::hardware_concurrency();
+    if (argc > 1)
+        num_threads = atoi(argv[1]);
+    if (num_threads < 1)
+        num_threads = 1;
 
     // Original floating point neural-net files.
     string input_file = "fp-files/input.txt";
@@ -32,11 +78,19 @@ int main()
         "int-files/integerWeights_" + to_string(bits_weights) + "bits.txt";
     string activation_file =
         "int-files/activation_" + to_string(bits_neurons) + "bits.txt";
+    string dataset_file =
+        "int-files/integerInput_" + to_string(bits_neurons) + "bits.bin";
+    string model_file = "int-files/integerModel_" + to_string(bits_neurons) +
+                        "_" + to_string(bits_weights) + "bits.bin";
     // Tracing output file.
     string trace_file = "trace.out";
+    // Full scale of the floating-point inputs, which lie in [-1, 1]. The
+    // converted and the pipelined test data are both quantized against it,
+    // so either evaluation classifies the same samples.
+    const double input_scale = 1.0;
 
     // TODO: change numIn, numHid, numOut to come from files.
-    integerNeuralNet nn(400, 30, 10, bits_neurons, bits_weights);
+    network nn(400, 30, 10, bits_neurons, bits_weights);
     // The integer neural net is a slight modification of the floating-point one
     // In order to be easier to implement in hardware, all operations are
     // performed on integers of a given accuracy Integer networks are very
@@ -51,12 +105,22 @@ int main()
     // ***
 
 #if ENABLE_WEIGHT_CONVERSION
+    REGION_BEGIN("conversion");
+
     // To convert floating-point intputs to integers of the defined bit-depth,
-    // use convertFPInputs
-    nn.convertFPInputs(input_file, int_input_file);
+    // use convertFPInputs, which may also write them with their labels as a
+    // binary dataset
+#if ENABLE_BINARY_DATASET
+    nn.convertFPInputs(input_file, int_input_file, dataset_file, output_file,
+                       input_scale);
+#else
+    nn.convertFPInputs(input_file, int_input_file, "", "", input_scale);
+#endif
 
     // To convert saved weights from a floating-point network for use with an
-    // integer one, use convertFPWeights
+    // integer one, use convertFPWeights. Per-layer or per-neuron scales
+    // (scalePerLayer, scalePerNeuron) keep more of the weights' resolution at
+    // low bit depths.
     nn.convertFPWeights(weights_file, int_weights_file);
 
     // Because the best activation functions tend to rely on floating-point
@@ -64,22 +128,66 @@ int main()
     // pre-computed table The table may be computed according to the defined
     // bit-depth with the buildActivationTable function
     nn.buildActivationTable(activation_file);
+
+#if ENABLE_BINARY_MODEL
+    // Converted weights and activation table can be saved together in the
+    // binary model format with saveModel
+    nn.saveModel(model_file);
+#endif
+
+    REGION_END("conversion");
 #endif
 
     // ***
     // Standard operations
     // ***
 
+    REGION_BEGIN("loading");
+
+#if ENABLE_BINARY_MODEL
+    // Mapping the binary model file, weights and activation table are used
+    // straight from its pages
+    if (!nn.loadModel(model_file)) {
+        cerr << "Could not load model file " << model_file << endl;
+        return 1;
+    }
+#else
     // Loading integer saved weights
     nn.loadWeights(int_weights_file);
 
     // Loading pre-computed activation table
     nn.loadActivationTable(activation_file);
+#endif
 
+#if ENABLE_RESULT_CACHE
+    // Results of classify are kept for up to one sample in two, on every
+    // thread sharing the model
+    nn.getModel().enableResultCache(2500);
+#endif
+
+#if ENABLE_LATENCY_TRACKING
+    nn.getModel().setLatencyTracking(true);
+#endif
+
+#if ENABLE_BINARY_DATASET
+    // Test data and labels are used straight from the mapped dataset file
+    datasetReader<network::neuronType> dataset;
+    if (!dataset.open(dataset_file) || dataset.getSampleSize() != 400 ||
+        !dataset.hasLabels()) {
+        cerr << "Could not load dataset file " << dataset_file << endl;
+        return 1;
+    }
+
+    int num_data = dataset.getNumSamples();
+
+    Eigen::Ref<const network::neuronMatrix> input =
+        dataset.samples(0, num_data);
+    Eigen::Ref<const Eigen::VectorXi> output = dataset.labels(0, num_data);
+#else
     // Prepare to load test data
     int num_data = 5000;
 
-    Eigen::MatrixXi input(400, num_data);
+    network::neuronMatrix input(400, num_data);
     Eigen::VectorXi output(num_data);
 
     // Load test data
@@ -88,13 +196,19 @@ int main()
     outputs.open(output_file, ios::in);
 
     for (int i = 0; i < num_data; i++) {
-        for (int j = 0; j < 400; j++)
-            inputs >> input(j, i);
+        int temp;
+        for (int j = 0; j < 400; j++) {
+            inputs >> temp;
+            input(j, i) = saturateCast<network::neuronType>(temp);
+        }
         outputs >> output(i);
     }
 
     inputs.close();
     outputs.close();
+#endif
+
+    REGION_END("loading");
 
     // ***
     // Testing operations
@@ -110,9 +224,49 @@ int main()
     trace.open(trace_file, ios_base::app);
 #endif
 
+#if ENABLE_PARALLEL_EVALUATION && !ENABLE_TRACING
+    // Worker threads and their contexts are set up outside the ROI, all of
+    // them share the network's model
+    parallelEvaluator<network::neuronType, network::weightType,
+                      network::accumulatorType>
+        evaluator(nn.getModel(), num_threads);
+#endif
+
+#if ENABLE_PIPELINED_EVALUATION && !ENABLE_TRACING
+    // Stage threads are started by each run, blocks are allocated here
+    pipelinedEvaluator<network::neuronType, network::weightType,
+                       network::accumulatorType>
+        pipeline(nn.getModel(), input_scale);
+    vector<int> results;
+
+    results.reserve(num_data);
+#endif
+
 #if ENABLE_PARSEC_HOOKS
     __parsec_roi_begin();
 #endif
+#if ENABLE_PIPELINED_EVALUATION && !ENABLE_TRACING
+    if (!pipeline.classifyFile(input_file, results)) {
+        cerr << "Could not read input file " << input_file << endl;
+        return 1;
+    }
+
+    for (int i = 0; i < num_data && i < (int)results.size(); i++) {
+        if (results[i] == output(i)) {
+            correct++;
+        }
+    }
+#elif ENABLE_PARALLEL_EVALUATION && !ENABLE_TRACING
+    correct = evaluator.countCorrect(input, output);
+#elif ENABLE_BATCH_INFERENCE && !ENABLE_TRACING
+    vector<int> results = nn.classifyBatch(input);
+
+    for (int i = 0; i < num_data; i++) {
+        if (results[i] == output(i)) {
+            correct++;
+        }
+    }
+#else
     for (int i = 0; i < num_data; i++) {
         if (nn.classify(input.col(i)) == output(i)) {
             correct++;
@@ -127,6 +281,7 @@ int main()
         trace << endl;
 #endif
     }
+#endif
 #if ENABLE_PARSEC_HOOKS
     __parsec_roi_end();
 #endif
@@ -134,6 +289,15 @@ int main()
     accuracy = (double)correct / (double)num_data;
     cout << "Accuracy: " << accuracy << endl;
 
+#if ENABLE_PIPELINED_EVALUATION && !ENABLE_TRACING
+    const pipelineStats &stages = pipeline.getStats();
+    cout << "Pipeline: " << stages.samples << " samples, first result after "
+         << stages.firstResult * 1e3 << " ms, all after "
+         << stages.total * 1e3 << " ms (parsing " << stages.parsing * 1e3
+         << " ms, quantizing " << stages.quantizing * 1e3
+         << " ms, classifying " << stages.classifying * 1e3 << " ms)" << endl;
+#endif
+
     // Testing some outputs
     cout << "Value: " << output[30]
          << ", Result: " << nn.classify(input.col(30)) << endl;
@@ -146,6 +310,13 @@ int main()
     cout << "Value: " << output[4800]
          << ", Result: " << nn.classify(input.col(4800)) << endl;
 
+#if ENABLE_RESULT_CACHE
+    cacheStats stats = nn.getModel().getResultCacheStats();
+    cout << "Result cache: " << stats.hits << " hits, " << stats.misses
+         << " misses, " << stats.evictions << " evictions, " << stats.entries
+         << " of " << stats.capacity << " entries" << endl;
+#endif
+
     // ***
     // Cleanup
     // ***
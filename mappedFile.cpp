@@ -0,0 +1,70 @@
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mappedFile.h"
+
+using namespace std;
+
+// Constructor
+mappedFile::mappedFile() : address(0), length(0) {}
+
+// Destructor
+mappedFile::~mappedFile() { close(); }
+
+bool mappedFile::open(string inFile)
+{
+    close();
+
+    int fd = ::open(inFile.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void *map = mmap(0, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+
+    if (map == MAP_FAILED)
+        return false;
+
+    address = map;
+    length = info.st_size;
+    return true;
+}
+
+void mappedFile::close()
+{
+    if (address) {
+        munmap(address, length);
+        address = 0;
+        length = 0;
+    }
+}
+
+void mappedFile::adviseSequential() const
+{
+    if (address)
+        madvise(address, length, MADV_SEQUENTIAL);
+}
+
+void mappedFile::prefetch(size_t offset, size_t size) const
+{
+    if (!address || offset >= length)
+        return;
+
+    // madvise needs a page-aligned start
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t start = offset & ~(page - 1);
+    size_t end = min(offset + size, length);
+
+    madvise((char *)address + start, end - start, MADV_WILLNEED);
+}
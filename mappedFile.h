@@ -0,0 +1,38 @@
+#ifndef MappedFile
+#define MappedFile
+
+#include <cstddef>
+#include <string>
+
+using namespace std;
+// Read-only memory mapping of a whole file. The pages are shared with every
+// other process mapping the same file.
+class mappedFile
+{
+  private:
+    void *address;
+    size_t length;
+
+  public:
+    // Constructor and Destructor
+    mappedFile();
+    ~mappedFile();
+
+    mappedFile(const mappedFile &) = delete;
+    mappedFile &operator=(const mappedFile &) = delete;
+
+    // Maps inFile, replacing any previous mapping
+    bool open(string inFile);
+    void close();
+
+    bool isOpen() const { return address != 0; }
+    const char *data() const { return (const char *)address; }
+    size_t size() const { return length; }
+
+    // Access hints - The whole file is read front to back, or the given range
+    // is needed soon
+    void adviseSequential() const;
+    void prefetch(size_t offset, size_t size) const;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#include <cstring>
+
+#include "mappedFile.h"
+#include "modelFile.h"
+
+using namespace std;
+
+uint64_t modelFileChecksum(const char *data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (uint8_t)data[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+bool readModelLayout(string inFile, modelFileLayout &layout)
+{
+    mappedFile file;
+    modelFileHeader &header = layout.header;
+
+    if (!file.open(inFile) || file.size() < sizeof(header))
+        return false;
+    memcpy(&header, file.data(), sizeof(header));
+
+    if (memcmp(header.magic, modelFileMagic, sizeof(header.magic)) != 0 ||
+        header.version != modelFileVersion ||
+        header.headerSize != sizeof(header) ||
+        header.fileSize != file.size() || header.numLayers < 1 ||
+        (file.size() - sizeof(header)) / sizeof(modelFileLayer) <
+            (uint64_t)header.numLayers)
+        return false;
+
+    layout.layers.resize(header.numLayers);
+    memcpy(layout.layers.data(), file.data() + sizeof(header),
+           header.numLayers * sizeof(modelFileLayer));
+
+    layout.sizes.assign(1, layout.layers[0].sizeIn);
+    layout.weightBits.clear();
+    for (const modelFileLayer &layer : layout.layers) {
+        layout.sizes.push_back(layer.sizeOut);
+        layout.weightBits.push_back(layer.weightBits);
+    }
+
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef ModelFile
+#define ModelFile
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Binary model file layout, version 4. The header is followed by one
+// modelFileLayer per layer, then by the weight matrices of the layers
+// (column-major, in the model's storage type), their output scales (int32_t
+// multipliers, if any) and the activation table (int32_t entries), each block
+// starting on a 64-byte boundary so a mapped file can be used in place.
+const char modelFileMagic[8] = {'I', 'N', 'T', 'N', 'N', 'M', 'D', 'L'};
+const uint32_t modelFileVersion = 4;
+const size_t modelFileAlignment = 64;
+
+struct modelFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+
+    int32_t numLayers;
+
+    // Neuron bit depth and the integer scale derived from it
+    int32_t neuronBits, maxNeuron;
+
+    // Storage types, in bytes
+    uint8_t neuronBytes, weightBytes, accumulatorBytes, tableBytes;
+
+    // Largest absolute floating-point weight the weights were scaled by, 0 if
+    // unknown
+    double weightScale;
+
+    // Offset of the activation table from the start of the file, and its size
+    uint64_t activationOffset, activationEntries;
+    uint64_t fileSize;
+
+    // FNV-1a hash of everything after the header
+    uint64_t checksum;
+};
+
+struct modelFileLayer {
+    // Layer sizes, not counting the bias neuron of the input
+    int32_t sizeIn, sizeOut;
+
+    // Weight bit depth, the integer scale derived from it, and the
+    // requantization shift of the accumulators
+    int32_t weightBits, maxWeight, shift;
+
+    // Fraction bits of the output scales, 0 if the layer has none
+    int32_t scaleBits;
+
+    // Bits every partial sum of the layer's products fits in, from range
+    // analysis (see rangeAnalysis.h), 0 if not analyzed
+    int32_t accumulatorBits;
+
+    // Offsets of the weights and output scales from the start of the file,
+    // and the size of the weights
+    uint64_t weightsOffset, weightsBytes;
+    uint64_t scalesOffset;
+};
+
+// Rounds offset up to the block alignment
+inline uint64_t alignModelOffset(uint64_t offset)
+{
+    return (offset + modelFileAlignment - 1) &
+           ~(uint64_t)(modelFileAlignment - 1);
+}
+
+// 64-bit FNV-1a hash
+uint64_t modelFileChecksum(const char *data, size_t size);
+
+// Layout of a binary model file - Its header and layer table, and the layer
+// sizes (input first) and weight bit depths of the model it holds, to
+// construct a matching model before loading it
+struct modelFileLayout {
+    modelFileHeader header;
+    vector<modelFileLayer> layers;
+    vector<int> sizes, weightBits;
+};
+
+// Reads the layout of inFile, checking its magic, version and sizes. The
+// rest of the file is checked by loadModel.
+bool readModelLayout(string inFile, modelFileLayout &layout);
+
+#endif
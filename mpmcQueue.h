@@ -0,0 +1,110 @@
+#ifndef MpmcQueue
+#define MpmcQueue
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+using namespace std;
+
+// Bounded lock-free queue for any number of producers and consumers (after
+// D. Vyukov's bounded MPMC queue). Each cell carries a sequence number that
+// tells producers and consumers whose turn it is, so a push or pop is one
+// compare-and-swap on the shared position plus a store to the cell. Both
+// fail instead of blocking when the queue is full or empty.
+template <typename T> class mpmcQueue
+{
+  private:
+    struct cell {
+        atomic<size_t> sequence;
+        T value;
+    };
+
+    // Positions are kept on their own cache lines, apart from each other and
+    // from the cells
+    char pad0[64];
+    unique_ptr<cell[]> cells;
+    size_t mask;
+    char pad1[64];
+    atomic<size_t> pushPosition;
+    char pad2[64];
+    atomic<size_t> popPosition;
+    char pad3[64];
+
+  public:
+    // Constructor - capacity is rounded up to a power of two
+    explicit mpmcQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+
+        cells.reset(new cell[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; i++)
+            cells[i].sequence.store(i, memory_order_relaxed);
+
+        pushPosition.store(0, memory_order_relaxed);
+        popPosition.store(0, memory_order_relaxed);
+    }
+
+    mpmcQueue(const mpmcQueue &) = delete;
+    mpmcQueue &operator=(const mpmcQueue &) = delete;
+
+    size_t getCapacity() const { return mask + 1; }
+
+    bool tryPush(const T &value)
+    {
+        size_t position = pushPosition.load(memory_order_relaxed);
+        cell *c;
+
+        for (;;) {
+            c = &cells[position & mask];
+            size_t sequence = c->sequence.load(memory_order_acquire);
+            intptr_t turn = (intptr_t)sequence - (intptr_t)position;
+
+            if (turn == 0) {
+                if (pushPosition.compare_exchange_weak(
+                        position, position + 1, memory_order_relaxed))
+                    break;
+            } else if (turn < 0) {
+                return false; // Full
+            } else {
+                position = pushPosition.load(memory_order_relaxed);
+            }
+        }
+
+        c->value = value;
+        c->sequence.store(position + 1, memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T &value)
+    {
+        size_t position = popPosition.load(memory_order_relaxed);
+        cell *c;
+
+        for (;;) {
+            c = &cells[position & mask];
+            size_t sequence = c->sequence.load(memory_order_acquire);
+            intptr_t turn = (intptr_t)sequence - (intptr_t)(position + 1);
+
+            if (turn == 0) {
+                if (popPosition.compare_exchange_weak(
+                        position, position + 1, memory_order_relaxed))
+                    break;
+            } else if (turn < 0) {
+                return false; // Empty
+            } else {
+                position = popPosition.load(memory_order_relaxed);
+            }
+        }
+
+        value = c->value;
+        c->sequence.store(position + mask + 1, memory_order_release);
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include <algorithm>
+
+#include "parallelEvaluator.h"
+
+using namespace std;
+
+// Constructor
+template <typename NeuronT, typename WeightT, typename AccT>
+parallelEvaluator<NeuronT, WeightT, AccT>::parallelEvaluator(
+    const modelType &sharedModel, int numThreads, int chunk)
+    : chunkSize(chunk < 1 ? 1 : chunk), pool(numThreads), model(sharedModel),
+      contexts(pool.getNumThreads(),
+               InferenceContext<NeuronT, WeightT, AccT>(sharedModel)),
+      workerResults(pool.getNumThreads(), vector<int>(chunkSize)),
+      workerCounts(pool.getNumThreads())
+{
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+int parallelEvaluator<NeuronT, WeightT, AccT>::countCorrect(
+    const Eigen::Ref<const neuronMatrix> &input,
+    const Eigen::Ref<const Eigen::VectorXi> &labels)
+{
+    int numData = input.cols();
+    int numChunks = (numData + chunkSize - 1) / chunkSize;
+
+    for (int t = 0; t < pool.getNumThreads(); t++)
+        workerCounts[t].correct = 0;
+
+    pool.run(numChunks, [&](int worker, int task) {
+        int first = task * chunkSize;
+        int count = min(chunkSize, numData - first);
+
+        int *results = workerResults[worker].data();
+        model.classifyBatch(contexts[worker], input.middleCols(first, count),
+                            results);
+
+        int correct = 0;
+        for (int s = 0; s < count; s++) {
+            if (results[s] == labels(first + s))
+                correct++;
+        }
+        workerCounts[worker].correct += correct;
+    });
+
+    // Reduce the thread-local counts
+    int correct = 0;
+    for (int t = 0; t < pool.getNumThreads(); t++)
+        correct += workerCounts[t].correct;
+
+    return correct;
+}
+
+INSTANTIATE_INTEGER_NET(parallelEvaluator)
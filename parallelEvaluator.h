@@ -0,0 +1,52 @@
+#ifndef ParallelEvaluator
+#define ParallelEvaluator
+
+#include <vector>
+
+#include "ext/eigen-library/Eigen/Core"
+#include "inferenceContext.h"
+#include "integerModel.h"
+#include "integerTypes.h"
+#include "workStealingPool.h"
+
+using namespace std;
+template <typename NeuronT, typename WeightT, typename AccT>
+class parallelEvaluator
+{
+  public:
+    typedef IntegerModel<NeuronT, WeightT, AccT> modelType;
+    typedef typename modelType::neuronMatrix neuronMatrix;
+
+  private:
+    // Number of samples handed out as one task
+    int chunkSize;
+
+    workStealingPool pool;
+
+    // Shared by all workers, which only read it
+    const modelType &model;
+
+    // Worker state - Each worker classifies with its own context
+    vector<InferenceContext<NeuronT, WeightT, AccT>> contexts;
+    vector<vector<int>> workerResults;
+
+    // Per-worker correct counts, padded so workers never share a cache line
+    struct workerCount {
+        int correct;
+        char padding[64 - sizeof(int)];
+    };
+    vector<workerCount> workerCounts;
+
+  public:
+    // Constructor - The model is not copied, it must outlive the evaluator
+    // and not be modified while evaluating
+    parallelEvaluator(const modelType &sharedModel, int numThreads,
+                      int chunk = 256);
+
+    // Evaluation - Number of samples (columns of input) classified as their
+    // label
+    int countCorrect(const Eigen::Ref<const neuronMatrix> &input,
+                     const Eigen::Ref<const Eigen::VectorXi> &labels);
+};
+
+#endif
@@ -0,0 +1,157 @@
+#include <chrono>
+#include <thread>
+
+#include "fpConversion.h"
+#include "mappedFile.h"
+#include "pipelinedEvaluator.h"
+
+using namespace std;
+
+typedef chrono::steady_clock pipelineClock;
+
+static double secondsSince(pipelineClock::time_point start)
+{
+    return chrono::duration<double>(pipelineClock::now() - start).count();
+}
+
+// Waits for a block from the previous stage, yielding to it first then
+// sleeping, so a stage that has fallen behind leaves the core to the others
+static int waitPop(mpmcQueue<int> &queue)
+{
+    int block;
+
+    for (int spins = 0; !queue.tryPop(block); spins++) {
+        if (spins < 64)
+            this_thread::yield();
+        else
+            this_thread::sleep_for(chrono::microseconds(50));
+    }
+
+    return block;
+}
+
+// Queues have room for every block, so pushes never fail
+static void push(mpmcQueue<int> &queue, int block) { queue.tryPush(block); }
+
+// Constructor
+template <typename NeuronT, typename WeightT, typename AccT>
+pipelinedEvaluator<NeuronT, WeightT, AccT>::pipelinedEvaluator(
+    const modelType &sharedModel, double scale, int size, int numBlocks)
+    : model(sharedModel), inputScale(scale), blockSize(size < 1 ? 1 : size),
+      context(sharedModel), blocks(numBlocks < 2 ? 2 : numBlocks),
+      freeBlocks(blocks.size()), parsedBlocks(blocks.size()),
+      quantizedBlocks(blocks.size()), stats()
+{
+    for (size_t b = 0; b < blocks.size(); b++) {
+        blocks[b].values.resize((size_t)blockSize * model.getSizeInput());
+        blocks[b].samples.resize(model.getSizeInput(), blockSize);
+        blocks[b].count = 0;
+    }
+}
+
+// Reader - Parses the file a block at a time, the last block has fewer than
+// blockSize samples (possibly none)
+template <typename NeuronT, typename WeightT, typename AccT>
+void pipelinedEvaluator<NeuronT, WeightT, AccT>::parseStage(const char *data,
+                                                            const char *end)
+{
+    size_t sizeInput = model.getSizeInput();
+    int count;
+
+    do {
+        int b = waitPop(freeBlocks);
+        pipelineClock::time_point start = pipelineClock::now();
+
+        sampleBlock &block = blocks[b];
+        size_t parsed = parseFPValues(data, end, block.values.data(),
+                                      block.values.size());
+
+        count = block.count = parsed / sizeInput;
+        stats.parsing += secondsSince(start);
+        push(parsedBlocks, b);
+    } while (count == blockSize);
+}
+
+// Quantizer - Scales inputs as convertFPInputs does, against inputScale
+template <typename NeuronT, typename WeightT, typename AccT>
+void pipelinedEvaluator<NeuronT, WeightT, AccT>::quantizeStage()
+{
+    double maxNeuron = model.getMaxNeuron();
+    int count;
+
+    do {
+        int b = waitPop(parsedBlocks);
+        pipelineClock::time_point start = pipelineClock::now();
+
+        sampleBlock &block = blocks[b];
+        size_t size = (size_t)block.count * model.getSizeInput();
+        const double *values = block.values.data();
+        NeuronT *samples = block.samples.data();
+
+        for (size_t i = 0; i < size; i++) {
+            int value = (int)(maxNeuron * (values[i] / inputScale));
+            samples[i] = saturateCast<NeuronT>(value);
+        }
+
+        count = block.count;
+        stats.quantizing += secondsSince(start);
+        push(quantizedBlocks, b);
+    } while (count == blockSize);
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+bool pipelinedEvaluator<NeuronT, WeightT, AccT>::classifyFile(
+    string inFile, vector<int> &results)
+{
+    mappedFile file;
+
+    if (!file.open(inFile))
+        return false;
+    file.adviseSequential();
+
+    pipelineClock::time_point start = pipelineClock::now();
+    int count;
+
+    stats = pipelineStats();
+    for (size_t b = 0; b < blocks.size(); b++)
+        push(freeBlocks, b);
+
+    const char *data = file.data();
+    thread reader([&]() { parseStage(data, data + file.size()); });
+    thread quantizer([&]() { quantizeStage(); });
+
+    // Classifier - Runs on the calling thread
+    do {
+        int b = waitPop(quantizedBlocks);
+        pipelineClock::time_point blockStart = pipelineClock::now();
+
+        sampleBlock &block = blocks[b];
+        size_t first = results.size();
+
+        count = block.count;
+        if (count > 0) {
+            results.resize(first + count);
+            model.classifyBatch(context, block.samples.leftCols(count),
+                                &results[first], blockSize);
+
+            stats.classifying += secondsSince(blockStart);
+            if (stats.blocks++ == 0)
+                stats.firstResult = secondsSince(start);
+            stats.samples += count;
+        }
+        push(freeBlocks, b);
+    } while (count == blockSize);
+
+    reader.join();
+    quantizer.join();
+
+    // Blocks not handed out again are left in the free queue
+    int b;
+    while (freeBlocks.tryPop(b))
+        ;
+
+    stats.total = secondsSince(start);
+    return true;
+}
+
+INSTANTIATE_INTEGER_NET(pipelinedEvaluator)
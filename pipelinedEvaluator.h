@@ -0,0 +1,85 @@
+#ifndef PipelinedEvaluator
+#define PipelinedEvaluator
+
+#include <string>
+#include <vector>
+
+#include "ext/eigen-library/Eigen/Core"
+#include "inferenceContext.h"
+#include "integerModel.h"
+#include "integerTypes.h"
+#include "mpmcQueue.h"
+
+using namespace std;
+
+// Time spent in each stage of a pipelined run, in seconds
+struct pipelineStats {
+    long samples;
+    int blocks;
+
+    // From the start of the run to the first block classified, and to the end
+    double firstResult, total;
+
+    // Busy time of each stage, not counting waits for the others
+    double parsing, quantizing, classifying;
+};
+
+// Classifies the samples of a floating-point input file (as read by
+// convertFPInputs) while it is being read. A reader thread parses blocks of
+// samples, a quantizer thread scales them to the neuron bit depth and the
+// calling thread classifies them, so the three overlap and results start
+// coming after the first block rather than the whole file. Blocks are
+// recycled through bounded queues, which bound the memory in use.
+//
+// Samples are quantized against inputScale, the largest absolute input the
+// network was calibrated for, where convertFPInputs uses the largest one in
+// the file (which is only known once the whole file is read) unless given
+// the same scale, with which both give the same samples.
+template <typename NeuronT, typename WeightT, typename AccT>
+class pipelinedEvaluator
+{
+  public:
+    typedef IntegerModel<NeuronT, WeightT, AccT> modelType;
+    typedef typename modelType::neuronMatrix neuronMatrix;
+
+  private:
+    // Shared with other threads, which only read it
+    const modelType &model;
+    double inputScale;
+    int blockSize;
+
+    InferenceContext<NeuronT, WeightT, AccT> context;
+
+    // Blocks in flight - The values parsed from the file and their samples.
+    // A block goes from the free queue to the reader, the quantizer and the
+    // classifier in turn, then back to the free queue. A block of no samples
+    // ends the file.
+    struct sampleBlock {
+        vector<double> values;
+        neuronMatrix samples;
+        int count;
+    };
+    vector<sampleBlock> blocks;
+    mpmcQueue<int> freeBlocks, parsedBlocks, quantizedBlocks;
+
+    pipelineStats stats;
+
+    void parseStage(const char *data, const char *end);
+    void quantizeStage();
+
+  public:
+    // Constructor - The model is not copied, it must outlive the evaluator
+    // and not be modified while evaluating. blockSize samples are handed from
+    // stage to stage at once, up to numBlocks blocks at a time.
+    pipelinedEvaluator(const modelType &sharedModel, double inputScale,
+                       int blockSize = 64, int numBlocks = 8);
+
+    // Evaluation - Classifies every complete sample of inFile, appending the
+    // results to results in file order. Returns false if it can't be read.
+    bool classifyFile(string inFile, vector<int> &results);
+
+    // Stages of the last run
+    const pipelineStats &getStats() const { return stats; }
+};
+
+#endif
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <limits>
+
+#include "rangeAnalysis.h"
+
+using namespace std;
+
+// Bounds are summed in 128 bits and clamped to 64 when stored, ranges too
+// wide for int64_t then need all 64 bits
+typedef __int128 wideInt;
+
+static int64_t clampWide(wideInt value)
+{
+    if (value > (wideInt)numeric_limits<int64_t>::max())
+        return numeric_limits<int64_t>::max();
+    if (value < (wideInt)numeric_limits<int64_t>::min())
+        return numeric_limits<int64_t>::min();
+    return (int64_t)value;
+}
+
+static void extend(valueRange &range, int64_t value)
+{
+    range.low = min(range.low, value);
+    range.high = max(range.high, value);
+}
+
+static valueRange emptyRange()
+{
+    valueRange range = {numeric_limits<int64_t>::max(),
+                        numeric_limits<int64_t>::min()};
+    return range;
+}
+
+int rangeBits(const valueRange &range)
+{
+    int bits = 1;
+
+    if (range.low > range.high)
+        return bits;
+
+    while (bits < 64 && (range.low < -((int64_t)1 << (bits - 1)) ||
+                         range.high > ((int64_t)1 << (bits - 1)) - 1))
+        bits++;
+
+    return bits;
+}
+
+int accumulatorBytes(int bits)
+{
+    return bits <= 16 ? 2 : bits <= 32 ? 4 : 8;
+}
+
+// Constructor
+template <typename NeuronT, typename WeightT, typename AccT>
+rangeAnalyzer<NeuronT, WeightT, AccT>::rangeAnalyzer(const modelType &m,
+                                                     int64_t inputLow,
+                                                     int64_t inputHigh)
+    : model(m), layers(m.getNumLayers()), samples(0), context(m)
+{
+    int numLayers = model.getNumLayers();
+    int64_t bias = model.getBiasNeuron();
+
+    // Input ranges of the layer being analyzed, the bias neuron last
+    vector<valueRange> inputs(model.getSizeInput() + 1);
+
+    for (int i = 0; i < model.getSizeInput(); i++)
+        inputs[i] = valueRange{inputLow, inputHigh};
+
+    for (int l = 0; l < numLayers; l++) {
+        layerRanges &layer = layers[l];
+        typename modelType::weightMap weights = model.getWeights(l);
+
+        inputs.back() = valueRange{bias, bias};
+        layer.sums.resize(weights.cols());
+        layer.seenSums.assign(weights.cols(), emptyRange());
+        layer.partialSums = emptyRange();
+
+        for (int j = 0; j < weights.cols(); j++) {
+            wideInt low = 0, high = 0, negative = 0, positive = 0;
+
+            for (int i = 0; i < weights.rows(); i++) {
+                wideInt w = weights(i, j);
+                wideInt a = w * inputs[i].low, b = w * inputs[i].high;
+                wideInt productLow = min(a, b), productHigh = max(a, b);
+
+                low += productLow;
+                high += productHigh;
+                negative += min(productLow, (wideInt)0);
+                positive += max(productHigh, (wideInt)0);
+            }
+
+            layer.sums[j] = valueRange{clampWide(low), clampWide(high)};
+            extend(layer.partialSums, clampWide(negative));
+            extend(layer.partialSums, clampWide(positive));
+        }
+
+        // Activations of this layer are the inputs of the next
+        if (l + 1 < numLayers) {
+            inputs.resize(weights.cols() + 1);
+            for (int j = 0; j < weights.cols(); j++)
+                inputs[j] = activationRange(l, j);
+        }
+    }
+}
+
+// As IntegerModel::rescale, in wider arithmetic
+template <typename NeuronT, typename WeightT, typename AccT>
+int64_t rangeAnalyzer<NeuronT, WeightT, AccT>::rescale(int l, int64_t sum,
+                                                       int j) const
+{
+    const vector<int32_t> &scales = model.getScales(l);
+    int shift = model.getShift(l);
+
+    if (scales.empty()) {
+        if (shift == 0)
+            return sum;
+        return clampWide(((wideInt)sum + ((wideInt)1 << (shift - 1))) >>
+                         shift);
+    }
+
+    int bits = model.getScaleBits(l) + shift;
+    wideInt product = (wideInt)sum * scales[j];
+
+    return clampWide((product + ((wideInt)1 << (bits - 1))) >> bits);
+}
+
+// Activations of output neuron j of layer l over its worst-case sums. The
+// rescaling is monotonic (multipliers are positive), so its image is the
+// range between the rescaled ends; indices beyond the table saturate.
+template <typename NeuronT, typename WeightT, typename AccT>
+valueRange rangeAnalyzer<NeuronT, WeightT, AccT>::activationRange(int l,
+                                                                  int j) const
+{
+    const valueRange &sums = layers[l].sums[j];
+    int64_t limit = 5 * (int64_t)model.getMaxNeuron();
+    int64_t low = rescale(l, sums.low, j), high = rescale(l, sums.high, j);
+    valueRange range = emptyRange();
+
+    if (low <= -limit)
+        extend(range, model.activationFunction((AccT)-limit));
+    if (high >= limit)
+        extend(range, model.activationFunction((AccT)limit));
+
+    for (int64_t k = max(low, -limit + 1); k <= min(high, limit - 1); k++)
+        extend(range, model.activationFunction((AccT)k));
+
+    return range;
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void rangeAnalyzer<NeuronT, WeightT, AccT>::calibrate(
+    const Eigen::Ref<const neuronMatrix> &in)
+{
+    // classifyBatch always computes its samples (the result cache only
+    // serves classify) and leaves the neurons of its last block in the
+    // context, so blocks of one batch at a time are read back from there
+    const int blockSize = 64;
+    int numLayers = model.getNumLayers();
+
+    results.resize(blockSize);
+
+    for (int first = 0; first < in.cols(); first += blockSize) {
+        int count = min(blockSize, (int)in.cols() - first);
+
+        model.classifyBatch(context, in.middleCols(first, count),
+                            results.data(), count);
+
+        for (int l = 0; l < numLayers; l++) {
+            typename modelType::weightMap weights = model.getWeights(l);
+            const neuronMatrix &neurons = context.batchNeurons[l];
+            layerRanges &layer = layers[l];
+
+            for (int s = 0; s < count; s++) {
+                for (int j = 0; j < weights.cols(); j++) {
+                    int64_t sum = 0;
+
+                    for (int i = 0; i < weights.rows(); i++)
+                        sum += (int64_t)weights(i, j) * neurons(i, s);
+                    extend(layer.seenSums[j], sum);
+                }
+            }
+        }
+    }
+
+    samples += in.cols();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+int rangeAnalyzer<NeuronT, WeightT, AccT>::getWorstBits(int l) const
+{
+    return rangeBits(layers[l].partialSums);
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+int rangeAnalyzer<NeuronT, WeightT, AccT>::getSeenBits(int l) const
+{
+    valueRange range = emptyRange();
+
+    for (const valueRange &sums : layers[l].seenSums) {
+        if (sums.low <= sums.high) {
+            extend(range, sums.low);
+            extend(range, sums.high);
+        }
+    }
+
+    return rangeBits(range);
+}
+
+INSTANTIATE_INTEGER_NET(rangeAnalyzer)
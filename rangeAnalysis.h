@@ -0,0 +1,86 @@
+#ifndef RangeAnalysis
+#define RangeAnalysis
+
+#include <cstdint>
+#include <vector>
+
+#include "ext/eigen-library/Eigen/Core"
+#include "inferenceContext.h"
+#include "integerModel.h"
+
+using namespace std;
+
+// Range of integer values, empty while low > high
+struct valueRange {
+    int64_t low, high;
+};
+
+// Bits of the narrowest two's complement type holding every value of a
+// range, 1 for empty ranges
+int rangeBits(const valueRange &range);
+
+// Narrowest accumulator storage for values of the given bits, in bytes (2, 4
+// or 8)
+int accumulatorBytes(int bits);
+
+// Accumulator ranges of a model's layers, to pick the narrowest accumulators
+// that can not overflow.
+//
+// Worst case - Interval arithmetic from the range of the first-layer inputs.
+// Each product lies between its weight times either end of its input's range,
+// so each final sum lies between the sums of those bounds, and each partial
+// sum (any subset of the products: any summation order or split into lanes)
+// between the sum of the negative lower bounds and that of the positive upper
+// ones. The inputs of the next layers range over the activations of the
+// previous layer's rescaled sums, the bias neuron is exact.
+//
+// Empirical - Final sums seen over calibration samples, how much of the worst
+// case real data uses. They prove nothing about other samples.
+template <typename NeuronT, typename WeightT, typename AccT>
+class rangeAnalyzer
+{
+  public:
+    typedef IntegerModel<NeuronT, WeightT, AccT> modelType;
+    typedef typename modelType::neuronMatrix neuronMatrix;
+
+    struct layerRanges {
+        // Worst case - Final sums of each output neuron, and every partial
+        // sum of the layer
+        vector<valueRange> sums;
+        valueRange partialSums;
+
+        // Final sums of each output neuron over the calibration samples
+        vector<valueRange> seenSums;
+    };
+
+  private:
+    // Not copied, it must outlive the analyzer
+    const modelType &model;
+
+    vector<layerRanges> layers;
+    int64_t samples;
+
+    // Scratch of calibrate
+    InferenceContext<NeuronT, WeightT, AccT> context;
+    vector<int> results;
+
+    int64_t rescale(int l, int64_t sum, int j) const;
+    valueRange activationRange(int l, int j) const;
+
+  public:
+    // Constructor - Computes the worst cases for first-layer inputs within
+    // [inputLow, inputHigh]
+    rangeAnalyzer(const modelType &model, int64_t inputLow, int64_t inputHigh);
+
+    // Adds samples (one per column) to the empirical ranges
+    void calibrate(const Eigen::Ref<const neuronMatrix> &samples);
+    int64_t getSamples() const { return samples; }
+
+    const layerRanges &getLayer(int l) const { return layers[l]; }
+
+    // Bits of the layer's worst-case partial sums, and of the final sums seen
+    int getWorstBits(int l) const;
+    int getSeenBits(int l) const;
+};
+
+#endif
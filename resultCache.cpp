@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "resultCache.h"
+
+using namespace std;
+
+// Constructor
+template <typename NeuronT>
+resultCache<NeuronT>::resultCache(int sizeIn, int sizeOut, size_t capacity,
+                                  int numShards, cacheEviction evict,
+                                  bool outputs)
+    : sizeInput(sizeIn), sizeOutput(sizeOut), eviction(evict),
+      keepOutputs(outputs)
+{
+    assert(sizeIn > 0 && sizeOut > 0 && capacity > 0 && numShards > 0);
+
+    numShards = (int)min((size_t)numShards, capacity);
+    shardCapacity = (int)((capacity + numShards - 1) / numShards);
+
+    // Buckets - A power of two, at least twice the entries
+    size_t numBuckets = 1;
+    while (numBuckets < 2 * (size_t)shardCapacity)
+        numBuckets *= 2;
+
+    for (int i = 0; i < numShards; i++) {
+        cacheShard *s = new cacheShard;
+
+        s->keys.resize(shardCapacity);
+        s->samples.resize((size_t)shardCapacity * sizeInput);
+        s->results.resize(shardCapacity);
+        if (keepOutputs)
+            s->outputs.resize((size_t)shardCapacity * sizeOutput);
+        s->buckets.resize(numBuckets);
+        s->nextInBucket.resize(shardCapacity);
+        s->newer.resize(shardCapacity);
+        s->older.resize(shardCapacity);
+
+        clearShard(*s);
+        s->hits = s->misses = s->insertions = s->evictions = 0;
+
+        shards.push_back(unique_ptr<cacheShard>(s));
+    }
+}
+
+// Four independent multiply-xorshift lanes over 8-byte words, so the
+// multiplications overlap, then a final mix of the lanes
+template <typename NeuronT>
+uint64_t resultCache<NeuronT>::hash(const NeuronT *in) const
+{
+    const uint64_t m = 0xff51afd7ed558ccdull;
+    const unsigned char *bytes = (const unsigned char *)in;
+    size_t size = (size_t)sizeInput * sizeof(NeuronT);
+    uint64_t lanes[4] = {0x9e3779b97f4a7c15ull, 0xc2b2ae3d27d4eb4full,
+                         0x165667b19e3779f9ull, 0x27d4eb2f165667c5ull};
+    size_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        for (int k = 0; k < 4; k++) {
+            uint64_t w;
+            memcpy(&w, bytes + i + 8 * k, 8);
+            lanes[k] = (lanes[k] ^ w) * m;
+            lanes[k] ^= lanes[k] >> 32;
+        }
+    }
+    for (int k = 0; i < size; i += 8, k++) {
+        uint64_t w = 0;
+        memcpy(&w, bytes + i, min((size_t)8, size - i));
+        lanes[k] = (lanes[k] ^ w) * m;
+        lanes[k] ^= lanes[k] >> 32;
+    }
+
+    uint64_t h = size;
+    for (int k = 0; k < 4; k++) {
+        h = (h ^ lanes[k]) * 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+    }
+
+    return h;
+}
+
+// Shards are picked with the high bits of the key, buckets with the low ones
+template <typename NeuronT>
+typename resultCache<NeuronT>::cacheShard &
+resultCache<NeuronT>::shardOf(uint64_t key) const
+{
+    return *shards[(key >> 32) % shards.size()];
+}
+
+template <typename NeuronT>
+int32_t resultCache<NeuronT>::findEntry(const cacheShard &s, uint64_t key,
+                                        const NeuronT *in) const
+{
+    int32_t e = s.buckets[key & (s.buckets.size() - 1)];
+
+    for (; e >= 0; e = s.nextInBucket[e]) {
+        if (s.keys[e] == key &&
+            equal(in, in + sizeInput, &s.samples[(size_t)e * sizeInput]))
+            break;
+    }
+
+    return e;
+}
+
+template <typename NeuronT>
+void resultCache<NeuronT>::unlinkEntry(cacheShard &s, int32_t e) const
+{
+    if (s.newer[e] >= 0)
+        s.older[s.newer[e]] = s.older[e];
+    else
+        s.newest = s.older[e];
+
+    if (s.older[e] >= 0)
+        s.newer[s.older[e]] = s.newer[e];
+    else
+        s.oldest = s.newer[e];
+}
+
+template <typename NeuronT>
+void resultCache<NeuronT>::pushNewest(cacheShard &s, int32_t e) const
+{
+    s.newer[e] = -1;
+    s.older[e] = s.newest;
+
+    if (s.newest >= 0)
+        s.newer[s.newest] = e;
+    else
+        s.oldest = e;
+    s.newest = e;
+}
+
+template <typename NeuronT>
+void resultCache<NeuronT>::clearShard(cacheShard &s) const
+{
+    fill(s.buckets.begin(), s.buckets.end(), -1);
+    s.newest = s.oldest = -1;
+    s.used = 0;
+}
+
+template <typename NeuronT>
+bool resultCache<NeuronT>::find(uint64_t key, const NeuronT *in, int &result,
+                                NeuronT *outputs)
+{
+    cacheShard &s = shardOf(key);
+    lock_guard<mutex> guard(s.lock);
+    int32_t e = findEntry(s, key, in);
+
+    if (e < 0) {
+        s.misses++;
+        return false;
+    }
+
+    s.hits++;
+    if (eviction == evictLRU && s.newest != e) {
+        unlinkEntry(s, e);
+        pushNewest(s, e);
+    }
+
+    result = s.results[e];
+    if (keepOutputs && outputs) {
+        const NeuronT *stored = &s.outputs[(size_t)e * sizeOutput];
+        copy(stored, stored + sizeOutput, outputs);
+    }
+
+    return true;
+}
+
+template <typename NeuronT>
+void resultCache<NeuronT>::insert(uint64_t key, const NeuronT *in, int result,
+                                  const NeuronT *outputs)
+{
+    cacheShard &s = shardOf(key);
+    lock_guard<mutex> guard(s.lock);
+    size_t bucket = key & (s.buckets.size() - 1);
+
+    // Another thread may have added the same sample since it missed
+    int32_t e = findEntry(s, key, in);
+
+    if (e < 0) {
+        if (s.used < shardCapacity) {
+            e = s.used++;
+        } else {
+            // Reuse the oldest entry, removed from its hash chain first
+            e = s.oldest;
+            unlinkEntry(s, e);
+
+            int32_t *link = &s.buckets[s.keys[e] & (s.buckets.size() - 1)];
+            while (*link != e)
+                link = &s.nextInBucket[*link];
+            *link = s.nextInBucket[e];
+
+            s.evictions++;
+        }
+
+        s.keys[e] = key;
+        copy(in, in + sizeInput, &s.samples[(size_t)e * sizeInput]);
+        s.nextInBucket[e] = s.buckets[bucket];
+        s.buckets[bucket] = e;
+        pushNewest(s, e);
+        s.insertions++;
+    }
+
+    s.results[e] = result;
+    if (keepOutputs && outputs)
+        copy(outputs, outputs + sizeOutput,
+             &s.outputs[(size_t)e * sizeOutput]);
+}
+
+template <typename NeuronT> void resultCache<NeuronT>::clear()
+{
+    for (size_t i = 0; i < shards.size(); i++) {
+        lock_guard<mutex> guard(shards[i]->lock);
+        clearShard(*shards[i]);
+    }
+}
+
+template <typename NeuronT> void resultCache<NeuronT>::resetStats()
+{
+    for (size_t i = 0; i < shards.size(); i++) {
+        cacheShard &s = *shards[i];
+        lock_guard<mutex> guard(s.lock);
+
+        s.hits = s.misses = s.insertions = s.evictions = 0;
+    }
+}
+
+template <typename NeuronT> cacheStats resultCache<NeuronT>::getStats() const
+{
+    cacheStats stats = {0, 0, 0, 0, 0, getCapacity()};
+
+    for (size_t i = 0; i < shards.size(); i++) {
+        cacheShard &s = *shards[i];
+        lock_guard<mutex> guard(s.lock);
+
+        stats.hits += s.hits;
+        stats.misses += s.misses;
+        stats.insertions += s.insertions;
+        stats.evictions += s.evictions;
+        stats.entries += s.used;
+    }
+
+    return stats;
+}
+
+template class resultCache<int8_t>;
+template class resultCache<int16_t>;
+template class resultCache<int32_t>;
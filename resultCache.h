@@ -0,0 +1,108 @@
+#ifndef ResultCache
+#define ResultCache
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+// Entry evicted from a full shard of a resultCache
+enum cacheEviction {
+    evictLRU, // Least recently used entry
+    evictFIFO // Oldest entry, hits do not keep entries longer
+};
+
+// Counters of a resultCache, summed over its shards. Counters survive clear,
+// entries do not.
+struct cacheStats {
+    uint64_t hits, misses, insertions, evictions;
+    size_t entries, capacity;
+};
+
+// Bounded, thread-safe map from samples to their class, and optionally their
+// output neurons. Samples are keyed by a hash of their values and compared in
+// full on lookup, so hash collisions never return another sample's result.
+//
+// Entries are split between shards by hash, each with its own lock, so
+// threads rarely contend. A shard chains its entries per hash bucket and
+// links them in eviction order by index into storage sized at construction:
+// nothing is allocated after it.
+template <typename NeuronT> class resultCache
+{
+  private:
+    struct cacheShard {
+        mutex lock;
+
+        // Entries - Key, sample (sizeInput each), class and output neurons
+        // (sizeOutput each, only when kept)
+        vector<uint64_t> keys;
+        vector<NeuronT> samples;
+        vector<int32_t> results;
+        vector<NeuronT> outputs;
+
+        // Hash chains - First entry of each bucket and next entry of each
+        // entry, -1 ends them
+        vector<int32_t> buckets;
+        vector<int32_t> nextInBucket;
+
+        // Eviction order, from the newest to the oldest entry
+        vector<int32_t> newer, older;
+        int32_t newest, oldest;
+        int32_t used;
+
+        uint64_t hits, misses, insertions, evictions;
+    };
+
+    int sizeInput, sizeOutput;
+    int shardCapacity;
+    cacheEviction eviction;
+    bool keepOutputs;
+    vector<unique_ptr<cacheShard>> shards;
+
+    // Functions - Private member functions, called with the shard locked
+    cacheShard &shardOf(uint64_t key) const;
+    int32_t findEntry(const cacheShard &s, uint64_t key,
+                      const NeuronT *in) const;
+    void unlinkEntry(cacheShard &s, int32_t e) const;
+    void pushNewest(cacheShard &s, int32_t e) const;
+    void clearShard(cacheShard &s) const;
+
+  public:
+    // Constructor - Room for capacity samples of sizeInput neurons, split
+    // between numShards shards
+    resultCache(int sizeInput, int sizeOutput, size_t capacity,
+                int numShards = 16, cacheEviction eviction = evictLRU,
+                bool keepOutputs = false);
+
+    resultCache(const resultCache &) = delete;
+    resultCache &operator=(const resultCache &) = delete;
+
+    int getSizeInput() const { return sizeInput; }
+    int getSizeOutput() const { return sizeOutput; }
+    size_t getCapacity() const { return (size_t)shardCapacity * shards.size(); }
+    int getNumShards() const { return shards.size(); }
+    cacheEviction getEviction() const { return eviction; }
+    bool keepsOutputs() const { return keepOutputs; }
+
+    // Key of a sample of sizeInput neurons
+    uint64_t hash(const NeuronT *in) const;
+
+    // Class of a cached sample, and its output neurons if kept and outputs is
+    // not null. Returns false, leaving them untouched, on a miss.
+    bool find(uint64_t key, const NeuronT *in, int &result,
+              NeuronT *outputs = 0);
+
+    // Adds a sample and its results, or updates them if already cached
+    void insert(uint64_t key, const NeuronT *in, int result,
+                const NeuronT *outputs = 0);
+
+    // Drops every entry, counters are kept
+    void clear();
+    void resetStats();
+    cacheStats getStats() const;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "sparseWeights.h"
+
+using namespace std;
+
+// Constructor
+template <typename WeightT>
+sparseWeights<WeightT>::sparseWeights() : rows(0), cols(0)
+{
+}
+
+template <typename WeightT> void sparseWeights<WeightT>::clear()
+{
+    rows = cols = 0;
+    vector<int32_t>().swap(columnStarts);
+    vector<int32_t>().swap(blockRows);
+    vector<WeightT>().swap(blocks);
+}
+
+// Whether rows [first, last) of a column hold a nonzero weight
+template <typename WeightT>
+static bool hasNonzero(const WeightT *column, int first, int last)
+{
+    for (int i = first; i < last; i++) {
+        if (column[i] != 0)
+            return true;
+    }
+
+    return false;
+}
+
+template <typename WeightT>
+double sparseWeights<WeightT>::blockDensity(const WeightT *weights, int rows,
+                                            int cols)
+{
+    int rowBlocks = (rows + sparseBlockRows - 1) / sparseBlockRows;
+    size_t nonzero = 0;
+
+    if (rowBlocks == 0 || cols == 0)
+        return 0.0;
+
+    for (int j = 0; j < cols; j++) {
+        const WeightT *column = weights + (size_t)j * rows;
+
+        for (int first = 0; first < rows; first += sparseBlockRows) {
+            if (hasNonzero(column, first, min(first + sparseBlockRows, rows)))
+                nonzero++;
+        }
+    }
+
+    return (double)nonzero / ((double)rowBlocks * cols);
+}
+
+template <typename WeightT> double sparseWeights<WeightT>::getDensity() const
+{
+    int rowBlocks = (rows + sparseBlockRows - 1) / sparseBlockRows;
+
+    if (!isValid() || rowBlocks == 0 || cols == 0)
+        return 0.0;
+
+    return (double)blockRows.size() / ((double)rowBlocks * cols);
+}
+
+template <typename WeightT>
+bool sparseWeights<WeightT>::build(const WeightT *weights, int numRows,
+                                   int numCols, double maxDensity)
+{
+    clear();
+
+    if (numRows < sparseBlockRows ||
+        blockDensity(weights, numRows, numCols) > maxDensity)
+        return false;
+
+    rows = numRows;
+    cols = numCols;
+    columnStarts.reserve(cols + 1);
+    columnStarts.push_back(0);
+
+    for (int j = 0; j < cols; j++) {
+        const WeightT *column = weights + (size_t)j * rows;
+
+        for (int first = 0; first < rows; first += sparseBlockRows) {
+            int last = min(first + sparseBlockRows, rows);
+
+            if (!hasNonzero(column, first, last))
+                continue;
+
+            // A short last block is moved back to end with the matrix, the
+            // rows it overlaps stay zero
+            int start = last - sparseBlockRows;
+
+            blockRows.push_back(start);
+            for (int i = start; i < last; i++)
+                blocks.push_back(i < first ? 0 : column[i]);
+        }
+
+        columnStarts.push_back(blockRows.size());
+    }
+
+    return true;
+}
+
+template class sparseWeights<int8_t>;
+template class sparseWeights<int16_t>;
+template class sparseWeights<int32_t>;
@@ -0,0 +1,62 @@
+#ifndef SparseWeights
+#define SparseWeights
+
+#include <cstdint>
+#include <vector>
+
+#include "layerKernels.h"
+
+using namespace std;
+
+// Block density under which layers use sparse weights by default. Sparse
+// products cost about twice as much per stored block as dense ones per row
+// block, see tools/sparseBench.cpp for the crossover on a given CPU.
+const double defaultSparseDensity = 0.4;
+
+// Blocked sparse copy of a column-major rows x cols weight matrix (blocked
+// CSC). Rows are cut into blocks of sparseBlockRows, and each column keeps
+// only its blocks holding a nonzero weight, zeros inside them included, so
+// every block is one SIMD multiply-add against a contiguous run of inputs.
+//
+// When rows is not a multiple of sparseBlockRows, the last block of a column
+// starts sparseBlockRows before the end instead, with the rows it shares with
+// the previous block zeroed, so blocks never read past the input.
+template <typename WeightT> class sparseWeights
+{
+  private:
+    int rows, cols;
+
+    // Blocks of column j - [columnStarts[j], columnStarts[j + 1])
+    vector<int32_t> columnStarts;
+
+    // First row and weights of each block
+    vector<int32_t> blockRows;
+    vector<WeightT> blocks;
+
+  public:
+    sparseWeights();
+
+    // Builds the blocks if at most maxDensity of the row blocks of the matrix
+    // hold a nonzero weight, clears them otherwise. Matrices of fewer than
+    // sparseBlockRows rows are never stored sparse.
+    bool build(const WeightT *weights, int rows, int cols,
+               double maxDensity = 1.0);
+    void clear();
+
+    bool isValid() const { return !columnStarts.empty(); }
+    int getRows() const { return rows; }
+    int getCols() const { return cols; }
+    size_t getNumBlocks() const { return blockRows.size(); }
+
+    // Fraction of the row blocks stored, 0 if not built
+    double getDensity() const;
+
+    const int32_t *getColumnStarts() const { return columnStarts.data(); }
+    const int32_t *getBlockRows() const { return blockRows.data(); }
+    const WeightT *getBlocks() const { return blocks.data(); }
+
+    // Fraction of the row blocks of a matrix holding a nonzero weight
+    static double blockDensity(const WeightT *weights, int rows, int cols);
+};
+
+#endif
@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "systolicSimulator.h"
+
+using namespace std;
+
+// Bytes of count values of the given bits, packed
+static int64_t packedBytes(int64_t count, int bits)
+{
+    return (count * bits + 7) / 8;
+}
+
+static int64_t ceilDiv(int64_t a, int64_t b)
+{
+    return (a + b - 1) / b;
+}
+
+// Constructor
+template <typename NeuronT, typename WeightT, typename AccT>
+systolicSimulator<NeuronT, WeightT, AccT>::systolicSimulator(
+    const modelType &m, const systolicConfig &c)
+    : model(m), config(c), weightsResident(m.getNumLayers(), false),
+      lutResident(false), setupBytes(0)
+{
+    assert(config.arrayRows > 0 && config.arrayCols > 0);
+    assert(config.neuronBits > 0 && config.neuronBits <= 32);
+    assert(config.weightBits > 0 && config.weightBits <= 32);
+    assert(config.accumulatorBits > 1 && config.accumulatorBits <= 64);
+    assert(config.activationLanes > 0 && config.dramBandwidth > 0);
+
+    // Layers take the weight SRAM in order, as long as they fit
+    for (int l = 0; l < model.getNumLayers(); l++) {
+        int64_t bytes = getWeightBytes(l);
+
+        if (setupBytes + bytes <= config.weightSram) {
+            weightsResident[l] = true;
+            setupBytes += bytes;
+        }
+    }
+
+    lutResident = getLUTBytes() <= config.lutSram;
+    if (lutResident)
+        setupBytes += getLUTBytes();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+int systolicSimulator<NeuronT, WeightT, AccT>::getPasses(int l) const
+{
+    return ceilDiv(model.getNeuronBits(), config.neuronBits) *
+           ceilDiv(model.getWeightBits(l), config.weightBits);
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+int64_t systolicSimulator<NeuronT, WeightT, AccT>::getTiles(int l) const
+{
+    return ceilDiv(model.getLayerSize(l) + 1, config.arrayRows) *
+           ceilDiv(model.getLayerSize(l + 1), config.arrayCols);
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+int64_t systolicSimulator<NeuronT, WeightT, AccT>::getWeightBytes(int l) const
+{
+    return packedBytes((int64_t)(model.getLayerSize(l) + 1) *
+                           model.getLayerSize(l + 1),
+                       model.getWeightBits(l));
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+int64_t systolicSimulator<NeuronT, WeightT, AccT>::getLUTBytes() const
+{
+    return packedBytes(10 * (int64_t)model.getMaxNeuron(),
+                       model.getNeuronBits());
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+int64_t
+systolicSimulator<NeuronT, WeightT, AccT>::transferCycles(int64_t bytes) const
+{
+    return (int64_t)ceil(bytes / config.dramBandwidth);
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void systolicSimulator<NeuronT, WeightT, AccT>::simulateLayer(
+    contextType &context, int l, int count, systolicLayerStats &stats) const
+{
+    typename modelType::weightMap weights = model.getWeights(l);
+    const neuronMatrix &in = context.batchNeurons[l];
+    neuronMatrix &out = context.batchNeurons[l + 1];
+    int rows = weights.rows(), cols = weights.cols();
+    int tileRows = config.arrayRows, tileCols = config.arrayCols;
+    bool lastLayer = l + 1 == model.getNumLayers();
+
+    // Sums - Exact, in the order the array adds them: down each tile, then
+    // from tile to tile
+    int64_t accLow = numeric_limits<int64_t>::min();
+    int64_t accHigh = numeric_limits<int64_t>::max();
+    if (config.accumulatorBits < 64) {
+        accHigh = ((int64_t)1 << (config.accumulatorBits - 1)) - 1;
+        accLow = -accHigh - 1;
+    }
+
+    for (int s = 0; s < count; s++) {
+        for (int j = 0; j < cols; j++) {
+            int64_t sum = 0;
+            bool overflow = false;
+
+            for (int i = 0; i < rows; i++) {
+                sum += (int64_t)weights(i, j) * in(i, s);
+                overflow |= sum < accLow || sum > accHigh;
+            }
+
+            stats.overflows += overflow;
+            out(j, s) = model.activateSum(l, (AccT)sum, j);
+        }
+        if (!lastLayer)
+            out(cols, s) = model.getBiasNeuron();
+    }
+
+    // Tiles - Each one's weights load while the previous one streams the
+    // block of samples, and its samples follow right behind, so only the
+    // first load and one fill and drain are exposed
+    int64_t stream = (int64_t)getPasses(l) * count;
+    int64_t cycles = 0, arrayCycles = 0, weightBytes = 0;
+    int64_t previous = 0;
+
+    for (int ti = 0; ti < rows; ti += tileRows) {
+        for (int tj = 0; tj < cols; tj += tileCols) {
+            int64_t tileBytes = packedBytes(
+                (int64_t)min(tileRows, rows - ti) * min(tileCols, cols - tj),
+                model.getWeightBits(l));
+            int64_t load = min(tileRows, rows - ti);
+
+            if (!weightsResident[l]) {
+                load = max(load, transferCycles(tileBytes));
+                weightBytes += tileBytes;
+            }
+
+            cycles += max(previous, load);
+            arrayCycles += previous;
+            previous = stream;
+        }
+    }
+    cycles += previous + tileRows + tileCols - 2;
+    arrayCycles += previous + tileRows + tileCols - 2;
+
+    // Activation - Every sum through a lane, LUT entries from DRAM unless
+    // resident
+    int64_t activations = (int64_t)cols * count;
+    int64_t activationCycles = ceilDiv(activations, config.activationLanes);
+    int64_t lutBytes = 0;
+
+    if (!lutResident) {
+        lutBytes = activations * packedBytes(1, model.getNeuronBits());
+        activationCycles = max(activationCycles, transferCycles(lutBytes));
+    }
+
+    stats.cycles += cycles + activationCycles;
+    stats.arrayCycles += arrayCycles;
+    stats.stallCycles += cycles - arrayCycles;
+    stats.activationCycles += activationCycles;
+    stats.macs += (int64_t)rows * cols * count;
+    stats.weightBytes += weightBytes;
+    stats.lutBytes += lutBytes;
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void systolicSimulator<NeuronT, WeightT, AccT>::simulateBlock(
+    contextType &context, int count, systolicStats &stats) const
+{
+    int numLayers = model.getNumLayers();
+    int64_t inputBytes = packedBytes((int64_t)model.getSizeInput() * count,
+                                     model.getNeuronBits());
+    int64_t outputBytes = packedBytes((int64_t)model.getSizeOutput() * count,
+                                      model.getNeuronBits());
+
+    stats.layers.resize(numLayers, systolicLayerStats());
+
+    // Samples come in before the first layer and outputs leave after the
+    // last one
+    stats.cycles += transferCycles(inputBytes);
+    for (int l = 0; l < numLayers; l++) {
+        systolicLayerStats &layer = stats.layers[l];
+        int64_t before = layer.cycles;
+
+        simulateLayer(context, l, count, layer);
+        stats.cycles += layer.cycles - before;
+    }
+    stats.cycles += transferCycles(outputBytes);
+
+    stats.samples += count;
+    stats.batches++;
+    stats.inputBytes += inputBytes;
+    stats.outputBytes += outputBytes;
+}
+
+// As the model's, on one column of the block
+template <typename NeuronT, typename WeightT, typename AccT>
+int systolicSimulator<NeuronT, WeightT, AccT>::outputClass(
+    const contextType &context, int s) const
+{
+    const neuronMatrix &neuronsOutput = context.batchNeurons.back();
+    int max = -1 * model.getMaxNeuron();
+    int result = 0;
+
+    for (int k = 0; k < model.getSizeOutput(); k++) {
+        if (neuronsOutput(k, s) > max) {
+            max = neuronsOutput(k, s);
+            result = k;
+        }
+    }
+
+    return result;
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+int systolicSimulator<NeuronT, WeightT, AccT>::classify(
+    contextType &context, const NeuronT *in, int size,
+    systolicStats &stats) const
+{
+    assert(size == model.getSizeInput());
+
+    neuronMatrix &neuronsInput = context.batchNeurons[0];
+    copy(in, in + size, neuronsInput.col(0).data());
+    neuronsInput(size, 0) = model.getBiasNeuron();
+
+    simulateBlock(context, 1, stats);
+
+    for (size_t l = 0; l < context.neurons.size(); l++)
+        context.neurons[l] = context.batchNeurons[l].col(0);
+
+    return outputClass(context, 0);
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+void systolicSimulator<NeuronT, WeightT, AccT>::classifyBatch(
+    contextType &context, const Eigen::Ref<const neuronMatrix> &in,
+    int *results, systolicStats &stats, int blockSize) const
+{
+    assert(in.rows() == model.getSizeInput() && blockSize > 0);
+
+    context.reserveBatch(blockSize);
+
+    for (int first = 0; first < in.cols(); first += blockSize) {
+        int count = min(blockSize, (int)in.cols() - first);
+        neuronMatrix &neuronsInput = context.batchNeurons[0];
+
+        neuronsInput.topLeftCorner(in.rows(), count) =
+            in.middleCols(first, count);
+        neuronsInput.row(in.rows()).head(count).setConstant(
+            model.getBiasNeuron());
+
+        simulateBlock(context, count, stats);
+
+        for (int s = 0; s < count; s++)
+            results[first + s] = outputClass(context, s);
+    }
+}
+
+INSTANTIATE_INTEGER_NET(systolicSimulator)
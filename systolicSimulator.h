@@ -0,0 +1,143 @@
+#ifndef SystolicSimulator_H
+#define SystolicSimulator_H
+
+#include <cstdint>
+#include <vector>
+
+#include "ext/eigen-library/Eigen/Core"
+#include "inferenceContext.h"
+#include "integerModel.h"
+
+using namespace std;
+
+// Co-processor being simulated - A weight-stationary array of multiply-
+// accumulate units, on-chip SRAM for the weights and the activation LUT, and
+// DRAM behind them
+struct systolicConfig {
+    // Processing elements, rows along the layer inputs and columns along
+    // the output neurons
+    int arrayRows, arrayCols;
+
+    // Operand widths of the multipliers and width of the accumulators, in
+    // bits. Wider neurons or weights take one pass per slice of each.
+    int neuronBits, weightBits, accumulatorBits;
+
+    // Rescale and LUT units, each activating one neuron per cycle
+    int activationLanes;
+
+    // SRAM for the weights and for the activation LUT, in bytes
+    int64_t weightSram, lutSram;
+
+    // DRAM bandwidth, in bytes per cycle
+    double dramBandwidth;
+};
+
+const systolicConfig defaultSystolicConfig = {
+    32, 32,             // Array
+    16, 16, 32,         // Operand and accumulator bits
+    32,                 // Activation lanes
+    256 * 1024, 65536,  // SRAM
+    16.0                // DRAM
+};
+
+// Costs of one layer over the samples simulated so far
+struct systolicLayerStats {
+    // Cycles in all, those streaming samples through the array, those the
+    // array waits for weights from DRAM, and those activating the sums
+    int64_t cycles, arrayCycles, stallCycles, activationCycles;
+
+    // Useful multiply-accumulates, at the model's operand widths
+    int64_t macs;
+
+    // DRAM traffic for weights and for LUT entries, in bytes
+    int64_t weightBytes, lutBytes;
+
+    // Sums that left the accumulator width while being added up, which the
+    // hardware would get wrong (simulated results stay exact)
+    int64_t overflows;
+};
+
+// Costs over the samples simulated so far, starting from zeros
+// (systolicStats())
+struct systolicStats {
+    int64_t samples, batches;
+    int64_t cycles;
+
+    // DRAM traffic for the samples in and the output neurons out, in bytes
+    int64_t inputBytes, outputBytes;
+
+    vector<systolicLayerStats> layers;
+};
+
+// Cycle-approximate simulator of the network on a systolic co-processor. The
+// network runs bit-exactly, the timing is a model of the hardware.
+//
+// Each layer is cut in tiles of arrayRows inputs (the bias neuron included)
+// by arrayCols output neurons. A tile's weights are shifted into the array,
+// one row per cycle, then the block of samples streams through it, one
+// sample per cycle and pass. Weights are double-buffered: the next tile's
+// load while the block streams, and its samples follow right behind, so a
+// layer only fills and drains the array (arrayRows + arrayCols - 2 cycles)
+// once. Partial sums of a column of tiles are added up beside the array,
+// then the activation lanes rescale the sums and look them up in the LUT.
+// Layers do not overlap.
+//
+// Layers whose weights fit what is left of the weight SRAM, first layer
+// first, and the LUT if it fits its SRAM, are loaded once (getSetupBytes())
+// and then read from SRAM. The others are read from DRAM for every block of
+// samples, and every LUT lookup then costs a DRAM access. Samples are read
+// from DRAM and output neurons written back, hidden neurons stay on chip.
+template <typename NeuronT, typename WeightT, typename AccT>
+class systolicSimulator
+{
+  public:
+    typedef IntegerModel<NeuronT, WeightT, AccT> modelType;
+    typedef InferenceContext<NeuronT, WeightT, AccT> contextType;
+    typedef typename modelType::neuronMatrix neuronMatrix;
+
+  private:
+    // Not copied, it must outlive the simulator
+    const modelType &model;
+    systolicConfig config;
+
+    vector<bool> weightsResident;
+    bool lutResident;
+    int64_t setupBytes;
+
+    int64_t transferCycles(int64_t bytes) const;
+    void simulateLayer(contextType &context, int l, int count,
+                       systolicLayerStats &stats) const;
+    void simulateBlock(contextType &context, int count,
+                       systolicStats &stats) const;
+    int outputClass(const contextType &context, int s) const;
+
+  public:
+    // Constructor - The configuration's sizes and widths must be positive,
+    // operands at most 32 bits and accumulators at most 64
+    systolicSimulator(const modelType &model, const systolicConfig &config);
+
+    const systolicConfig &getConfig() const { return config; }
+    bool usesResidentWeights(int l) const { return weightsResident[l]; }
+    bool usesResidentLUT() const { return lutResident; }
+    int64_t getSetupBytes() const { return setupBytes; }
+
+    // Passes through the array per sample, and tiles of layer l
+    int getPasses(int l) const;
+    int64_t getTiles(int l) const;
+
+    // Weights of layer l and the activation LUT as stored on chip, in bytes
+    int64_t getWeightBytes(int l) const;
+    int64_t getLUTBytes() const;
+
+    // Classifying - As the model's, adding the costs to stats. Reentrant, as
+    // long as each thread uses its own context and stats. classify leaves
+    // the neurons in the context like the model's; classifyBatch sends each
+    // block of blockSize samples through the array together.
+    int classify(contextType &context, const NeuronT *in, int size,
+                 systolicStats &stats) const;
+    void classifyBatch(contextType &context,
+                       const Eigen::Ref<const neuronMatrix> &in, int *results,
+                       systolicStats &stats, int blockSize = 64) const;
+};
+
+#endif
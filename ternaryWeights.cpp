@@ -0,0 +1,77 @@
+#include "ternaryWeights.h"
+
+using namespace std;
+
+// Constructor
+template <typename WeightT>
+ternaryWeights<WeightT>::ternaryWeights()
+    : rows(0), cols(0), words(0), stride(0), binary(false)
+{
+}
+
+template <typename WeightT> void ternaryWeights<WeightT>::clear()
+{
+    rows = cols = words = stride = 0;
+    binary = false;
+    vector<uint64_t>().swap(positive);
+    vector<uint64_t>().swap(negative);
+}
+
+template <typename WeightT>
+bool ternaryWeights<WeightT>::isTernary(const WeightT *weights, int rows,
+                                        int cols)
+{
+    size_t size = (size_t)rows * cols;
+
+    for (size_t i = 0; i < size; i++) {
+        if (weights[i] < -1 || weights[i] > 1)
+            return false;
+    }
+
+    return true;
+}
+
+template <typename WeightT>
+bool ternaryWeights<WeightT>::build(const WeightT *weights, int numRows,
+                                    int numCols)
+{
+    clear();
+
+    if (numRows == 0 || numCols == 0 ||
+        !isTernary(weights, numRows, numCols))
+        return false;
+
+    rows = numRows;
+    cols = numCols;
+    words = (rows + 63) / 64;
+    stride = (cols + ternaryColumnAlignment - 1) / ternaryColumnAlignment *
+             ternaryColumnAlignment;
+    positive.assign((size_t)words * stride, 0);
+    negative.assign((size_t)words * stride, 0);
+    binary = true;
+
+    for (int j = 0; j < cols; j++) {
+        const WeightT *column = weights + (size_t)j * rows;
+
+        for (int i = 0; i < rows; i++) {
+            uint64_t bit = (uint64_t)1 << (i % 64);
+            size_t word = (size_t)(i / 64) * stride + j;
+
+            if (column[i] > 0)
+                positive[word] |= bit;
+            else if (column[i] < 0)
+                negative[word] |= bit;
+            else
+                binary = false;
+        }
+    }
+
+    if (binary)
+        vector<uint64_t>().swap(negative);
+
+    return true;
+}
+
+template class ternaryWeights<int8_t>;
+template class ternaryWeights<int16_t>;
+template class ternaryWeights<int32_t>;
@@ -0,0 +1,53 @@
+#ifndef TernaryWeights
+#define TernaryWeights
+
+#include <cstdint>
+#include <vector>
+
+#include "layerKernels.h"
+
+using namespace std;
+
+// Bit-packed copy of a column-major rows x cols weight matrix whose weights
+// are all -1, 0 or +1 (binary or ternary weights). Rows are packed 64 to a
+// word, word w of column j keeping rows [64 * w, 64 * w + 64) in
+//   positive[w * stride + j]   bits of the +1 weights
+//   negative[w * stride + j]   bits of the -1 weights
+// so a layer product is an AND and a popcount per word (see ternaryKernel).
+// Binary matrices, without zeros, keep no negative words: their weights are
+// -1 wherever they are not +1. stride is cols rounded up to a multiple of
+// ternaryColumnAlignment, the padding columns and rows are zero.
+template <typename WeightT> class ternaryWeights
+{
+  private:
+    int rows, cols, words, stride;
+    bool binary;
+
+    vector<uint64_t> positive, negative;
+
+  public:
+    ternaryWeights();
+
+    // Packs the weights if they are all -1, 0 or +1, clears them otherwise
+    bool build(const WeightT *weights, int rows, int cols);
+    void clear();
+
+    bool isValid() const { return !positive.empty(); }
+    bool isBinary() const { return binary; }
+    int getRows() const { return rows; }
+    int getCols() const { return cols; }
+    int getWords() const { return words; }
+    int getStride() const { return stride; }
+
+    const uint64_t *getPositive() const { return positive.data(); }
+    // Null for binary matrices
+    const uint64_t *getNegative() const
+    {
+        return binary ? 0 : negative.data();
+    }
+
+    // Whether every weight of a matrix is -1, 0 or +1
+    static bool isTernary(const WeightT *weights, int rows, int cols);
+};
+
+#endif
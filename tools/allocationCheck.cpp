@@ -0,0 +1,91 @@
+// Checks that classifying never allocates once a context has been warmed up,
+// counting every allocation of the program with a replaced operator new.
+//
+// Usage: allocationCheck
+//
+// Run from the directory holding fp-files/, like intNN. The 12-bit network
+// is converted from the floating-point files (written to int-files/), with
+// the result cache and latency tracking on so their paths are covered too.
+// After a warm-up pass sizes the context, every sample is classified again
+// one by one, incrementally and in blocks, from their columns in place. Exits
+// with 1 if any of that allocated.
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "datasetFile.h"
+#include "integerNeuralNet.h"
+
+using namespace std;
+
+// Every allocation of the program goes through these
+static atomic<long> allocationCount(0);
+
+void *operator new(size_t size)
+{
+    allocationCount++;
+
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+int main()
+{
+    typedef integerNeuralNetFor<12, 12> network;
+
+    network nn(400, 30, 10, 12, 12);
+    string datasetFile = "int-files/allocationCheck_input.bin";
+
+    if (!nn.convertFPInputs("fp-files/input.txt", "", datasetFile,
+                            "fp-files/output.txt") ||
+        !nn.convertFPWeights("fp-files/weights.txt",
+                             "int-files/allocationCheck_weights.txt") ||
+        !nn.buildActivationTable(
+            "int-files/allocationCheck_activation.txt")) {
+        cerr << "Could not convert fp-files/" << endl;
+        return 1;
+    }
+
+    datasetReader<network::neuronType> dataset;
+
+    if (!dataset.open(datasetFile) || dataset.getSampleSize() != 400) {
+        cerr << "Could not load dataset file " << datasetFile << endl;
+        return 1;
+    }
+
+    int numSamples = dataset.getNumSamples();
+    datasetReader<network::neuronType>::sampleBlock input =
+        dataset.samples(0, numSamples);
+
+    nn.getModel().enableResultCache(numSamples / 2);
+    nn.getModel().setLatencyTracking(true);
+
+    const network::modelType &model = nn.getModel();
+    network::modelType::contextType context(model);
+    vector<int> results(numSamples);
+
+    model.classifyBatch(context, input, results.data());
+    nn.classify(input.col(0));
+
+    long before = allocationCount;
+    for (int i = 0; i < numSamples; i++) {
+        model.classify(context, input.col(i));
+        model.classifyDelta(context, input.col(i).data(), input.rows());
+        nn.classify(input.col(i));
+    }
+    model.classifyBatch(context, input, results.data());
+    long allocations = allocationCount - before;
+
+    cout << "Allocations while classifying " << numSamples
+         << " samples: " << allocations << endl;
+
+    return allocations == 0 ? 0 : 1;
+}
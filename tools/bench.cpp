@@ -0,0 +1,456 @@
+// Benchmark suite - Times each stage of the network separately and writes the
+// results as JSON, to compare builds and releases.
+//
+// Usage: bench [--quick] [--regions] [--reps N] [--warmup N] [--out FILE]
+//              [--scratch DIR]
+//
+// For every bit depth and layer shape, random floating-point weights and
+// inputs are written to the scratch directory (build/bench by default), then
+// timed through each stage: conversion of weights and inputs, building,
+// saving and loading, the product and activation of each layer, and
+// classify, one sample at a time and in blocks of each batch size.
+//
+// Each stage is run warmup times, then timed reps times. Fast stages are
+// repeated within a timed run for at least a millisecond, stages slower than
+// a tenth of a second are timed at most 5 times. Times are in nanoseconds per
+// item: per file for the file stages, per sample for classifying, per call
+// (one sample) for layer stages. --quick only runs the sample network's
+// shape, with fewer repetitions. --regions also times the runs of each stage
+// in a hooks region (see hooks.h) and prints their summary to stderr, with
+// hardware counters where available, e.g. to tell whether classifying at a
+// bit depth is compute- or memory-bound.
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hooks.h"
+#include "integerKernels.h"
+#include "integerNeuralNet.h"
+#include "layerKernels.h"
+
+using namespace std;
+
+struct benchOptions {
+    int warmup, reps;
+    bool quick, regions;
+    string outFile, scratch;
+};
+
+// Statistics of the timed runs, in nanoseconds per item
+struct timingSummary {
+    int reps;
+    double min, median, mean, stddev, max;
+};
+
+// Stage being timed, written as one JSON result
+struct stageInfo {
+    string stage, per;
+    int bits;
+    vector<int> shape;
+    int layer, batch, items;
+};
+
+static const int numSamples = 1000;
+
+// Name of a stage in the summary and hooks regions
+static string stageName(const stageInfo &info)
+{
+    string name = info.stage;
+
+    if (info.batch > 0)
+        name += " " + to_string(info.batch);
+
+    return name;
+}
+
+template <typename F>
+static timingSummary timeStage(F call, const stageInfo &info,
+                               const benchOptions &options)
+{
+    typedef chrono::steady_clock clock;
+    timingSummary summary;
+    vector<double> times;
+
+    // Warm-up, then enough calls per run for about a millisecond
+    int calls = 1, reps = options.reps;
+    double elapsed = 0.0;
+
+    for (int w = 0; w < max(options.warmup, 1); w++) {
+        clock::time_point start = clock::now();
+        call();
+        elapsed = chrono::duration<double, nano>(clock::now() - start).count();
+    }
+    if (elapsed < 1e6)
+        calls = (int)min(1e6 / max(elapsed, 1.0) + 1, 1e6);
+    if (elapsed > 1e8)
+        reps = min(reps, 5);
+
+    string region = stageName(info);
+    if (options.regions)
+        __parsec_region_begin(region.c_str());
+
+    for (int r = 0; r < reps; r++) {
+        clock::time_point start = clock::now();
+        for (int c = 0; c < calls; c++)
+            call();
+        elapsed = chrono::duration<double, nano>(clock::now() - start).count();
+
+        times.push_back(elapsed / ((double)calls * info.items));
+    }
+
+    if (options.regions)
+        __parsec_region_end(region.c_str());
+
+    sort(times.begin(), times.end());
+
+    double sum = 0.0, squares = 0.0;
+    for (double t : times)
+        sum += t;
+    summary.mean = sum / times.size();
+    for (double t : times)
+        squares += (t - summary.mean) * (t - summary.mean);
+
+    summary.reps = times.size();
+    summary.min = times.front();
+    summary.max = times.back();
+    summary.median = times.size() % 2
+                         ? times[times.size() / 2]
+                         : (times[times.size() / 2 - 1] +
+                            times[times.size() / 2]) / 2;
+    summary.stddev =
+        times.size() > 1 ? sqrt(squares / (times.size() - 1)) : 0.0;
+
+    return summary;
+}
+
+// Results - One JSON object each, also summarized on stderr
+static vector<string> results;
+
+static void addResult(const stageInfo &info, const timingSummary &t)
+{
+    ostringstream json, shape;
+
+    for (size_t i = 0; i < info.shape.size(); i++)
+        shape << (i ? ", " : "") << info.shape[i];
+
+    json << fixed << setprecision(1);
+    json << "    {\"stage\": \"" << info.stage << "\", \"bits\": " << info.bits
+         << ", \"shape\": [" << shape.str() << "]";
+    if (info.layer > 0)
+        json << ", \"layer\": " << info.layer;
+    if (info.batch > 0)
+        json << ", \"batch\": " << info.batch;
+    json << ", \"per\": \"" << info.per << "\", \"items\": " << info.items
+         << ",\n     \"ns\": {\"reps\": " << t.reps << ", \"min\": " << t.min
+         << ", \"median\": " << t.median << ", \"mean\": " << t.mean
+         << ", \"stddev\": " << t.stddev << ", \"max\": " << t.max << "}}";
+    results.push_back(json.str());
+
+    cerr << "  " << setw(22) << left << stageName(info) << right << fixed
+         << setprecision(1) << setw(14) << t.median << " ns/" << info.per
+         << endl;
+}
+
+// Random floating-point weights in the format read by convertFPWeights
+static bool writeFPWeights(const string &file, const vector<int> &shape,
+                           mt19937 &rng)
+{
+    uniform_real_distribution<double> weight(-0.05, 0.05);
+    ofstream output(file);
+
+    output << "Dimensions:" << endl;
+    for (size_t i = 0; i < shape.size(); i++)
+        output << shape[i] << (i + 1 < shape.size() ? " " : "\n");
+
+    output << setprecision(6);
+    for (size_t l = 0; l + 1 < shape.size(); l++) {
+        output << "Weights Layer " << l + 1 << ":" << endl;
+        for (int i = 0; i <= shape[l]; i++) {
+            for (int j = 0; j < shape[l + 1]; j++)
+                output << weight(rng) << " ";
+            output << endl;
+        }
+    }
+
+    return output.good();
+}
+
+// Random floating-point inputs, a fifth of them nonzero like the sample
+// digits
+static bool writeFPInputs(const string &file, int sizeInput, mt19937 &rng)
+{
+    uniform_real_distribution<double> value(0.0, 1.0);
+    ofstream output(file);
+
+    output << setprecision(6);
+    for (int s = 0; s < numSamples; s++) {
+        for (int i = 0; i < sizeInput; i++)
+            output << (value(rng) < 0.2 ? value(rng) : 0.0) << " ";
+        output << endl;
+    }
+
+    return output.good();
+}
+
+template <int Bits>
+static bool benchNetwork(const vector<int> &shape,
+                         const benchOptions &options, mt19937 &rng)
+{
+    typedef integerNeuralNetFor<Bits, Bits> network;
+    typedef typename network::modelType modelType;
+    typedef typename network::neuronType NeuronT;
+    typedef typename network::accumulatorType AccT;
+
+    int numLayers = shape.size() - 1;
+    network nn(shape, Bits, vector<int>(numLayers, Bits));
+    modelType &model = nn.getModel();
+    stageInfo info = {"", "file", Bits, shape, 0, 0, 1};
+
+    string prefix = options.scratch + "/bench_" + to_string(Bits);
+    for (int size : shape)
+        prefix += "_" + to_string(size);
+
+    string fpWeights = prefix + "_fpWeights.txt";
+    string fpInputs = prefix + "_fpInputs.txt";
+    string weights = prefix + "_weights.txt";
+    string inputs = prefix + "_inputs.txt";
+    string activation = prefix + "_activation.txt";
+    string modelFile = prefix + "_model.bin";
+
+    if (!writeFPWeights(fpWeights, shape, rng) ||
+        !writeFPInputs(fpInputs, shape[0], rng)) {
+        cerr << "Could not write to " << options.scratch << endl;
+        return false;
+    }
+
+    // Stages are regions nested in one region per network
+    string networkName = to_string(Bits) + " bits";
+    for (size_t i = 0; i < shape.size(); i++)
+        networkName += (i ? "x" : " ") + to_string(shape[i]);
+
+    cerr << networkName << endl;
+    if (options.regions)
+        __parsec_region_begin(networkName.c_str());
+
+    // File stages - Each call converts, writes or reads whole files
+    bool ok = true;
+    struct fileStage {
+        const char *name;
+        function<bool()> call;
+    } fileStages[] = {
+        {"convertFPWeights",
+         [&]() { return nn.convertFPWeights(fpWeights, weights); }},
+        {"convertFPInputs",
+         [&]() { return nn.convertFPInputs(fpInputs, inputs); }},
+        {"buildActivationTable",
+         [&]() { return nn.buildActivationTable(activation); }},
+        {"loadWeights", [&]() { return nn.loadWeights(weights); }},
+        {"loadActivationTable",
+         [&]() { return nn.loadActivationTable(activation); }},
+        {"saveModel", [&]() { return nn.saveModel(modelFile); }},
+        {"loadModel", [&]() { return nn.loadModel(modelFile); }},
+    };
+
+    for (const fileStage &stage : fileStages) {
+        info.stage = stage.name;
+        addResult(info, timeStage([&]() { ok = stage.call() && ok; }, info,
+                                  options));
+        if (!ok) {
+            cerr << stage.name << " failed" << endl;
+            if (options.regions)
+                __parsec_region_end(networkName.c_str());
+            return false;
+        }
+    }
+
+    // Converted inputs, as classified by main
+    typename network::neuronMatrix samples(shape[0], numSamples);
+    ifstream input(inputs);
+
+    for (int s = 0; s < numSamples; s++) {
+        for (int i = 0; i < shape[0]; i++) {
+            int temp;
+            input >> temp;
+            samples(i, s) = saturateCast<NeuronT>(temp);
+        }
+    }
+
+    // Layer stages - Dense product of one sample through the kernels in use,
+    // and activation of its sums
+    uniform_int_distribution<int> neuron(0, 1 << (Bits - 1));
+    uniform_int_distribution<int> sum(-6 * (1 << (Bits - 1)),
+                                      6 * (1 << (Bits - 1)));
+    volatile int sink = 0;
+
+    info.per = "call";
+    for (int l = 0; l < numLayers; l++) {
+        vector<NeuronT> in(shape[l] + 1);
+        vector<AccT> out(shape[l + 1]), sums(shape[l + 1]);
+
+        for (NeuronT &n : in)
+            n = saturateCast<NeuronT>(neuron(rng));
+        for (AccT &s : sums)
+            s = sum(rng);
+
+        info.layer = l + 1;
+        info.stage = "layer" + to_string(l + 1) + " product";
+        addResult(info, timeStage(
+                            [&]() {
+                                layerProduct(model.getKernels(),
+                                             model.getWeights(l).data(),
+                                             shape[l] + 1, shape[l + 1],
+                                             in.data(), out.data());
+                                sink = sink + (int)out[0];
+                            },
+                            info, options));
+
+        info.stage = "layer" + to_string(l + 1) + " activation";
+        addResult(info, timeStage(
+                            [&]() {
+                                int acc = 0;
+                                for (AccT s : sums)
+                                    acc += model.activationFunction(s);
+                                sink = sink + acc;
+                            },
+                            info, options));
+    }
+    info.layer = 0;
+
+    // End to end - Every sample, one at a time and in blocks
+    typename modelType::contextType context(model);
+    vector<int> classes(numSamples);
+    const int batchSizes[] = {1, 8, 64, 256};
+
+    info.per = "sample";
+    info.items = numSamples;
+    info.stage = "classify";
+    addResult(info, timeStage(
+                        [&]() {
+                            for (int s = 0; s < numSamples; s++)
+                                classes[s] =
+                                    model.classify(context, samples.col(s));
+                        },
+                        info, options));
+
+    info.stage = "classifyBatch";
+    for (int batch : batchSizes) {
+        info.batch = batch;
+        addResult(info, timeStage(
+                            [&]() {
+                                model.classifyBatch(context, samples,
+                                                    classes.data(), batch);
+                            },
+                            info, options));
+    }
+
+    if (options.regions)
+        __parsec_region_end(networkName.c_str());
+
+    return true;
+}
+
+static int usage()
+{
+    cerr << "Usage: bench [--quick] [--regions] [--reps N] [--warmup N] "
+            "[--out FILE] [--scratch DIR]"
+         << endl;
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    benchOptions options = {2, 15, false, false, "", "build/bench"};
+
+    for (int a = 1; a < argc; a++) {
+        string arg = argv[a];
+        bool hasValue = a + 1 < argc;
+
+        if (arg == "--quick")
+            options.quick = true;
+        else if (arg == "--regions")
+            options.regions = true;
+        else if (arg == "--reps" && hasValue)
+            options.reps = atoi(argv[++a]);
+        else if (arg == "--warmup" && hasValue)
+            options.warmup = atoi(argv[++a]);
+        else if (arg == "--out" && hasValue)
+            options.outFile = argv[++a];
+        else if (arg == "--scratch" && hasValue)
+            options.scratch = argv[++a];
+        else
+            return usage();
+    }
+    if (options.reps < 1)
+        return usage();
+    if (options.quick) {
+        options.warmup = 1;
+        options.reps = min(options.reps, 5);
+    }
+
+    mkdir(options.scratch.c_str(), 0755);
+
+    // The sample network, a wider one and a deeper one. Inputs stay under
+    // 512 so the 12-bit sums fit 32 bits.
+    vector<vector<int>> shapes = {{400, 30, 10}, {256, 256, 10},
+                                  {400, 128, 64, 10}};
+    if (options.quick)
+        shapes.resize(1);
+
+    mt19937 rng(1);
+    bool ok = true;
+
+    for (const vector<int> &shape : shapes) {
+        ok = ok && benchNetwork<8>(shape, options, rng);
+        ok = ok && benchNetwork<12>(shape, options, rng);
+        ok = ok && benchNetwork<16>(shape, options, rng);
+    }
+    if (options.regions)
+        __parsec_region_report(stderr);
+    if (!ok)
+        return 1;
+
+    ostringstream json;
+
+    json << "{\n  \"benchmark\": \"intNN\",\n";
+#ifdef VERSION_HASH
+    json << "  \"version\": \"" << VERSION_MAJOR << "." << VERSION_MINOR << "."
+         << VERSION_PATCH << "." << VERSION_REVISION << "-" << VERSION_HASH
+         << "\",\n";
+#endif
+    json << "  \"kernels\": \"" << detectLayerKernels().name << "\",\n"
+         << "  \"threads\": " << thread::hardware_concurrency() << ",\n"
+         << "  \"warmup\": " << options.warmup << ",\n"
+         << "  \"reps\": " << options.reps << ",\n"
+         << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+        json << results[i] << (i + 1 < results.size() ? ",\n" : "\n");
+    json << "  ]\n}\n";
+
+    if (options.outFile.empty()) {
+        cout << json.str();
+    } else {
+        ofstream output(options.outFile);
+        output << json.str();
+        if (!output.good()) {
+            cerr << "Could not write " << options.outFile << endl;
+            return 1;
+        }
+        cerr << "Results written to " << options.outFile << endl;
+    }
+
+    return 0;
+}
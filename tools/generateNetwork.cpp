@@ -0,0 +1,344 @@
+// Network generator - Writes a header with a fixed-size copy of a converted
+// network, for models that are frozen and classified at high rates.
+//
+// Usage: generateNetwork --model FILE [--name NAME] [--out FILE]
+//        generateNetwork --weights FILE --activation FILE --neuron-bits N
+//                        --weight-bits N [--name NAME] [--out FILE]
+//
+// The network is read from a binary model file, or from integer weights and
+// activation table text files of the given bit depths (whose shifts are 0).
+// The header defines a struct NAME (frozenNetwork by default) with the
+// network's types, constexpr sizes and
+//   static int classify(const neuronType *in);
+// which returns the same class as the model's classify. Weights, shifts,
+// output scales and the activation table are embedded as constexpr data, and
+// the layers are computed by the kernels of fixedNetwork.h, so nothing is
+// loaded at run time and every loop bound is known to the compiler. The
+// header is written to NAME.h unless --out is given.
+
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "integerModel.h"
+#include "modelFile.h"
+
+using namespace std;
+
+struct generatorOptions {
+    string modelFile, weightsFile, activationFile;
+    int neuronBits, weightBits;
+    string name, outFile;
+};
+
+template <typename T> static const char *typeName();
+template <> const char *typeName<int8_t>() { return "int8_t"; }
+template <> const char *typeName<int16_t>() { return "int16_t"; }
+template <> const char *typeName<int32_t>() { return "int32_t"; }
+template <> const char *typeName<int64_t>() { return "int64_t"; }
+
+// Writes values as the body of an array initializer, wrapped to 80 columns
+template <typename T>
+static void writeValues(ostream &out, const T *values, size_t count,
+                        const string &indent)
+{
+    string line = indent;
+
+    for (size_t i = 0; i < count; i++) {
+        string value = to_string((long long)values[i]) +
+                       (i + 1 < count ? "," : "");
+
+        if (line.size() > indent.size() &&
+            line.size() + 1 + value.size() > 80) {
+            out << line << "\n";
+            line = indent;
+        }
+        if (line.size() > indent.size())
+            line += " ";
+        line += value;
+    }
+    out << line << "\n";
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+static bool writeNetwork(const IntegerModel<NeuronT, WeightT, AccT> &model,
+                         const generatorOptions &options, const string &source)
+{
+    const char *neuronName = typeName<NeuronT>();
+    const char *weightName = typeName<WeightT>();
+    const string &name = options.name;
+    int numLayers = model.getNumLayers();
+    int maxNeuron = model.getMaxNeuron();
+    ostringstream out;
+
+    string guard = name;
+    guard[0] = toupper(guard[0]);
+
+    out << "// Generated by tools/generateNetwork - Do not edit.\n//\n"
+        << "// Network of " << model.getLayerSize(0);
+    for (int l = 1; l <= numLayers; l++)
+        out << "-" << model.getLayerSize(l);
+    out << " neurons, with " << model.getNeuronBits() << "-bit neurons and ";
+    for (int l = 0; l < numLayers; l++)
+        out << (l > 0 ? "/" : "") << model.getWeightBits(l);
+    out << "-bit weights,\n// from " << source << ".\n\n"
+        << "#ifndef " << guard << "\n#define " << guard << "\n\n"
+        << "#include <cstdint>\n\n#include \"fixedNetwork.h\"\n\n"
+        << "using namespace std;\n\n";
+
+    // Types and sizes
+    out << "struct " << name << " {\n"
+        << "    typedef " << neuronName << " neuronType;\n"
+        << "    typedef " << weightName << " weightType;\n"
+        << "    typedef " << typeName<AccT>() << " accumulatorType;\n\n"
+        << "    static constexpr int numLayers = " << numLayers << ";\n"
+        << "    static constexpr int sizeInput = " << model.getSizeInput()
+        << ";\n"
+        << "    static constexpr int sizeOutput = " << model.getSizeOutput()
+        << ";\n"
+        << "    static constexpr int neuronBits = " << model.getNeuronBits()
+        << ";\n"
+        << "    static constexpr int maxNeuron = " << maxNeuron << ";\n\n"
+        << "    // Class of the sample in (sizeInput neurons)\n"
+        << "    static int classify(const neuronType *in);\n"
+        << "};\n\n";
+
+    // Weights, one row per output neuron, and output scales
+    for (int l = 0; l < numLayers; l++) {
+        typename IntegerModel<NeuronT, WeightT, AccT>::weightMap weights =
+            model.getWeights(l);
+        int rows = weights.rows(), cols = weights.cols();
+
+        out << "static constexpr " << weightName << " " << name << "Weights"
+            << l << "[" << cols << "][" << rows << "] = {\n";
+        for (int j = 0; j < cols; j++) {
+            out << "    {\n";
+            writeValues(out, weights.col(j).data(), rows, "        ");
+            out << (j + 1 < cols ? "    },\n" : "    }\n");
+        }
+        out << "};\n\n";
+
+        const vector<int32_t> &scales = model.getScales(l);
+        if (!scales.empty()) {
+            out << "static constexpr int32_t " << name << "Scales" << l << "["
+                << scales.size() << "] = {\n";
+            writeValues(out, scales.data(), scales.size(), "    ");
+            out << "};\n\n";
+        }
+    }
+
+    // Saturated activations of [-5 * maxNeuron, 5 * maxNeuron)
+    vector<NeuronT> table(10 * maxNeuron);
+    for (int i = 0; i < 10 * maxNeuron; i++)
+        table[i] = model.activationFunction((AccT)(i - 5 * maxNeuron));
+
+    out << "static constexpr " << neuronName << " " << name
+        << "Activation[10 * " << maxNeuron << "] = {\n";
+    writeValues(out, table.data(), table.size(), "    ");
+    out << "};\n\n";
+
+    // Forward pass, one product and activation per layer
+    out << "inline int " << name << "::classify(const neuronType *in)\n{\n"
+        << "    const neuronType bias = "
+        << (int)saturateCast<NeuronT>(-1 * maxNeuron + 1) << ";\n"
+        << "    const neuronType top = "
+        << (int)model.activationFunction((AccT)(5 * maxNeuron)) << ";\n\n";
+    for (int l = 0; l <= numLayers; l++) {
+        int size = model.getLayerSize(l) + (l < numLayers ? 1 : 0);
+        out << "    neuronType neurons" << l << "[" << size << "];\n";
+    }
+    for (int l = 0; l < numLayers; l++)
+        out << "    accumulatorType sums" << l << "["
+            << model.getLayerSize(l + 1) << "];\n";
+
+    out << "\n    fixedInput<neuronType, " << model.getSizeInput()
+        << ">(in, bias, neurons0);\n";
+    for (int l = 0; l < numLayers; l++) {
+        int scaleBits = model.getScaleBits(l) + model.getShift(l);
+
+        out << "\n    fixedProduct(" << name << "Weights" << l << ", neurons"
+            << l << ", sums" << l << ");\n";
+        if (model.getScales(l).empty())
+            out << "    fixedActivate<maxNeuron, " << model.getShift(l)
+                << ">(\n        sums" << l << ", " << name
+                << "Activation, top, neurons" << l + 1 << ");\n";
+        else
+            out << "    fixedActivateScaled<maxNeuron, " << scaleBits
+                << ">(\n        sums" << l << ", " << name << "Scales" << l
+                << ", " << name << "Activation, top,\n        neurons"
+                << l + 1 << ");\n";
+        if (l + 1 < numLayers)
+            out << "    neurons" << l + 1 << "["
+                << model.getLayerSize(l + 1) << "] = bias;\n";
+    }
+    out << "\n    return fixedOutputClass<maxNeuron>(neurons" << numLayers
+        << ");\n}\n\n#endif\n";
+
+    ofstream file(options.outFile, ios::out);
+    if (!file.is_open())
+        return false;
+    file << out.str();
+    file.close();
+
+    return !file.fail();
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+static int generate(const vector<int> &sizes, int neuronBits,
+                    const vector<int> &weightBits,
+                    const generatorOptions &options)
+{
+    IntegerModel<NeuronT, WeightT, AccT> model(sizes, neuronBits, weightBits);
+    string source;
+
+    if (!options.modelFile.empty()) {
+        source = options.modelFile;
+        if (!model.loadModel(options.modelFile)) {
+            cerr << "Could not load model file " << options.modelFile << endl;
+            return 1;
+        }
+    } else {
+        source = options.weightsFile;
+        if (!model.loadWeights(options.weightsFile) ||
+            !model.loadActivationTable(options.activationFile)) {
+            cerr << "Could not load " << options.weightsFile << " and "
+                 << options.activationFile << endl;
+            return 1;
+        }
+    }
+
+    if (!writeNetwork(model, options, source)) {
+        cerr << "Could not write " << options.outFile << endl;
+        return 1;
+    }
+
+    cerr << "Wrote " << options.name << " to " << options.outFile << endl;
+    return 0;
+}
+
+// generate for storage types given by their sizes in bytes
+struct generateNetwork {
+    const vector<int> &sizes;
+    int neuronBits;
+    const vector<int> &weightBits;
+    const generatorOptions &options;
+
+    template <typename NeuronT, typename WeightT, typename AccT>
+    int run() const
+    {
+        return generate<NeuronT, WeightT, AccT>(sizes, neuronBits, weightBits,
+                                                options);
+    }
+};
+
+static int generateFor(int neuronBytes, int accumulatorBytes,
+                       const vector<int> &sizes, int neuronBits,
+                       const vector<int> &weightBits,
+                       const generatorOptions &options)
+{
+    generateNetwork generator = {sizes, neuronBits, weightBits, options};
+    int result;
+
+    if (!withIntegerNetTypes(neuronBytes, accumulatorBytes, generator,
+                             result)) {
+        cerr << "Unsupported storage types" << endl;
+        return 1;
+    }
+
+    return result;
+}
+
+static int usage()
+{
+    cerr << "Usage: generateNetwork --model FILE [--name NAME] [--out FILE]\n"
+            "       generateNetwork --weights FILE --activation FILE "
+            "--neuron-bits N\n"
+            "                       --weight-bits N [--name NAME] "
+            "[--out FILE]"
+         << endl;
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    generatorOptions options = {"", "", "", 0, 0, "frozenNetwork", ""};
+
+    for (int a = 1; a < argc; a++) {
+        string arg = argv[a];
+
+        if (a + 1 >= argc)
+            return usage();
+        else if (arg == "--model")
+            options.modelFile = argv[++a];
+        else if (arg == "--weights")
+            options.weightsFile = argv[++a];
+        else if (arg == "--activation")
+            options.activationFile = argv[++a];
+        else if (arg == "--neuron-bits")
+            options.neuronBits = atoi(argv[++a]);
+        else if (arg == "--weight-bits")
+            options.weightBits = atoi(argv[++a]);
+        else if (arg == "--name")
+            options.name = argv[++a];
+        else if (arg == "--out")
+            options.outFile = argv[++a];
+        else
+            return usage();
+    }
+
+    bool fromModel = !options.modelFile.empty();
+    bool fromText = !options.weightsFile.empty() &&
+                    !options.activationFile.empty() &&
+                    options.neuronBits >= 2 && options.neuronBits <= 32 &&
+                    options.weightBits >= 2 && options.weightBits <= 32;
+    if (fromModel == fromText || options.name.empty() ||
+        !(isalpha(options.name[0]) || options.name[0] == '_'))
+        return usage();
+    if (options.outFile.empty())
+        options.outFile = options.name + ".h";
+
+    if (fromModel) {
+        modelFileLayout layout;
+
+        if (!readModelLayout(options.modelFile, layout)) {
+            cerr << "Could not read model file " << options.modelFile << endl;
+            return 1;
+        }
+
+        return generateFor(layout.header.neuronBytes,
+                           layout.header.accumulatorBytes, layout.sizes,
+                           layout.header.neuronBits, layout.weightBits,
+                           options);
+    }
+
+    // Sizes from the weights file's dimensions line, types from the bit
+    // depths as integerNetTypes picks them
+    vector<int> sizes, weightBits;
+    ifstream weights(options.weightsFile);
+    string line;
+    int size;
+
+    getline(weights, line); // Dimensions label
+    getline(weights, line);
+    istringstream dimensions(line);
+    while (dimensions >> size)
+        sizes.push_back(size);
+    if (sizes.size() < 2) {
+        cerr << "Could not read weights file " << options.weightsFile << endl;
+        return 1;
+    }
+    weightBits.assign(sizes.size() - 1, options.weightBits);
+
+    int bits = max(options.neuronBits, options.weightBits);
+    int neuronBytes = bits <= 8 ? 1 : bits <= 16 ? 2 : 4;
+    int accumulatorBytes =
+        options.neuronBits + options.weightBits <= 24 ? 4 : 8;
+
+    return generateFor(neuronBytes, accumulatorBytes, sizes,
+                       options.neuronBits, weightBits, options);
+}
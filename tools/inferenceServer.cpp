@@ -0,0 +1,535 @@
+// Inference server - Classifies samples sent over a Unix domain socket, or
+// read from stdin, in dynamic batches.
+//
+// Usage: inferenceServer --model FILE [--socket PATH] [--max-batch N]
+//                        [--max-wait-us N] [--workers N] [--queue N]
+//
+// Requests are lines of the model's input size in integers, already
+// quantized (as written by convertFPInputs), and each gets back one line with
+// its class index, or "error" and a reason. Responses of a connection come
+// in the order of its requests, which may be pipelined. Without --socket,
+// requests are read from stdin and answered on stdout until end of input.
+//
+// Readers (one per connection) push requests to a lock-free queue, workers
+// pop them into batches and classify each batch with classifyBatch. A batch
+// is closed once it holds --max-batch requests or its first request has
+// waited --max-wait-us microseconds, whichever comes first: small values
+// favour latency, large ones throughput. Counts and latencies (from reading
+// a request to answering it) are printed to stderr on exit.
+//
+// The model's storage types are taken from the binary model file.
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "integerModel.h"
+#include "latencyHistogram.h"
+#include "modelFile.h"
+#include "mpmcQueue.h"
+
+using namespace std;
+
+struct serverOptions {
+    string modelFile, socketPath;
+    int maxBatch, maxWaitUs, workers, queueSize;
+};
+
+// Largest --queue, requests waiting in the queue and per connection
+const int maxQueueSize = 1 << 20;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int) { stopRequested = 1; }
+
+// Connection - Responses of a connection's requests, put back in order and
+// written by its own writer thread, so workers never wait for a client. The
+// descriptor is closed with the last reference.
+struct connection {
+    int in, out;
+    bool ownsDescriptor;
+
+    mutex lock;
+    condition_variable changed;
+    uint64_t requested, nextResponse;
+    bool endOfInput;
+    map<uint64_t, string> waiting;
+    string output;
+
+    connection(int inFd, int outFd, bool owns)
+        : in(inFd), out(outFd), ownsDescriptor(owns), requested(0),
+          nextResponse(0), endOfInput(false)
+    {
+    }
+    ~connection()
+    {
+        if (ownsDescriptor)
+            close(in);
+    }
+
+    // Numbers a new request, once fewer than limit are waiting for their
+    // response (the client must read responses while it sends)
+    uint64_t request(uint64_t limit)
+    {
+        unique_lock<mutex> guard(lock);
+
+        changed.wait(guard,
+                     [&]() { return requested - nextResponse < limit; });
+        return requested++;
+    }
+
+    void finish()
+    {
+        lock_guard<mutex> guard(lock);
+        endOfInput = true;
+        changed.notify_all();
+    }
+
+    // Queues the response of request number sequence, and every response
+    // that is then next in order for writing
+    void respond(uint64_t sequence, const string &response)
+    {
+        lock_guard<mutex> guard(lock);
+
+        waiting[sequence] = response;
+        for (auto next = waiting.begin();
+             next != waiting.end() && next->first == nextResponse;
+             next = waiting.erase(next)) {
+            output += next->second;
+            nextResponse++;
+        }
+        changed.notify_all();
+    }
+
+    // Writes responses until every request is answered. Once the client is
+    // gone, responses are dropped.
+    void writer()
+    {
+        unique_lock<mutex> guard(lock);
+        string data;
+        bool failed = false;
+
+        for (;;) {
+            changed.wait(guard, [&]() {
+                return !output.empty() ||
+                       (endOfInput && nextResponse == requested);
+            });
+            if (output.empty())
+                return;
+
+            data.swap(output);
+            guard.unlock();
+            for (size_t written = 0; !failed && written < data.size();) {
+                ssize_t n = write(out, data.data() + written,
+                                  data.size() - written);
+                failed = n <= 0;
+                written += failed ? 0 : n;
+            }
+            data.clear();
+            guard.lock();
+        }
+    }
+};
+
+template <typename NeuronT> struct serverRequest {
+    shared_ptr<connection> client;
+    uint64_t sequence;
+    uint64_t arrival;
+    vector<NeuronT> input;
+    string error;
+};
+
+template <typename NeuronT, typename WeightT, typename AccT>
+class inferenceServer
+{
+  private:
+    typedef IntegerModel<NeuronT, WeightT, AccT> modelType;
+    typedef serverRequest<NeuronT> requestType;
+
+    const modelType &model;
+    serverOptions options;
+
+    mpmcQueue<requestType *> queue;
+
+    // Idle workers sleep on this, readers wake them when they push
+    mutex idleLock;
+    condition_variable idle;
+    atomic<int> sleepers;
+    atomic<bool> stopping;
+
+    atomic<uint64_t> requests, batches;
+
+    // Active connections, shut down when stopping, and readers still
+    // serving theirs (detached, they are waited for when stopping)
+    mutex connectionsLock;
+    vector<weak_ptr<connection>> connections;
+    condition_variable readerDone;
+    int activeReaders;
+
+    void push(requestType *request)
+    {
+        while (!queue.tryPush(request))
+            this_thread::sleep_for(chrono::microseconds(50));
+
+        if (sleepers.load() > 0) {
+            lock_guard<mutex> guard(idleLock);
+            idle.notify_one();
+        }
+    }
+
+    // Waits for a request, until the deadline if given. Returns false if
+    // none came, or if stopping and the queue is drained.
+    bool pop(requestType *&request, bool untilDeadline,
+             chrono::steady_clock::time_point deadline)
+    {
+        for (;;) {
+            if (queue.tryPop(request))
+                return true;
+            if (stopping.load() ||
+                (untilDeadline && chrono::steady_clock::now() >= deadline))
+                return false;
+
+            // A push between the check and the wait is caught by the
+            // timeout at worst
+            unique_lock<mutex> guard(idleLock);
+            sleepers++;
+            if (!queue.tryPop(request)) {
+                chrono::steady_clock::time_point wake =
+                    chrono::steady_clock::now() + chrono::milliseconds(1);
+                idle.wait_until(guard, untilDeadline ? min(wake, deadline)
+                                                     : wake);
+                sleepers--;
+                continue;
+            }
+            sleepers--;
+            return true;
+        }
+    }
+
+    void worker()
+    {
+        typedef typename modelType::neuronMatrix neuronMatrix;
+        typename modelType::contextType context(model);
+        neuronMatrix batch(model.getSizeInput(), options.maxBatch);
+        vector<int> results(options.maxBatch);
+        vector<requestType *> pending;
+        requestType *request;
+
+        pending.reserve(options.maxBatch);
+
+        while (pop(request, false, chrono::steady_clock::time_point())) {
+            chrono::steady_clock::time_point deadline =
+                chrono::steady_clock::now() +
+                chrono::microseconds(options.maxWaitUs);
+
+            pending.assign(1, request);
+            while ((int)pending.size() < options.maxBatch &&
+                   pop(request, true, deadline))
+                pending.push_back(request);
+
+            // Malformed requests are answered, not classified
+            int count = 0;
+            for (requestType *r : pending) {
+                if (r->error.empty())
+                    copy(r->input.begin(), r->input.end(),
+                         batch.col(count++).data());
+            }
+            if (count > 0)
+                model.classifyBatch(context, batch.leftCols(count),
+                                    results.data(), options.maxBatch);
+
+            count = 0;
+            for (requestType *r : pending) {
+                string response = r->error.empty()
+                                      ? to_string(results[count++]) + "\n"
+                                      : "error " + r->error + "\n";
+
+                r->client->respond(r->sequence, response);
+                latencyRecorder::record(latencyClock::now() - r->arrival);
+                delete r;
+            }
+
+            requests += pending.size();
+            batches++;
+        }
+    }
+
+    // Reads the requests of a connection until it closes, and answers them
+    void reader(shared_ptr<connection> client)
+    {
+        FILE *in = fdopen(dup(client->in), "r");
+        char *line = 0;
+        size_t capacity = 0;
+        int sizeInput = model.getSizeInput();
+
+        if (!in)
+            return;
+
+        thread writer([client]() { client->writer(); });
+
+        while (getline(&line, &capacity, in) > 0) {
+            requestType *request = new requestType;
+            const char *p = line;
+            char *end;
+
+            request->client = client;
+            request->sequence = client->request(options.queueSize);
+            request->arrival = latencyClock::now();
+            request->input.reserve(sizeInput);
+
+            for (;;) {
+                long value = strtol(p, &end, 10);
+                if (end == p)
+                    break;
+                request->input.push_back(saturateCast<NeuronT>(value));
+                p = end;
+            }
+            while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+                p++;
+
+            if (*p != '\0')
+                request->error = "invalid value";
+            else if ((int)request->input.size() != sizeInput)
+                request->error = "expected " + to_string(sizeInput) +
+                                 " values, got " +
+                                 to_string(request->input.size());
+
+            push(request);
+        }
+
+        client->finish();
+        writer.join();
+
+        free(line);
+        fclose(in);
+    }
+
+  public:
+    inferenceServer(const modelType &m, const serverOptions &o)
+        : model(m), options(o), queue(o.queueSize), sleepers(0),
+          stopping(false), requests(0), batches(0), activeReaders(0)
+    {
+    }
+
+    int run()
+    {
+        vector<thread> workers;
+
+        for (int w = 0; w < options.workers; w++)
+            workers.emplace_back([this]() { worker(); });
+
+        int status = options.socketPath.empty() ? serveStdin() : serveSocket();
+
+        stopping = true;
+        {
+            lock_guard<mutex> guard(idleLock);
+            idle.notify_all();
+        }
+        for (thread &w : workers)
+            w.join();
+
+        uint64_t numRequests = requests, numBatches = batches;
+        cerr << "Served " << numRequests << " requests in " << numBatches
+             << " batches";
+        if (numBatches > 0)
+            cerr << " (" << (double)numRequests / numBatches << " per batch)";
+        cerr << endl;
+        latencyRecorder::report(stderr, "Request");
+
+        return status;
+    }
+
+    int serveStdin()
+    {
+        reader(make_shared<connection>(0, 1, false));
+        return 0;
+    }
+
+    int serveSocket()
+    {
+        struct sockaddr_un address;
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (listener < 0 ||
+            options.socketPath.size() >= sizeof(address.sun_path)) {
+            cerr << "Could not create socket " << options.socketPath << endl;
+            return 1;
+        }
+        strcpy(address.sun_path, options.socketPath.c_str());
+        unlink(address.sun_path);
+
+        if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+            listen(listener, 128) != 0) {
+            cerr << "Could not listen on " << options.socketPath << ": "
+                 << strerror(errno) << endl;
+            close(listener);
+            return 1;
+        }
+        cerr << "Listening on " << options.socketPath << endl;
+
+        // Accepts until interrupted, polling so the stop flag is seen
+        struct pollfd waiting = {listener, POLLIN, 0};
+
+        while (!stopRequested) {
+            if (poll(&waiting, 1, 200) <= 0)
+                continue;
+
+            int fd = accept(listener, 0, 0);
+            if (fd < 0)
+                continue;
+
+            shared_ptr<connection> client =
+                make_shared<connection>(fd, fd, true);
+            {
+                lock_guard<mutex> guard(connectionsLock);
+                connections.erase(
+                    remove_if(connections.begin(), connections.end(),
+                              [](const weak_ptr<connection> &c) {
+                                  return c.expired();
+                              }),
+                    connections.end());
+                connections.push_back(client);
+                activeReaders++;
+            }
+
+            // The connection is released before the reader counts as done,
+            // nothing of it outlives the wait below
+            thread([this, client]() mutable {
+                reader(client);
+                client.reset();
+
+                lock_guard<mutex> guard(connectionsLock);
+                activeReaders--;
+                readerDone.notify_all();
+            }).detach();
+        }
+
+        // Readers blocked on their clients stop at end of input
+        {
+            unique_lock<mutex> guard(connectionsLock);
+            for (weak_ptr<connection> &c : connections) {
+                if (shared_ptr<connection> client = c.lock())
+                    shutdown(client->in, SHUT_RD);
+            }
+            readerDone.wait(guard, [this]() { return activeReaders == 0; });
+        }
+
+        close(listener);
+        unlink(address.sun_path);
+        return 0;
+    }
+};
+
+template <typename NeuronT, typename WeightT, typename AccT>
+static int serve(const modelFileLayout &layout, const serverOptions &options)
+{
+    IntegerModel<NeuronT, WeightT, AccT> model(
+        layout.sizes, layout.header.neuronBits, layout.weightBits);
+
+    if (!model.loadModel(options.modelFile)) {
+        cerr << "Could not load model file " << options.modelFile << endl;
+        return 1;
+    }
+
+    inferenceServer<NeuronT, WeightT, AccT> server(model, options);
+    return server.run();
+}
+
+// serve for the storage types of the model file
+struct serveModel {
+    const modelFileLayout &layout;
+    const serverOptions &options;
+
+    template <typename NeuronT, typename WeightT, typename AccT>
+    int run() const
+    {
+        return serve<NeuronT, WeightT, AccT>(layout, options);
+    }
+};
+
+static int usage()
+{
+    cerr << "Usage: inferenceServer --model FILE [--socket PATH] "
+            "[--max-batch N]\n"
+            "                       [--max-wait-us N] [--workers N] "
+            "[--queue N]"
+         << endl;
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    serverOptions options = {"", "", 32, 200,
+                             max(1, (int)thread::hardware_concurrency()),
+                             4096};
+
+    for (int a = 1; a < argc; a++) {
+        string arg = argv[a];
+
+        if (a + 1 >= argc)
+            return usage();
+        else if (arg == "--model")
+            options.modelFile = argv[++a];
+        else if (arg == "--socket")
+            options.socketPath = argv[++a];
+        else if (arg == "--max-batch")
+            options.maxBatch = atoi(argv[++a]);
+        else if (arg == "--max-wait-us")
+            options.maxWaitUs = atoi(argv[++a]);
+        else if (arg == "--workers")
+            options.workers = atoi(argv[++a]);
+        else if (arg == "--queue")
+            options.queueSize = atoi(argv[++a]);
+        else
+            return usage();
+    }
+    if (options.modelFile.empty() || options.maxBatch < 1 ||
+        options.maxWaitUs < 0 || options.workers < 1 || options.queueSize < 1 ||
+        options.queueSize > maxQueueSize)
+        return usage();
+
+    modelFileLayout layout;
+    serveModel server = {layout, options};
+    int result;
+
+    if (!readModelLayout(options.modelFile, layout)) {
+        cerr << "Could not read model file " << options.modelFile << endl;
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigaction(SIGINT, &action, 0);
+    sigaction(SIGTERM, &action, 0);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (!withIntegerNetTypes(layout.header.neuronBytes,
+                             layout.header.accumulatorBytes, server,
+                             result)) {
+        cerr << "Unsupported storage types in " << options.modelFile << endl;
+        return 1;
+    }
+
+    return result;
+}
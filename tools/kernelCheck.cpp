@@ -0,0 +1,458 @@
+// Checks the layer kernels of every instruction set this CPU supports against
+// the scalar reference (see layerKernels.h), bit for bit, and the sums of the
+// scalar reference against Eigen's integer products.
+//
+// Usage: kernelCheck [kernels]
+//
+// Random operands go through each kernel over odd layer shapes, so vector
+// bodies, their tails and masked loads are all covered: row counts around
+// the vector widths, column counts around the ternary and weight-row
+// alignments, and blocks of samples with a group of four and leftovers, at
+// strides wider than the samples. Operands are as large as each kernel's
+// contract allows: sums that fit 32 bits, and partial sums that fit 16 bits
+// for the narrow-accumulator kernels. With an argument only the named
+// kernels are checked. Prints the mismatches and a line per instruction set,
+// and exits with 1 if any kernel differs from the reference.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ext/eigen-library/Eigen/Core"
+#include "layerKernels.h"
+#include "sparseWeights.h"
+#include "ternaryWeights.h"
+
+using namespace std;
+
+struct layerShape {
+    int rows, cols;
+};
+
+// Samples per block product, and extra rows and columns between samples
+const int blockCount = 7;
+const int blockPadding = 3;
+
+class kernelChecker
+{
+  private:
+    const layerKernels &reference, &kernels;
+    mt19937 rng;
+    int checks, mismatches;
+
+    void report(const char *kernel, const layerShape &shape, bool same);
+    void reportReference(const char *kernel, const layerShape &shape,
+                         bool same);
+    template <typename T> vector<T> randomValues(size_t size, int limit);
+    template <typename T> vector<T> sparseValues(size_t size, int limit);
+
+    template <typename T> void checkProducts(const layerShape &shape);
+    void checkNarrow(const layerShape &shape);
+    template <typename T> void checkSparse(const layerShape &shape);
+    template <typename T> void checkRows(const layerShape &shape);
+    template <typename T> void checkTernary(const layerShape &shape,
+                                            bool binary);
+
+  public:
+    kernelChecker(const layerKernels &reference, const layerKernels &kernels);
+
+    void check(const layerShape &shape);
+
+    int getChecks() const { return checks; }
+    int getMismatches() const { return mismatches; }
+};
+
+kernelChecker::kernelChecker(const layerKernels &r, const layerKernels &k)
+    : reference(r), kernels(k), rng(1), checks(0), mismatches(0)
+{
+}
+
+void kernelChecker::report(const char *kernel, const layerShape &shape,
+                           bool same)
+{
+    checks++;
+    if (same)
+        return;
+
+    mismatches++;
+    cout << kernels.name << ": " << kernel << " differs on " << shape.rows
+         << " x " << shape.cols << endl;
+}
+
+// Checks of the scalar reference itself, whichever kernels are checked
+void kernelChecker::reportReference(const char *kernel,
+                                    const layerShape &shape, bool same)
+{
+    checks++;
+    if (same)
+        return;
+
+    mismatches++;
+    cout << reference.name << ": " << kernel << " differs from Eigen on "
+         << shape.rows << " x " << shape.cols << endl;
+}
+
+// Uniform values in [-limit, limit], clamped to the range of T
+template <typename T>
+vector<T> kernelChecker::randomValues(size_t size, int limit)
+{
+    int low = max(-limit, (int)numeric_limits<T>::min());
+    int high = min(limit, (int)numeric_limits<T>::max());
+    uniform_int_distribution<int> value(low, high);
+    vector<T> values(size);
+
+    for (size_t i = 0; i < size; i++)
+        values[i] = (T)value(rng);
+
+    return values;
+}
+
+// As randomValues, with two thirds of them zero
+template <typename T>
+vector<T> kernelChecker::sparseValues(size_t size, int limit)
+{
+    vector<T> values = randomValues<T>(size, limit);
+
+    for (size_t i = 0; i < size; i++) {
+        if (rng() % 3)
+            values[i] = 0;
+    }
+
+    return values;
+}
+
+// Largest magnitude of the operands of a product of rows terms whose sums
+// fit bits bits
+static int operandLimit(int rows, int bits, int maxValue)
+{
+    double limit = sqrt(ldexp(1.0, bits - 1) / rows);
+
+    return (int)max(1.0, min(floor(limit), (double)maxValue));
+}
+
+// Column-major weights of a shape as int, in the layout of the kernels
+template <typename T>
+static Eigen::MatrixXi intWeights(const vector<T> &weights,
+                                  const layerShape &shape)
+{
+    typedef Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> matrix;
+
+    return Eigen::Map<const matrix>(weights.data(), shape.rows, shape.cols)
+        .template cast<int>();
+}
+
+// Whether sums are the product of the transposed weights and in, computed by
+// Eigen
+template <typename T>
+static bool matchesEigen(const Eigen::MatrixXi &weights, const T *in,
+                         const int32_t *sums)
+{
+    typedef Eigen::Matrix<T, Eigen::Dynamic, 1> column;
+
+    Eigen::VectorXi expected =
+        weights.transpose() *
+        Eigen::Map<const column>(in, weights.rows()).template cast<int>();
+
+    return equal(expected.data(), expected.data() + expected.size(), sums);
+}
+
+// Dense and block products of T operands, the block ones on blockCount
+// samples against the reference's single-sample product
+template <typename T>
+void kernelChecker::checkProducts(const layerShape &shape)
+{
+    int limit = operandLimit(shape.rows, 31, numeric_limits<T>::max() + 1);
+    int inStride = shape.rows + blockPadding;
+    int outStride = shape.cols + blockPadding;
+    vector<T> weights =
+        randomValues<T>((size_t)shape.rows * shape.cols, limit);
+    vector<T> in = randomValues<T>((size_t)inStride * blockCount, limit);
+    vector<int32_t> expected((size_t)outStride * blockCount, -1);
+    vector<int32_t> out(expected);
+
+    for (int s = 0; s < blockCount; s++) {
+        const T *sample = &in[(size_t)s * inStride];
+        int32_t *sums = &expected[(size_t)s * outStride];
+
+        if (sizeof(T) == 2)
+            reference.product16((const int16_t *)weights.data(), shape.rows,
+                                shape.cols, (const int16_t *)sample, sums);
+        else
+            reference.product8((const int8_t *)weights.data(), shape.rows,
+                               shape.cols, (const int8_t *)sample, sums);
+    }
+
+    Eigen::MatrixXi dense = intWeights(weights, shape);
+    bool same = true;
+
+    for (int s = 0; s < blockCount; s++)
+        same = same && matchesEigen(dense, &in[(size_t)s * inStride],
+                                    &expected[(size_t)s * outStride]);
+    reportReference(sizeof(T) == 2 ? "product16" : "product8", shape, same);
+
+    if (sizeof(T) == 2) {
+        kernels.product16((const int16_t *)weights.data(), shape.rows,
+                          shape.cols, (const int16_t *)in.data(), out.data());
+        report("product16", shape,
+               equal(out.begin(), out.begin() + shape.cols, expected.begin()));
+
+        fill(out.begin(), out.end(), -1);
+        kernels.block16((const int16_t *)weights.data(), shape.rows,
+                        shape.cols, (const int16_t *)in.data(), inStride,
+                        blockCount, out.data(), outStride);
+        report("block16", shape, out == expected);
+    } else {
+        kernels.product8((const int8_t *)weights.data(), shape.rows,
+                         shape.cols, (const int8_t *)in.data(), out.data());
+        report("product8", shape,
+               equal(out.begin(), out.begin() + shape.cols, expected.begin()));
+
+        fill(out.begin(), out.end(), -1);
+        kernels.block8((const int8_t *)weights.data(), shape.rows, shape.cols,
+                       (const int8_t *)in.data(), inStride, blockCount,
+                       out.data(), outStride);
+        report("block8", shape, out == expected);
+    }
+}
+
+// Narrow-accumulator products, with every partial sum within int16_t and no
+// weight of -128
+void kernelChecker::checkNarrow(const layerShape &shape)
+{
+    int weightLimit = min(127, max(1, 32767 / shape.rows));
+    int inLimit = min(127, max(1, 32767 / (shape.rows * weightLimit)));
+    vector<int8_t> weights =
+        randomValues<int8_t>((size_t)shape.rows * shape.cols, weightLimit);
+    vector<int8_t> in = randomValues<int8_t>(shape.rows, inLimit);
+    vector<int32_t> expected(shape.cols), out(shape.cols);
+
+    for (size_t i = 0; i < weights.size(); i++)
+        weights[i] = max(weights[i], (int8_t)-127);
+
+    reference.narrow8(weights.data(), shape.rows, shape.cols, in.data(),
+                      expected.data());
+    reportReference("narrow8", shape,
+                    matchesEigen(intWeights(weights, shape), in.data(),
+                                 expected.data()));
+    kernels.narrow8(weights.data(), shape.rows, shape.cols, in.data(),
+                    out.data());
+    report("narrow8", shape, out == expected);
+}
+
+// Sparse weights, half of their blocks pruned
+template <typename T> void kernelChecker::checkSparse(const layerShape &shape)
+{
+    int limit = operandLimit(shape.rows, 31, numeric_limits<T>::max() + 1);
+    vector<T> weights =
+        randomValues<T>((size_t)shape.rows * shape.cols, limit);
+    vector<T> in = randomValues<T>(shape.rows, limit);
+    vector<int32_t> expected(shape.cols), out(shape.cols);
+    sparseWeights<T> sparse;
+
+    for (int j = 0; j < shape.cols; j++) {
+        for (int i = 0; i < shape.rows; i += sparseBlockRows) {
+            if (rng() % 2)
+                continue;
+            for (int k = i; k < min(i + sparseBlockRows, shape.rows); k++)
+                weights[(size_t)j * shape.rows + k] = 0;
+        }
+    }
+
+    // Too few rows to be stored sparse
+    if (!sparse.build(weights.data(), shape.rows, shape.cols))
+        return;
+
+    if (sizeof(T) == 2) {
+        reference.sparse16((const int16_t *)sparse.getBlocks(),
+                           sparse.getBlockRows(), sparse.getColumnStarts(),
+                           shape.cols, (const int16_t *)in.data(),
+                           expected.data());
+        reportReference("sparse16", shape,
+                        matchesEigen(intWeights(weights, shape), in.data(),
+                                     expected.data()));
+        kernels.sparse16((const int16_t *)sparse.getBlocks(),
+                         sparse.getBlockRows(), sparse.getColumnStarts(),
+                         shape.cols, (const int16_t *)in.data(), out.data());
+        report("sparse16", shape, out == expected);
+    } else {
+        reference.sparse8((const int8_t *)sparse.getBlocks(),
+                          sparse.getBlockRows(), sparse.getColumnStarts(),
+                          shape.cols, (const int8_t *)in.data(),
+                          expected.data());
+        reportReference("sparse8", shape,
+                        matchesEigen(intWeights(weights, shape), in.data(),
+                                     expected.data()));
+        kernels.sparse8((const int8_t *)sparse.getBlocks(),
+                        sparse.getBlockRows(), sparse.getColumnStarts(),
+                        shape.cols, (const int8_t *)in.data(), out.data());
+        report("sparse8", shape, out == expected);
+    }
+}
+
+// Nonzero inputs and the sums of their weight rows
+template <typename T> void kernelChecker::checkRows(const layerShape &shape)
+{
+    int limit = operandLimit(shape.rows, 31, numeric_limits<T>::max() + 1);
+    int stride = (shape.cols + weightRowsAlignment - 1) /
+                 weightRowsAlignment * weightRowsAlignment;
+    vector<T> weightRows((size_t)shape.rows * stride, 0);
+    vector<T> in = sparseValues<T>(shape.rows, limit);
+    vector<int32_t> expectedIndices(shape.rows), indices(shape.rows);
+    vector<int32_t> expected(shape.cols), out(shape.cols);
+    int expectedCount, count;
+
+    for (int i = 0; i < shape.rows; i++) {
+        vector<T> row = randomValues<T>(shape.cols, limit);
+        copy(row.begin(), row.end(), &weightRows[(size_t)i * stride]);
+    }
+
+    if (sizeof(T) == 2) {
+        expectedCount = reference.nonzero16((const int16_t *)in.data(),
+                                            shape.rows,
+                                            expectedIndices.data());
+        count = kernels.nonzero16((const int16_t *)in.data(), shape.rows,
+                                  indices.data());
+    } else {
+        expectedCount = reference.nonzero8((const int8_t *)in.data(),
+                                           shape.rows, expectedIndices.data());
+        count = kernels.nonzero8((const int8_t *)in.data(), shape.rows,
+                                 indices.data());
+    }
+    report(sizeof(T) == 2 ? "nonzero16" : "nonzero8", shape,
+           count == expectedCount &&
+               equal(indices.begin(), indices.begin() + count,
+                     expectedIndices.begin()));
+
+    if (sizeof(T) == 2) {
+        reference.rows16((const int16_t *)weightRows.data(), stride,
+                         shape.cols, expectedIndices.data(), expectedCount,
+                         (const int16_t *)in.data(), expected.data());
+        kernels.rows16((const int16_t *)weightRows.data(), stride, shape.cols,
+                       expectedIndices.data(), expectedCount,
+                       (const int16_t *)in.data(), out.data());
+    } else {
+        reference.rows8((const int8_t *)weightRows.data(), stride, shape.cols,
+                        expectedIndices.data(), expectedCount,
+                        (const int8_t *)in.data(), expected.data());
+        kernels.rows8((const int8_t *)weightRows.data(), stride, shape.cols,
+                      expectedIndices.data(), expectedCount,
+                      (const int8_t *)in.data(), out.data());
+    }
+    report(sizeof(T) == 2 ? "rows16" : "rows8", shape, out == expected);
+
+    // Zero inputs add nothing, the sums are those of every row
+    typedef Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+        rowMatrix;
+    Eigen::Map<const rowMatrix, 0, Eigen::OuterStride<>> rows(
+        weightRows.data(), shape.rows, shape.cols,
+        Eigen::OuterStride<>(stride));
+
+    reportReference(sizeof(T) == 2 ? "rows16" : "rows8", shape,
+                    matchesEigen(Eigen::MatrixXi(rows.template cast<int>()),
+                                 in.data(), expected.data()));
+}
+
+// Input bit planes and ternary (or binary) products over them, on inputs of
+// the full range of T
+template <typename T>
+void kernelChecker::checkTernary(const layerShape &shape, bool binary)
+{
+    int limit = numeric_limits<T>::max() + 1;
+    int words = (shape.rows + 63) / 64;
+    int maxPlanes = 8 * sizeof(T);
+    vector<T> weights((size_t)shape.rows * shape.cols);
+    vector<T> in = randomValues<T>(shape.rows, limit);
+    vector<uint64_t> expectedPlanes((size_t)maxPlanes * words, 0);
+    vector<uint64_t> planes(expectedPlanes);
+    vector<int32_t> expected(shape.cols), out(shape.cols);
+    ternaryWeights<T> ternary;
+    int expectedCount, count;
+
+    for (size_t i = 0; i < weights.size(); i++)
+        weights[i] = binary ? (T)(rng() % 2 ? 1 : -1) : (T)(rng() % 3 - 1);
+    if (!ternary.build(weights.data(), shape.rows, shape.cols))
+        return;
+
+    if (sizeof(T) == 2) {
+        expectedCount = reference.planes16((const int16_t *)in.data(),
+                                           shape.rows, expectedPlanes.data());
+        count = kernels.planes16((const int16_t *)in.data(), shape.rows,
+                                 planes.data());
+    } else {
+        expectedCount = reference.planes8((const int8_t *)in.data(),
+                                          shape.rows, expectedPlanes.data());
+        count = kernels.planes8((const int8_t *)in.data(), shape.rows,
+                                planes.data());
+    }
+    if (!binary)
+        report(sizeof(T) == 2 ? "planes16" : "planes8", shape,
+               count == expectedCount &&
+                   equal(planes.begin(), planes.begin() + count * words,
+                         expectedPlanes.begin()));
+
+    reference.ternary(ternary.getPositive(), ternary.getNegative(),
+                      ternary.getStride(), ternary.getWords(),
+                      ternary.getCols(), expectedPlanes.data(), expectedCount,
+                      expected.data());
+    reportReference(binary ? "ternary (binary)" : "ternary", shape,
+                    matchesEigen(intWeights(weights, shape), in.data(),
+                                 expected.data()));
+    kernels.ternary(ternary.getPositive(), ternary.getNegative(),
+                    ternary.getStride(), ternary.getWords(), ternary.getCols(),
+                    expectedPlanes.data(), expectedCount, out.data());
+    report(binary ? "ternary (binary)" : "ternary", shape, out == expected);
+}
+
+void kernelChecker::check(const layerShape &shape)
+{
+    checkProducts<int16_t>(shape);
+    checkProducts<int8_t>(shape);
+    checkNarrow(shape);
+    checkSparse<int16_t>(shape);
+    checkSparse<int8_t>(shape);
+    checkRows<int16_t>(shape);
+    checkRows<int8_t>(shape);
+    checkTernary<int16_t>(shape, false);
+    checkTernary<int8_t>(shape, false);
+    checkTernary<int16_t>(shape, true);
+}
+
+int main(int argc, char *argv[])
+{
+    const layerKernels &reference = *getLayerKernels(kernelScalar);
+    const int rows[] = {1,  2,  7,  15, 16,  17,  31,  32,  33,
+                        63, 64, 65, 97, 127, 129, 255, 401, 1025};
+    const int cols[] = {1, 3, 7, 8, 9, 16, 17, 30};
+    int failures = 0;
+
+    if (argc > 1 && !getLayerKernels(string(argv[1]))) {
+        cerr << "Unknown or unsupported kernels " << argv[1] << endl;
+        return 1;
+    }
+
+    for (int isa = 0; isa < numKernelIsas; isa++) {
+        const layerKernels *kernels = getLayerKernels((layerKernelIsa)isa);
+
+        if (!kernels)
+            continue;
+        if (argc > 1 && kernels->name != string(argv[1]))
+            continue;
+
+        kernelChecker checker(reference, *kernels);
+        for (int r : rows) {
+            for (int c : cols)
+                checker.check({r, c});
+        }
+
+        cout << kernels->name << ": " << checker.getChecks() << " checks, "
+             << checker.getMismatches() << " mismatches" << endl;
+        failures += checker.getMismatches();
+    }
+
+    return failures == 0 ? 0 : 1;
+}
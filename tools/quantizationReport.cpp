@@ -0,0 +1,191 @@
+// Accuracy and throughput of binary and ternary weights (see
+// weightQuantization in integerModel.h) against the 12-bit integer network,
+// on the bundled sample data.
+//
+// Usage: quantizationReport [--scaling global|layer|neuron] [kernels]
+//
+// Run from the directory holding fp-files/ and int-files/, like intNN. The
+// floating-point weights are converted once per mode, the converted weights
+// are written to int-files/. Every mode has 12-bit neurons and weights, so
+// they share shifts and activation table: the 12-bit network keeps linear
+// weights, binary and ternary ones one scale per group of the weight scaling
+// (per layer by default) and bit-packed weights. Accuracy is measured
+// against the sample labels, agreement against the predictions of the 12-bit
+// network.
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "datasetFile.h"
+#include "integerModel.h"
+#include "layerKernels.h"
+
+using namespace std;
+
+typedef IntegerModel<int16_t, int16_t, int32_t> modelType;
+typedef InferenceContext<int16_t, int16_t, int32_t> contextType;
+
+const int bits = 12;
+
+struct quantizationMode {
+    const char *name;
+    weightQuantization quantization;
+};
+
+// Best time of three passes over the samples, in nanoseconds per sample
+template <typename F> static double timeSamples(F pass, int numSamples)
+{
+    typedef chrono::steady_clock clock;
+    double best = 1e30;
+
+    for (int run = 0; run < 3; run++) {
+        clock::time_point start = clock::now();
+        pass();
+        double elapsed =
+            chrono::duration<double, nano>(clock::now() - start).count();
+
+        best = min(best, elapsed / numSamples);
+    }
+
+    return best;
+}
+
+// Bytes of the weights used for products: bit-packed positive (and, for
+// ternary layers, negative) words, or the dense matrices
+static size_t weightBytes(const modelType &model)
+{
+    size_t bytes = 0;
+
+    for (int l = 0; l < model.getNumLayers(); l++) {
+        size_t rows = model.getLayerSize(l) + 1;
+        size_t cols = model.getLayerSize(l + 1);
+
+        if (model.usesTernaryWeights(l)) {
+            size_t words = (rows + 63) / 64;
+            size_t stride = (cols + ternaryColumnAlignment - 1) /
+                            ternaryColumnAlignment * ternaryColumnAlignment;
+            bool ternary = (model.getWeights(l).array() == 0).any();
+
+            bytes += words * stride * sizeof(uint64_t) * (ternary ? 2 : 1);
+        } else {
+            bytes += rows * cols * sizeof(int16_t);
+        }
+    }
+
+    return bytes;
+}
+
+int main(int argc, char *argv[])
+{
+    weightScaling scaling = scalePerLayer;
+    const layerKernels *kernels = &detectLayerKernels();
+
+    for (int a = 1; a < argc; a++) {
+        string arg = argv[a];
+
+        if (arg == "--scaling" && a + 1 < argc) {
+            string value = argv[++a];
+
+            if (value == "global")
+                scaling = scaleGlobal;
+            else if (value == "layer")
+                scaling = scalePerLayer;
+            else if (value == "neuron")
+                scaling = scalePerNeuron;
+            else {
+                cerr << "Unknown scaling " << value << endl;
+                return 1;
+            }
+        } else if (!(kernels = getLayerKernels(arg))) {
+            cerr << "Unknown or unsupported kernels " << arg << endl;
+            return 1;
+        }
+    }
+
+    const quantizationMode modes[] = {
+        {"12-bit", quantizeLinear},
+        {"ternary", quantizeTernary},
+        {"binary", quantizeBinary},
+    };
+
+    // Inputs and labels, converted once
+    string datasetFile = "int-files/quantizationReport_input.bin";
+    {
+        modelType model(400, 30, 10, bits, bits);
+
+        if (!model.convertFPInputs("fp-files/input.txt", "", datasetFile,
+                                   "fp-files/output.txt")) {
+            cerr << "Could not convert fp-files/input.txt" << endl;
+            return 1;
+        }
+    }
+
+    datasetReader<int16_t> dataset;
+
+    if (!dataset.open(datasetFile) || dataset.getSampleSize() != 400 ||
+        !dataset.hasLabels()) {
+        cerr << "Could not load dataset file " << datasetFile << endl;
+        return 1;
+    }
+
+    int numSamples = dataset.getNumSamples();
+    datasetReader<int16_t>::sampleBlock samples =
+        dataset.samples(0, numSamples);
+    datasetReader<int16_t>::labelBlock labels = dataset.labels(0, numSamples);
+    vector<int> reference;
+
+    cout << "Kernels: " << kernels->name << ", " << numSamples << " samples"
+         << endl;
+    cout << setw(8) << "mode" << setw(10) << "accuracy" << setw(11)
+         << "agreement" << setw(14) << "weight bytes" << setw(16)
+         << "classify ns" << setw(16) << "batch ns" << endl;
+
+    for (const quantizationMode &mode : modes) {
+        modelType model(400, 30, 10, bits, bits);
+        string weightsFile =
+            string("int-files/quantizationReport_") + mode.name + ".txt";
+
+        model.setKernels(*kernels);
+        if (!model.convertFPWeights("fp-files/weights.txt", weightsFile,
+                                    scaling, mode.quantization) ||
+            !model.buildActivationTable(
+                "int-files/quantizationReport_activation.txt")) {
+            cerr << "Could not convert fp-files/weights.txt" << endl;
+            return 1;
+        }
+
+        contextType context(model);
+        vector<int> results(numSamples);
+
+        double classifyTime = timeSamples(
+            [&]() {
+                for (int s = 0; s < numSamples; s++)
+                    results[s] = model.classify(context, samples.col(s));
+            },
+            numSamples);
+        double batchTime = timeSamples(
+            [&]() { model.classifyBatch(context, samples, results.data()); },
+            numSamples);
+
+        if (reference.empty())
+            reference = results;
+
+        int correct = 0, agreeing = 0;
+        for (int s = 0; s < numSamples; s++) {
+            correct += results[s] == labels(s);
+            agreeing += results[s] == reference[s];
+        }
+
+        cout << setw(8) << mode.name << fixed << setprecision(4) << setw(10)
+             << (double)correct / numSamples << setw(11)
+             << (double)agreeing / numSamples << setw(14)
+             << weightBytes(model) << setprecision(1) << setw(16)
+             << classifyTime << setw(16) << batchTime << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,225 @@
+// Worst-case and empirical accumulator ranges of a binary model's layers (see
+// rangeAnalysis.h), and the narrowest accumulator type each layer can use.
+//
+// Usage: rangeAnalyzer --model FILE [--dataset FILE] [--input-range LOW HIGH]
+//                      [--neurons] [--annotate FILE]
+//
+// Worst cases take first-layer inputs anywhere in the neuron range
+// [-maxNeuron, maxNeuron], or in --input-range. The dataset, a binary dataset
+// file (see datasetFile.h) at the model's neuron bit depth, gives the ranges
+// seen on real samples. --neurons prints the ranges of every output neuron.
+// --annotate saves the model to FILE with each layer's worst-case bits over
+// the full neuron range, whatever --input-range (see getAccumulatorBits in
+// integerModel.h), so the runtime can pick the narrow-accumulator kernels
+// where they are safe for any input; it may be the model file itself.
+
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "datasetFile.h"
+#include "integerModel.h"
+#include "modelFile.h"
+#include "rangeAnalysis.h"
+
+using namespace std;
+
+struct analyzerOptions {
+    string modelFile, datasetFile, annotateFile;
+    bool hasInputRange;
+    int64_t inputLow, inputHigh;
+    bool neurons;
+};
+
+static string rangeText(const valueRange &range)
+{
+    ostringstream text;
+
+    if (range.low > range.high)
+        text << "-";
+    else
+        text << "[" << range.low << ", " << range.high << "]";
+
+    return text.str();
+}
+
+static const char *accumulatorName(int bits)
+{
+    int bytes = accumulatorBytes(bits);
+
+    return bytes == 2 ? "int16_t" : bytes == 4 ? "int32_t" : "int64_t";
+}
+
+template <typename NeuronT, typename WeightT, typename AccT>
+static int analyze(const modelFileLayout &layout,
+                   const analyzerOptions &options)
+{
+    typedef IntegerModel<NeuronT, WeightT, AccT> modelType;
+    typedef rangeAnalyzer<NeuronT, WeightT, AccT> analyzerType;
+
+    modelType model(layout.sizes, layout.header.neuronBits,
+                    layout.weightBits);
+
+    if (!model.loadModel(options.modelFile)) {
+        cerr << "Could not load model file " << options.modelFile << endl;
+        return 1;
+    }
+
+    int64_t low = -model.getMaxNeuron(), high = model.getMaxNeuron();
+    if (options.hasInputRange) {
+        low = options.inputLow;
+        high = options.inputHigh;
+    }
+
+    analyzerType analyzer(model, low, high);
+
+    if (!options.datasetFile.empty()) {
+        datasetReader<NeuronT> dataset;
+
+        if (!dataset.open(options.datasetFile) ||
+            dataset.getSampleSize() != model.getSizeInput() ||
+            dataset.getNeuronBits() != model.getNeuronBits()) {
+            cerr << "Could not load dataset file " << options.datasetFile
+                 << endl;
+            return 1;
+        }
+        analyzer.calibrate(dataset.samples(0, dataset.getNumSamples()));
+    }
+
+    cout << "Inputs in [" << low << ", " << high << "], "
+         << analyzer.getSamples() << " calibration samples, "
+         << 8 * sizeof(AccT) << "-bit accumulators in use" << endl;
+
+    for (int l = 0; l < model.getNumLayers(); l++) {
+        const typename analyzerType::layerRanges &layer = analyzer.getLayer(l);
+        valueRange sums = {layer.sums[0].low, layer.sums[0].high};
+
+        for (const valueRange &range : layer.sums) {
+            sums.low = min(sums.low, range.low);
+            sums.high = max(sums.high, range.high);
+        }
+
+        cout << "Layer " << l << " (" << model.getLayerSize(l) + 1 << " x "
+             << model.getLayerSize(l + 1) << ")\n"
+             << "  worst-case sums     " << rangeText(sums) << "\n"
+             << "  worst-case partials " << rangeText(layer.partialSums)
+             << ", " << analyzer.getWorstBits(l) << " bits\n";
+        if (analyzer.getSamples() > 0)
+            cout << "  seen sums           " << analyzer.getSeenBits(l)
+                 << " bits\n";
+        cout << "  recommended         "
+             << accumulatorName(analyzer.getWorstBits(l));
+        if (analyzer.getSamples() > 0 &&
+            accumulatorBytes(analyzer.getSeenBits(l)) <
+                accumulatorBytes(analyzer.getWorstBits(l)))
+            cout << " (" << accumulatorName(analyzer.getSeenBits(l))
+                 << " on the samples seen)";
+        cout << endl;
+
+        if (options.neurons) {
+            for (size_t j = 0; j < layer.sums.size(); j++) {
+                cout << "    neuron " << setw(4) << j << "  worst "
+                     << rangeText(layer.sums[j]);
+                if (analyzer.getSamples() > 0)
+                    cout << "  seen " << rangeText(layer.seenSums[j]);
+                cout << "\n";
+            }
+        }
+    }
+
+    if (!options.annotateFile.empty()) {
+        // The runtime trusts the bits for any input, so they come from the
+        // full neuron range even when the report used a narrower one
+        int64_t maxNeuron = model.getMaxNeuron();
+        analyzerType full(model, -maxNeuron, maxNeuron);
+
+        for (int l = 0; l < model.getNumLayers(); l++)
+            model.setAccumulatorBits(l, full.getWorstBits(l));
+
+        if (!model.saveModel(options.annotateFile)) {
+            cerr << "Could not write " << options.annotateFile << endl;
+            return 1;
+        }
+
+        cerr << "Wrote " << options.annotateFile << endl;
+        for (int l = 0; l < model.getNumLayers(); l++) {
+            if (model.usesNarrowAccumulators(l))
+                cerr << "Layer " << l << " uses the narrow-accumulator kernels"
+                     << endl;
+        }
+    }
+
+    return 0;
+}
+
+// analyze for the storage types of the model file
+struct analyzeModel {
+    const modelFileLayout &layout;
+    const analyzerOptions &options;
+
+    template <typename NeuronT, typename WeightT, typename AccT>
+    int run() const
+    {
+        return analyze<NeuronT, WeightT, AccT>(layout, options);
+    }
+};
+
+static int usage()
+{
+    cerr << "Usage: rangeAnalyzer --model FILE [--dataset FILE] "
+            "[--input-range LOW HIGH]\n"
+            "                     [--neurons] [--annotate FILE]"
+         << endl;
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    analyzerOptions options = {"", "", "", false, 0, 0, false};
+
+    for (int a = 1; a < argc; a++) {
+        string arg = argv[a];
+
+        if (arg == "--neurons")
+            options.neurons = true;
+        else if (arg == "--input-range" && a + 2 < argc) {
+            options.hasInputRange = true;
+            options.inputLow = atoll(argv[++a]);
+            options.inputHigh = atoll(argv[++a]);
+        } else if (a + 1 >= argc)
+            return usage();
+        else if (arg == "--model")
+            options.modelFile = argv[++a];
+        else if (arg == "--dataset")
+            options.datasetFile = argv[++a];
+        else if (arg == "--annotate")
+            options.annotateFile = argv[++a];
+        else
+            return usage();
+    }
+
+    if (options.modelFile.empty() ||
+        (options.hasInputRange && options.inputLow > options.inputHigh))
+        return usage();
+
+    modelFileLayout layout;
+    analyzeModel analyzer = {layout, options};
+    int result;
+
+    if (!readModelLayout(options.modelFile, layout)) {
+        cerr << "Could not read model file " << options.modelFile << endl;
+        return 1;
+    }
+    if (!withIntegerNetTypes(layout.header.neuronBytes,
+                             layout.header.accumulatorBytes, analyzer,
+                             result)) {
+        cerr << "Unsupported storage types" << endl;
+        return 1;
+    }
+
+    return result;
+}
@@ -0,0 +1,234 @@
+// Dense against sparse layer products, to find the block density under which
+// sparse weights pay off (see defaultSparseDensity in sparseWeights.h), and
+// the fraction of nonzero inputs under which summing only their weight rows
+// does (see defaultInputDensity in integerModel.h).
+//
+// Usage: sparseBench [kernels]
+//
+// Each layer shape is timed with 16-bit operands (the 12-bit network) over a
+// range of densities, for two kinds of sparse weights: whole pruned blocks,
+// and weights zeroed independently of each other (e.g. small weights
+// truncated to zero at low bit depths), which leave far fewer blocks empty.
+// Sparse inputs are timed with dense weights, finding the nonzero inputs
+// included.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "integerKernels.h"
+#include "layerKernels.h"
+#include "sparseWeights.h"
+
+using namespace std;
+
+struct layerShape {
+    int rows, cols;
+};
+
+// Best time of a few runs, in nanoseconds per call
+template <typename F> static double timeCall(F call)
+{
+    typedef chrono::steady_clock clock;
+    double best = 1e30;
+    int reps = 1;
+
+    // Enough repetitions for about 10 ms per run
+    for (;;) {
+        clock::time_point start = clock::now();
+        for (int r = 0; r < reps; r++)
+            call();
+        double elapsed =
+            chrono::duration<double, nano>(clock::now() - start).count();
+
+        if (elapsed > 1e7)
+            break;
+        reps *= 2;
+    }
+
+    for (int run = 0; run < 5; run++) {
+        clock::time_point start = clock::now();
+        for (int r = 0; r < reps; r++)
+            call();
+        double elapsed =
+            chrono::duration<double, nano>(clock::now() - start).count();
+
+        best = min(best, elapsed / reps);
+    }
+
+    return best;
+}
+
+// Random 12-bit weights, keeping each block (or each weight) with
+// probability density
+static vector<int16_t> randomWeights(const layerShape &shape, double density,
+                                     bool wholeBlocks, mt19937 &rng)
+{
+    uniform_real_distribution<double> keep(0.0, 1.0);
+    uniform_int_distribution<int> value(-2048, 2047);
+    vector<int16_t> weights((size_t)shape.rows * shape.cols, 0);
+
+    for (int j = 0; j < shape.cols; j++) {
+        int16_t *column = &weights[(size_t)j * shape.rows];
+
+        for (int first = 0; first < shape.rows; first += sparseBlockRows) {
+            int last = min(first + sparseBlockRows, shape.rows);
+            bool keepBlock = keep(rng) < density;
+
+            for (int i = first; i < last; i++) {
+                if (wholeBlocks ? keepBlock : keep(rng) < density)
+                    column[i] = value(rng);
+            }
+        }
+    }
+
+    return weights;
+}
+
+// Dense product against the sum of the rows of the nonzero inputs, for each
+// fraction of nonzero inputs
+static void benchSparseInputs(const layerKernels &kernels,
+                              const layerShape &shape,
+                              const double *densities, int numDensities,
+                              mt19937 &rng)
+{
+    volatile int32_t sink = 0;
+    double crossover = 0.0;
+    int stride = (shape.cols + weightRowsAlignment - 1) /
+                 weightRowsAlignment * weightRowsAlignment;
+
+    vector<int16_t> weights = randomWeights(shape, 1.0, true, rng);
+    vector<int16_t> weightRows((size_t)shape.rows * stride, 0);
+    vector<int32_t> indices(shape.rows);
+    vector<int32_t> denseOut(shape.cols), sparseOut(shape.cols);
+
+    for (int i = 0; i < shape.rows; i++) {
+        for (int j = 0; j < shape.cols; j++)
+            weightRows[(size_t)i * stride + j] =
+                weights[(size_t)j * shape.rows + i];
+    }
+
+    cout << endl
+         << shape.rows << " x " << shape.cols << ", sparse inputs" << endl;
+    cout << "  density  dense ns  sparse ns  speedup" << endl;
+
+    for (int d = 0; d < numDensities; d++) {
+        uniform_real_distribution<double> keep(0.0, 1.0);
+        vector<int16_t> in(shape.rows, 0);
+
+        for (size_t i = 0; i < in.size(); i++) {
+            if (keep(rng) < densities[d])
+                in[i] = rng() % 2049;
+        }
+
+        double denseTime = timeCall([&]() {
+            layerProduct(kernels, weights.data(), shape.rows, shape.cols,
+                         in.data(), denseOut.data());
+            sink = sink + denseOut[0];
+        });
+        double sparseTime = timeCall([&]() {
+            int count =
+                nonzeroInputs(kernels, in.data(), shape.rows, indices.data());
+            rowsProduct(kernels, weightRows.data(), stride, shape.cols,
+                        indices.data(), count, in.data(), sparseOut.data());
+            sink = sink + sparseOut[0];
+        });
+
+        if (sparseOut != denseOut) {
+            cerr << "Sparse input and dense products differ" << endl;
+            exit(1);
+        }
+        if (sparseTime < denseTime)
+            crossover = max(crossover, densities[d]);
+
+        cout << setprecision(2) << setw(9) << densities[d] << setprecision(0)
+             << setw(10) << denseTime << setw(11) << sparseTime
+             << setprecision(2) << setw(9) << denseTime / sparseTime << endl;
+    }
+
+    cout << "  Sparse inputs faster up to a density of " << setprecision(2)
+         << crossover << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    const layerKernels *kernels = &detectLayerKernels();
+
+    if (argc > 1 && !(kernels = getLayerKernels(string(argv[1])))) {
+        cerr << "Unknown or unsupported kernels " << argv[1] << endl;
+        return 1;
+    }
+
+    // Layers of the sample network, then larger ones
+    const layerShape shapes[] = {{401, 30}, {31, 10}, {1025, 256}, {257, 64}};
+    const double densities[] = {0.01, 0.02, 0.05, 0.1, 0.2, 0.3,
+                                0.4,  0.5,  0.6,  0.8, 1.0};
+
+    mt19937 rng(1);
+    volatile int32_t sink = 0;
+
+    cout << "Kernels: " << kernels->name << endl;
+    cout << fixed;
+
+    for (const layerShape &shape : shapes) {
+        vector<int16_t> in(shape.rows);
+        vector<int32_t> denseOut(shape.cols), sparseOut(shape.cols);
+
+        for (size_t i = 0; i < in.size(); i++)
+            in[i] = rng() % 2049;
+
+        for (int wholeBlocks = 1; wholeBlocks >= 0; wholeBlocks--) {
+            double crossover = 0.0;
+
+            cout << endl
+                 << shape.rows << " x " << shape.cols << ", "
+                 << (wholeBlocks ? "pruned blocks" : "pruned weights") << endl;
+            cout << "  density  blocks  dense ns  sparse ns  speedup" << endl;
+
+            for (double density : densities) {
+                vector<int16_t> weights =
+                    randomWeights(shape, density, wholeBlocks, rng);
+                sparseWeights<int16_t> sparse;
+
+                if (!sparse.build(weights.data(), shape.rows, shape.cols))
+                    break;
+
+                double denseTime = timeCall([&]() {
+                    layerProduct(*kernels, weights.data(), shape.rows,
+                                 shape.cols, in.data(), denseOut.data());
+                    sink = sink + denseOut[0];
+                });
+                double sparseTime = timeCall([&]() {
+                    sparseLayerProduct(*kernels, sparse, in.data(),
+                                       sparseOut.data());
+                    sink = sink + sparseOut[0];
+                });
+
+                if (sparseOut != denseOut) {
+                    cerr << "Sparse and dense products differ" << endl;
+                    return 1;
+                }
+                if (sparseTime < denseTime)
+                    crossover = max(crossover, sparse.getDensity());
+
+                cout << setprecision(2) << setw(9) << density << setw(8)
+                     << sparse.getDensity() << setprecision(0) << setw(10)
+                     << denseTime << setw(11) << sparseTime << setprecision(2)
+                     << setw(9) << denseTime / sparseTime << endl;
+            }
+
+            cout << "  Sparse faster up to a block density of "
+                 << setprecision(2) << crossover << endl;
+        }
+
+        benchSparseInputs(*kernels, shape, densities,
+                          sizeof(densities) / sizeof(densities[0]), rng);
+    }
+
+    return 0;
+}
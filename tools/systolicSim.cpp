@@ -0,0 +1,226 @@
+// Cycles, utilization and memory traffic per inference of a binary model on
+// a systolic co-processor (see systolicSimulator.h), from a binary dataset.
+//
+// Usage: systolicSim --model FILE --dataset FILE [--array ROWS COLS]
+//                    [--operand-bits NEURON WEIGHT] [--accumulator-bits N]
+//                    [--activation-lanes N] [--weight-sram BYTES]
+//                    [--lut-sram BYTES] [--dram-bandwidth BYTES_PER_CYCLE]
+//                    [--batch N] [--samples N] [--clock MHZ]
+//
+// The configuration defaults to defaultSystolicConfig. Samples (all of the
+// dataset's by default, at the model's neuron bit depth) go through the
+// array --batch at a time, 1 by default for the latency of single samples.
+// Results are checked against the model's own classifyBatch, and latencies
+// and throughput use the --clock frequency (1000 MHz by default).
+
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "datasetFile.h"
+#include "integerModel.h"
+#include "modelFile.h"
+#include "systolicSimulator.h"
+
+using namespace std;
+
+struct simOptions {
+    string modelFile, datasetFile;
+    systolicConfig config;
+    int batch;
+    int64_t samples;
+    double clockMHz;
+};
+
+template <typename NeuronT, typename WeightT, typename AccT>
+static int simulate(const modelFileLayout &layout, const simOptions &options)
+{
+    typedef systolicSimulator<NeuronT, WeightT, AccT> simulatorType;
+
+    IntegerModel<NeuronT, WeightT, AccT> model(
+        layout.sizes, layout.header.neuronBits, layout.weightBits);
+
+    if (!model.loadModel(options.modelFile)) {
+        cerr << "Could not load model file " << options.modelFile << endl;
+        return 1;
+    }
+
+    datasetReader<NeuronT> dataset;
+
+    if (!dataset.open(options.datasetFile) ||
+        dataset.getSampleSize() != model.getSizeInput() ||
+        dataset.getNeuronBits() != model.getNeuronBits()) {
+        cerr << "Could not load dataset file " << options.datasetFile << endl;
+        return 1;
+    }
+
+    int numSamples = dataset.getNumSamples();
+    if (options.samples > 0 && options.samples < numSamples)
+        numSamples = options.samples;
+
+    typename datasetReader<NeuronT>::sampleBlock samples =
+        dataset.samples(0, numSamples);
+    simulatorType simulator(model, options.config);
+    typename simulatorType::contextType context(model, options.batch);
+    systolicStats stats = systolicStats();
+    vector<int> results(numSamples), reference(numSamples);
+
+    simulator.classifyBatch(context, samples, results.data(), stats,
+                            options.batch);
+    model.classifyBatch(context, samples, reference.data());
+
+    int mismatches = 0;
+    for (int s = 0; s < numSamples; s++)
+        mismatches += results[s] != reference[s];
+
+    const systolicConfig &config = simulator.getConfig();
+    double perSample = 1.0 / stats.samples;
+    double perBatch = 1.0 / stats.batches;
+
+    cout << "Array " << config.arrayRows << " x " << config.arrayCols << ", "
+         << config.neuronBits << "-bit neurons x " << config.weightBits
+         << "-bit weights into " << config.accumulatorBits
+         << "-bit accumulators, " << config.activationLanes
+         << " activation lanes\n"
+         << "SRAM " << config.weightSram << " bytes of weights, "
+         << config.lutSram << " bytes of LUT, DRAM " << config.dramBandwidth
+         << " bytes/cycle, " << options.clockMHz << " MHz\n"
+         << "Setup " << simulator.getSetupBytes() << " bytes (LUT of "
+         << simulator.getLUTBytes() << " bytes "
+         << (simulator.usesResidentLUT() ? "in SRAM" : "in DRAM") << ")\n"
+         << stats.samples << " samples in batches of " << options.batch
+         << endl;
+
+    cout << fixed << setprecision(1);
+    for (int l = 0; l < model.getNumLayers(); l++) {
+        const systolicLayerStats &layer = stats.layers[l];
+        double utilization = (double)layer.macs /
+                             ((double)layer.cycles * config.arrayRows *
+                              config.arrayCols);
+
+        cout << "Layer " << l << " (" << model.getLayerSize(l) + 1 << " x "
+             << model.getLayerSize(l + 1) << "), weights "
+             << (simulator.usesResidentWeights(l) ? "in SRAM" : "in DRAM")
+             << ", " << simulator.getTiles(l) << " tiles, "
+             << simulator.getPasses(l) << " passes\n"
+             << "  cycles/sample " << layer.cycles * perSample << " (array "
+             << layer.arrayCycles * perSample << ", stalls "
+             << layer.stallCycles * perSample << ", activation "
+             << layer.activationCycles * perSample << ")\n"
+             << "  utilization " << 100 * utilization << "%, DRAM bytes/sample "
+             << (layer.weightBytes + layer.lutBytes) * perSample
+             << ", accumulator overflows " << layer.overflows << endl;
+    }
+
+    double cycles = stats.cycles * perSample;
+    double dramBytes = (double)stats.inputBytes + stats.outputBytes;
+    for (const systolicLayerStats &layer : stats.layers)
+        dramBytes += layer.weightBytes + layer.lutBytes;
+
+    cout << "Total cycles/sample " << cycles << ", DRAM bytes/sample "
+         << dramBytes * perSample << "\n"
+         << "Batch latency " << setprecision(3)
+         << stats.cycles * perBatch / options.clockMHz << " us, throughput "
+         << setprecision(0) << options.clockMHz * 1e6 / cycles
+         << " samples/s\n"
+         << "Mismatches against the model: " << mismatches << endl;
+
+    return mismatches == 0 ? 0 : 1;
+}
+
+// simulate for the storage types of the model file
+struct simulateModel {
+    const modelFileLayout &layout;
+    const simOptions &options;
+
+    template <typename NeuronT, typename WeightT, typename AccT>
+    int run() const
+    {
+        return simulate<NeuronT, WeightT, AccT>(layout, options);
+    }
+};
+
+static int usage()
+{
+    cerr << "Usage: systolicSim --model FILE --dataset FILE "
+            "[--array ROWS COLS]\n"
+            "                   [--operand-bits NEURON WEIGHT] "
+            "[--accumulator-bits N]\n"
+            "                   [--activation-lanes N] [--weight-sram BYTES]\n"
+            "                   [--lut-sram BYTES] "
+            "[--dram-bandwidth BYTES_PER_CYCLE]\n"
+            "                   [--batch N] [--samples N] [--clock MHZ]"
+         << endl;
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    simOptions options = {"", "", defaultSystolicConfig, 1, 0, 1000.0};
+    systolicConfig &config = options.config;
+
+    for (int a = 1; a < argc; a++) {
+        string arg = argv[a];
+
+        if (arg == "--array" && a + 2 < argc) {
+            config.arrayRows = atoi(argv[++a]);
+            config.arrayCols = atoi(argv[++a]);
+        } else if (arg == "--operand-bits" && a + 2 < argc) {
+            config.neuronBits = atoi(argv[++a]);
+            config.weightBits = atoi(argv[++a]);
+        } else if (a + 1 >= argc)
+            return usage();
+        else if (arg == "--model")
+            options.modelFile = argv[++a];
+        else if (arg == "--dataset")
+            options.datasetFile = argv[++a];
+        else if (arg == "--accumulator-bits")
+            config.accumulatorBits = atoi(argv[++a]);
+        else if (arg == "--activation-lanes")
+            config.activationLanes = atoi(argv[++a]);
+        else if (arg == "--weight-sram")
+            config.weightSram = atoll(argv[++a]);
+        else if (arg == "--lut-sram")
+            config.lutSram = atoll(argv[++a]);
+        else if (arg == "--dram-bandwidth")
+            config.dramBandwidth = atof(argv[++a]);
+        else if (arg == "--batch")
+            options.batch = atoi(argv[++a]);
+        else if (arg == "--samples")
+            options.samples = atoll(argv[++a]);
+        else if (arg == "--clock")
+            options.clockMHz = atof(argv[++a]);
+        else
+            return usage();
+    }
+
+    if (options.modelFile.empty() || options.datasetFile.empty() ||
+        config.arrayRows < 1 || config.arrayCols < 1 ||
+        config.neuronBits < 1 || config.neuronBits > 32 ||
+        config.weightBits < 1 || config.weightBits > 32 ||
+        config.accumulatorBits < 2 || config.accumulatorBits > 64 ||
+        config.activationLanes < 1 || config.weightSram < 0 ||
+        config.lutSram < 0 || !(config.dramBandwidth > 0) ||
+        options.batch < 1 || options.samples < 0 || !(options.clockMHz > 0))
+        return usage();
+
+    modelFileLayout layout;
+    simulateModel simulator = {layout, options};
+    int result;
+
+    if (!readModelLayout(options.modelFile, layout)) {
+        cerr << "Could not read model file " << options.modelFile << endl;
+        return 1;
+    }
+    if (!withIntegerNetTypes(layout.header.neuronBytes,
+                             layout.header.accumulatorBytes, simulator,
+                             result)) {
+        cerr << "Unsupported storage types" << endl;
+        return 1;
+    }
+
+    return result;
+}
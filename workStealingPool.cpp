@@ -0,0 +1,109 @@
+#include "workStealingPool.h"
+
+using namespace std;
+
+// Constructor
+workStealingPool::workStealingPool(int numWorkers)
+    : numThreads(numWorkers < 1 ? 1 : numWorkers), queues(numThreads),
+      jobId(0), finishedWorkers(0), stopping(false)
+{
+    for (int t = 0; t < numThreads; t++)
+        threads.push_back(thread(&workStealingPool::workerLoop, this, t));
+}
+
+// Destructor
+workStealingPool::~workStealingPool()
+{
+    {
+        lock_guard<mutex> guard(jobLock);
+        stopping = true;
+    }
+    jobReady.notify_all();
+
+    for (int t = 0; t < numThreads; t++)
+        threads[t].join();
+}
+
+bool workStealingPool::popTask(int worker, int &task)
+{
+    lock_guard<mutex> guard(queues[worker].lock);
+
+    if (queues[worker].tasks.empty())
+        return false;
+
+    task = queues[worker].tasks.back();
+    queues[worker].tasks.pop_back();
+    return true;
+}
+
+bool workStealingPool::stealTask(int worker, int &task)
+{
+    // Visit the other workers starting from the next one, so thieves spread
+    // over different victims
+    for (int i = 1; i < numThreads; i++) {
+        workerQueue &victim = queues[(worker + i) % numThreads];
+        lock_guard<mutex> guard(victim.lock);
+
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void workStealingPool::workerLoop(int worker)
+{
+    int lastJob = 0;
+
+    while (true) {
+        {
+            unique_lock<mutex> guard(jobLock);
+            jobReady.wait(guard,
+                          [&] { return stopping || jobId != lastJob; });
+            if (stopping)
+                return;
+            lastJob = jobId;
+        }
+
+        int task;
+        while (popTask(worker, task) || stealTask(worker, task))
+            job(worker, task);
+
+        // Every worker reports in, so none of them is left behind holding
+        // tasks of this job when the next one is queued
+        lock_guard<mutex> guard(jobLock);
+        finishedWorkers++;
+        if (finishedWorkers == numThreads)
+            jobDone.notify_all();
+    }
+}
+
+void workStealingPool::run(int numTasks, function<void(int, int)> task)
+{
+    if (numTasks <= 0)
+        return;
+
+    unique_lock<mutex> guard(jobLock);
+
+    // Contiguous ranges keep neighbouring tasks on the same worker, which is
+    // friendlier to the caches than interleaving them
+    for (int t = 0; t < numThreads; t++) {
+        int first = (int)((long)numTasks * t / numThreads);
+        int last = (int)((long)numTasks * (t + 1) / numThreads);
+
+        lock_guard<mutex> queueGuard(queues[t].lock);
+        for (int i = first; i < last; i++)
+            queues[t].tasks.push_back(i);
+    }
+
+    job = task;
+    finishedWorkers = 0;
+    jobId++;
+    jobReady.notify_all();
+
+    jobDone.wait(guard, [&] { return finishedWorkers == numThreads; });
+    job = nullptr;
+}
@@ -0,0 +1,57 @@
+#ifndef WorkStealingPool
+#define WorkStealingPool
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+class workStealingPool
+{
+  private:
+    // Per-worker task queue - The owner pops from the back, thieves steal
+    // from the front
+    struct workerQueue {
+        mutex lock;
+        deque<int> tasks;
+    };
+
+    int numThreads;
+    vector<thread> threads;
+    vector<workerQueue> queues;
+
+    // Current job - Set by run and shared by all workers
+    function<void(int, int)> job;
+    int jobId;
+    int finishedWorkers;
+    bool stopping;
+
+    mutex jobLock;
+    condition_variable jobReady;
+    condition_variable jobDone;
+
+    // Functions - Private member functions
+    void workerLoop(int worker);
+    bool popTask(int worker, int &task);
+    bool stealTask(int worker, int &task);
+
+  public:
+    // Constructor and Destructor
+    workStealingPool(int numWorkers);
+    ~workStealingPool();
+
+    workStealingPool(const workStealingPool &) = delete;
+    workStealingPool &operator=(const workStealingPool &) = delete;
+
+    int getNumThreads() const { return numThreads; }
+
+    // Runs task(worker, index) for every index in [0, numTasks) and blocks
+    // until all of them are done. Tasks are initially split in contiguous
+    // ranges between workers, idle workers steal from the others.
+    void run(int numTasks, function<void(int, int)> task);
+};
+
+#endif